@@ -194,9 +194,9 @@ if [ -z "$HAS_SERIALFLASH_LIB" ]; then
     echo "Installing SerialFlash library OK"
 fi
 
-# Check NDP v1.0.0
+# Check NDP v1.1.0
 has_NDP_lib() {
-	$ARDUINO_CLI lib list NDP | grep 1.0.0 || true
+	$ARDUINO_CLI lib list NDP | grep 1.1.0 || true
 }
 HAS_NDP_LIB="$(has_NDP_lib)"
 if [ -z "$HAS_NDP_LIB" ]; then
@@ -205,9 +205,9 @@ if [ -z "$HAS_NDP_LIB" ]; then
     echo "Installing NDP library OK"
 fi
 
-# Check NDP_utils v1.0.2
+# Check NDP_utils v1.1.0
 has_NDP_utils_lib() {
-	$ARDUINO_CLI lib list NDP_utils | grep 1.0.2 || true
+	$ARDUINO_CLI lib list NDP_utils | grep 1.1.0 || true
 }
 HAS_NDP_UTILS_LIB="$(has_NDP_utils_lib)"
 if [ -z "$HAS_NDP_UTILS_LIB" ]; then
@@ -253,6 +253,12 @@ else
     CPP_FLAGS=""
 fi
 
+# set NDP_SPI_STATS=1 in the environment to count NDP SPI transfers
+if [ -n "$NDP_SPI_STATS" ];
+then
+    CPP_FLAGS+=" -DNDP_SPI_STATS=$NDP_SPI_STATS"
+fi
+
 if [ "$COMMAND" = "--build" ];
 then
 	echo "Building $PROJECT"
@@ -44,6 +44,9 @@ static char isEndpointHalt = 0;
 
 extern void (*gpf_isr)(void);
 
+// MPW: called from the USB interrupt at every Start-Of-Frame, if linked in
+extern "C" void USB_StartOfFrame(void) __attribute__((weak));
+
 // USB_Handler ISR
 extern "C" void UDD_Handler(void) {
 	USBDevice.ISRHandler();
@@ -688,6 +691,21 @@ uint32_t USBDeviceClass::send(uint32_t ep, const void *data, uint32_t len)
 	return written;
 }
 
+// MPW: queue one isochronous IN packet without waiting, for use from the
+// Start-Of-Frame hook. Returns false while the last packet is still queued.
+bool USB_SendIsochronous(uint32_t ep, const void *data, uint32_t len)
+{
+	if (!USBDevice.configured() || len > EPX_SIZE || usbd.epBank1IsReady(ep))
+		return false;
+
+	memcpy(&udd_ep_in_cache_buffer[ep], data, len);
+	usbd.epBank1SetAddress(ep, &udd_ep_in_cache_buffer[ep]);
+	usbd.epBank1SetByteCount(ep, len);
+	usbd.epBank1AckTransferComplete(ep);
+	usbd.epBank1SetReady(ep);
+	return true;
+}
+
 uint32_t USBDeviceClass::armSend(uint32_t ep, const void* data, uint32_t len)
 {
 	memcpy(&udd_ep_in_cache_buffer[ep], data, len);
@@ -880,6 +898,10 @@ void USBDeviceClass::ISRHandler()
 				digitalWrite(PIN_LED_RXL, HIGH);
 		}
 #endif
+
+		// MPW
+		if (USB_StartOfFrame)
+			USB_StartOfFrame();
 	}
 
 	/* Remove any stall requests for endpoint #0 */
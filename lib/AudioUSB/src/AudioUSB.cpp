@@ -29,6 +29,14 @@
 
 Audio_ AudioUSB;
 
+// provided by the replacement USBCore.cpp, see "Arduino USBCore driver"
+bool USB_SendIsochronous(uint32_t ep, const void *data, uint32_t len);
+
+extern "C" void USB_StartOfFrame(void)
+{
+	AudioUSB.startOfFrame();
+}
+
 int Audio_::getInterface(uint8_t* interfaceNum)
 {
 	interfaceNum[0] += 2;	// uses 2 interfaces
@@ -71,20 +79,55 @@ uint8_t Audio_::getShortName(char* name)
 
 size_t Audio_::write(const int16_t *buffer, size_t size)
 {
-	USBDevice.send(pluggedEndpoint, buffer, size);
-	return 1;
-
-	/* only try to send bytes if the high-level Audio connection itself
-	 is open (not just the pipe) - the OS should set lineState when the port
-	 is opened and clear lineState when the port is closed.
-	 bytes sent before the user opens the connection or after
-	 the connection is closed are lost - just like with a UART. */
+	const uint8_t *data = (const uint8_t *)buffer;
+	uint32_t head = _head;
+	uint32_t at = head % Audio_RING_BYTES;
+	uint32_t first = Audio_RING_BYTES - at < size ? Audio_RING_BYTES - at : size;
+
+	if (Audio_RING_BYTES - (head - _tail) < size) {
+		_overruns++;
+		return 0;
+	}
+	memcpy(&_ring[at], data, first);
+	memcpy(_ring, data + first, size - first);
+	// the samples must be in the ring before the consumer sees them
+	__asm__ volatile("" ::: "memory");
+	_head = head + size;
+	return size;
+}
+
+void Audio_::startOfFrame(void)
+{
+	uint32_t tail = _tail;
+	uint32_t queued = _head - tail;
+
+	if (!_primed) {
+		if (queued < Audio_PREFILL_BYTES)
+			return;
+		_primed = true;
+	} else if (queued < Audio_PACKET_BYTES) {
+		_underruns++;
+		_primed = false;
+		return;
+	}
+
+	// a packet the host does not take (streaming off) is dropped all the
+	// same, so the ring keeps pace with the USB frames
+	USB_SendIsochronous(pluggedEndpoint, &_ring[tail % Audio_RING_BYTES],
+						Audio_PACKET_BYTES);
+	__asm__ volatile("" ::: "memory");
+	_tail = tail + Audio_PACKET_BYTES;
 }
 
 Audio_::Audio_(void) : PluggableUSBModule(1, 2, epType)
 //Audio_::Audio_(void) : PluggableUSBModule(2, 3, epType)
 {
 	epType[0] = EP_TYPE_ISOCHRONOUS_IN_Audio;		// Audio_ENDPOINT_IN
+	_head = 0;
+	_tail = 0;
+	_primed = false;
+	_underruns = 0;
+	_overruns = 0;
 	PluggableUSB().plug(this);
 }
 
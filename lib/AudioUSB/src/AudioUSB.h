@@ -90,6 +90,14 @@
 
 #endif
 
+// One packet a 1 ms USB frame: 16 samples of 16 kHz 16-bit mono. Packets
+// wait in a ring of Audio_RING_BYTES; after an underrun sending resumes
+// once Audio_PREFILL_BYTES are queued, to absorb the drift between the
+// writer's clock and the USB frames.
+#define Audio_PACKET_BYTES 32
+#define Audio_RING_BYTES 512
+#define Audio_PREFILL_BYTES 128
+
 #define Audio_AUDIO 0x01
 #define Audio_AUDIO_CONTROL 0x01
 #define Audio_STREAMING 0x2
@@ -335,6 +343,15 @@ private:
 	//EPTYPE_DESCRIPTOR_SIZE epType[2];   ///< Container that defines the two isochronous Audio IN/OUT endpoints types
 	EPTYPE_DESCRIPTOR_SIZE epType[3]; ///< Container that defines the two isochronous Audio IN/OUT endpoints types & one bulk for HID
 
+	/// Single producer (write) single consumer (startOfFrame) ring, each index
+	/// is only stored by its own side and free running
+	uint8_t _ring[Audio_RING_BYTES] __attribute__((aligned(4)));
+	volatile uint32_t _head;
+	volatile uint32_t _tail;
+	bool _primed;
+	volatile uint32_t _underruns;
+	volatile uint32_t _overruns;
+
 protected:
 	// Implementation of the PUSBListNode
 
@@ -361,8 +378,15 @@ public:
 	//void flush(void);
 	/// Sends a Audio message to USB
 	//void sendAudio(AudioEventPacket_t event);
-	/// Sends a Audio buffer of length size to USB
+	/// Queues a Audio buffer of length size bytes, without waiting. Returns the
+	/// bytes queued, 0 and an overrun counted if the ring has no room.
 	size_t write(const int16_t *buffer, size_t size);
+	/// Sends the next queued packet, called from the USB Start-Of-Frame interrupt
+	void startOfFrame(void);
+	/// USB frames that found no packet queued
+	uint32_t underruns(void) { return _underruns; }
+	/// writes dropped on a full ring
+	uint32_t overruns(void) { return _overruns; }
 	/// NIY
 	operator bool();
 };
@@ -61,81 +61,170 @@ void NDPClass::init()
     syntiant_ndp10x_micro_load_log(&ndp, NULL, 0);
 }
 
-int NDPClass::spiTransfer(void *d, int mcu, uint32_t address, void *_out,
-                                  void *_in, unsigned int count)
+// Send the command and address bytes of a transfer, leaving chip select
+// asserted for the payload
+static void spiHeader(int mcu, uint32_t address, bool read)
 {
-    uint8_t *out = (uint8_t *)_out;
-    uint8_t *in = (uint8_t *)_in;
-    int s = SYNTIANT_NDP_ERROR_NONE;
     uint8_t dummy[4] = {0};
-    unsigned int i;
-
-    if (in && out) {
-        return SYNTIANT_NDP_ERROR_ARG;
-    }
 
+    digitalWrite(SPI_CS, LOW);
     if (mcu) {
-        if ((count & 0x3) != 0) {
-            return SYNTIANT_NDP_ERROR_ARG;
-        }
-        if (out) {
-            if (spiData != out) {
-                memcpy(spiData, out, count);
-            }
-            digitalWrite(SPI_CS, LOW);
-            SPI.transfer(SPI_MADDR);
-            SPI.transfer(address & 0xff);
-            SPI.transfer((address >> 8) & 0xff);
-            SPI.transfer((address >> 16) & 0xff);
-            SPI.transfer((address >> 24) & 0xff);
-            SPI.transfer(spiData, count);
-            digitalWrite(SPI_CS, HIGH);
-        } else {
-            digitalWrite(SPI_CS, LOW);
-            SPI.transfer(SPI_MADDR);
-
-            SPI.transfer(address & 0xff);
-            SPI.transfer((address >> 8) & 0xff);
-            SPI.transfer((address >> 16) & 0xff);
-            SPI.transfer((address >> 24) & 0xff);
+        SPI.transfer(SPI_MADDR);
+        SPI.transfer(address & 0xff);
+        SPI.transfer((address >> 8) & 0xff);
+        SPI.transfer((address >> 16) & 0xff);
+        SPI.transfer((address >> 24) & 0xff);
 
+        if (read) {
             digitalWrite(SPI_CS, HIGH);
             delayMicroseconds(1);
             digitalWrite(SPI_CS, LOW);
 
             SPI.transfer(0x80 | SPI_MADDR);
             SPI.transfer(dummy, 4);
-            for (i = 0; i < count; i += 4) {
-                SPI.transfer(&in[i], 4);
-            }
-            digitalWrite(SPI_CS, HIGH);
         }
     } else {
-        if (out) {
-            if (out != spiData) {
-                memcpy(spiData, out, count);
-            }
-            if (address == SPI_SAMPLE) {
-                SPI.beginTransaction(SPISettings(spiSpeedSampleWrite,
-                                                 MSBFIRST, SPI_MODE0));
-            }
-            digitalWrite(SPI_CS, LOW);
-            SPI.transfer(address);
-            SPI.transfer(spiData, count);
-            digitalWrite(SPI_CS, HIGH);
+        SPI.transfer(read ? 0x80 | address : address);
+    }
+}
+
+// state of the transfer whose payload is moved by DMA
+static bool spiAsyncSample;
+#if NDP_SPI_STATS
+static uint8_t spiAsyncSite;
+static bool spiAsyncMcu;
+static bool spiAsyncRead;
+static unsigned int spiAsyncCount;
+static uint32_t spiAsyncStart;
+#endif
+
+static void spiDmaBackendStart(void *d, int mcu, uint32_t address,
+                               const uint8_t *out, uint8_t *in,
+                               unsigned int count);
+static void spiDmaBackendWait(void *d);
+
+// queueing and completion of the DMA transfers, and posted writes, see
+// spiPostWrites
+static struct ndp_async_s spiAsync = {
+    {NULL, spiDmaBackendStart, spiDmaBackendWait}
+};
+
+// DMA completion, runs in the DMAC interrupt
+static void spiDmaDone(void *arg, bool ok)
+{
+    digitalWrite(SPI_CS, HIGH);
+    if (spiAsyncSample) {
+        SPI.beginTransaction(SPISettings(spiSpeedGeneral, MSBFIRST, SPI_MODE0));
+    }
+#if NDP_SPI_STATS
+    ndpSpiStatsRecord(spiAsyncSite, spiAsyncMcu, spiAsyncRead, spiAsyncCount,
+                      spiAsyncStart);
+#endif
+    ndpAsyncComplete(&spiAsync, ok);
+}
+
+static void spiDmaBackendStart(void *d, int mcu, uint32_t address,
+                               const uint8_t *out, uint8_t *in,
+                               unsigned int count)
+{
+    spiAsyncSample = !mcu && out && address == SPI_SAMPLE;
+#if NDP_SPI_STATS
+    spiAsyncSite = ndpSpiSite;
+    spiAsyncMcu = mcu;
+    spiAsyncRead = !out;
+    spiAsyncCount = count;
+    spiAsyncStart = micros();
+#endif
+
+    if (spiAsyncSample) {
+        SPI.beginTransaction(SPISettings(spiSpeedSampleWrite,
+                                         MSBFIRST, SPI_MODE0));
+    }
+    spiHeader(mcu, address, !out);
+    ndpDmaStart(out, in, count, spiDmaDone, NULL);
+}
+
+static void spiDmaBackendWait(void *d)
+{
+    ndpDmaWait();
+}
+
+int NDPClass::spiTransfer(void *d, int mcu, uint32_t address, void *_out,
+                                  void *_in, unsigned int count)
+{
+    uint8_t *out = (uint8_t *)_out;
+    uint8_t *in = (uint8_t *)_in;
+    unsigned int i;
+    bool sample;
+
+    if (in && out) {
+        return SYNTIANT_NDP_ERROR_ARG;
+    }
+    if (mcu && (count & 0x3) != 0) {
+        return SYNTIANT_NDP_ERROR_ARG;
+    }
+
+    if (count >= NDP_DMA_MIN_COUNT) {
+        return ndpAsyncTransfer(&spiAsync, mcu, address, out, in, count);
+    }
 
-            if (address == SPI_SAMPLE) {
-                SPI.beginTransaction(SPISettings(spiSpeedGeneral, MSBFIRST,
-                                                 SPI_MODE0));
-            }
+    // chip select may still be held by an asynchronous transfer
+    ndpAsyncFlush(&spiAsync);
+
+#if NDP_SPI_STATS
+    uint32_t start = micros();
+#endif
+    sample = !mcu && out && address == SPI_SAMPLE;
+    if (sample) {
+        SPI.beginTransaction(SPISettings(spiSpeedSampleWrite,
+                                         MSBFIRST, SPI_MODE0));
+    }
+    spiHeader(mcu, address, !out);
+    // byte at a time, the buffer forms of SPI.transfer overwrite out
+    for (i = 0; i < count; i++) {
+        if (out) {
+            SPI.transfer(out[i]);
         } else {
-            digitalWrite(SPI_CS, LOW);
-            SPI.transfer(0x80 | address);
-            SPI.transfer(in, count);
-            digitalWrite(SPI_CS, HIGH);
+            in[i] = SPI.transfer(0);
         }
     }
-    return s;
+    digitalWrite(SPI_CS, HIGH);
+    if (sample) {
+        SPI.beginTransaction(SPISettings(spiSpeedGeneral, MSBFIRST,
+                                         SPI_MODE0));
+    }
+#if NDP_SPI_STATS
+    ndpSpiStatsRecord(ndpSpiSite, mcu, !out, count, start);
+#endif
+    return SYNTIANT_NDP_ERROR_NONE;
+}
+
+int NDPClass::spiTransferAsync(int mcu, uint32_t address, void *_out,
+                               void *_in, unsigned int count,
+                               void (*done)(void *arg, int s), void *arg)
+{
+    return ndpAsyncStart(&spiAsync, mcu, address, (const uint8_t *)_out,
+                         (uint8_t *)_in, count, done, arg);
+}
+
+bool NDPClass::spiTransferBusy(void)
+{
+    return ndpAsyncBusy(&spiAsync);
+}
+
+int NDPClass::spiTransferWait(void)
+{
+    return ndpAsyncWait(&spiAsync);
+}
+
+int NDPClass::spiPostWrites(bool enable)
+{
+    return ndpAsyncPost(&spiAsync, enable);
+}
+
+bool NDPClass::spiWritePending(const void *buf, unsigned int count)
+{
+    return ndpAsyncPending(&spiAsync, buf, count);
 }
 
 // attaches a function returning void to interrupt pin
@@ -147,6 +236,8 @@ void NDPClass::setInterrupt(uint8_t intPin, void (*f)(void))
 
 int NDPClass::loadLog(uint8_t *fileBuf, uint32_t numBytes)
 {
+    NDP_SPI_SITE(NDP_SPI_SITE_LOAD);
+
     return syntiant_ndp10x_micro_load_log(&ndp, fileBuf, numBytes);
 }
 
@@ -157,22 +248,14 @@ int NDPClass::poll(void)
     uint32_t v;
     int match = 0;
 
+    NDP_SPI_SITE(NDP_SPI_SITE_POLL);
+
     s = syntiant_ndp10x_micro_poll(&ndp, &v, 1);
 
     // check from interrupt signaling keyword match
     if (!s && (v & SYNTIANT_NDP10X_MICRO_NOTIFICATION_MATCH)) {
         s = syntiant_ndp10x_micro_get_match(&ndp, &match);
         if (!s && 0 <= match) {
-            // limit range of match class to 11 for google10
-            // (just in case somebody loads a package with even more
-            // classes)
-            if (match < 0) {
-                match = 0;
-            }
-            match &= 0xf;
-            if (match > 10) {
-                match = 10;
-            }
             match += 1; // ensures match is greater than 0.
                         // returning 0 signifies "no match found"
         }
@@ -180,10 +263,19 @@ int NDPClass::poll(void)
     return match;
 }
 
+int NDPClass::pollEvents(struct ndp_events_s *q, uint32_t micros)
+{
+    NDP_SPI_SITE(NDP_SPI_SITE_POLL);
+
+    return ndpEventsDrain(q, &ndp, micros);
+}
+
 int NDPClass::setExtractMatch(unsigned int prefix)
 {
     unsigned int len = prefix;
     
+    NDP_SPI_SITE(NDP_SPI_SITE_TANK);
+
     return syntiant_ndp10x_micro_extract_data
         (&ndp, SYNTIANT_NDP10X_MICRO_EXTRACT_FROM_MATCH, NULL, &len);
 }
@@ -192,12 +284,16 @@ int NDPClass::setExtractNow(void)
 {
     unsigned int len = 0;
     
+    NDP_SPI_SITE(NDP_SPI_SITE_TANK);
+
     return syntiant_ndp10x_micro_extract_data
         (&ndp, SYNTIANT_NDP10X_MICRO_EXTRACT_FROM_NEWEST, NULL, &len);
 }
 
 int NDPClass::extractData(uint8_t *data, unsigned int *len)
 {
+    NDP_SPI_SITE(NDP_SPI_SITE_TANK);
+
     return syntiant_ndp10x_micro_extract_data
         (&ndp, SYNTIANT_NDP10X_MICRO_EXTRACT_FROM_UNREAD, data, len);
 }
@@ -38,6 +38,11 @@
 #include <syntiant_ndp10x_micro_arduino.h>
 
 #include "SPI.h"
+#include "NDP_DMA.h"
+#include "NDP_async.h"
+#include "NDP_events.h"
+#include "NDP_list.h"
+#include "NDP_stats.h"
 
 #if ARDUINO < 10606
 #error NDP requires Arduino IDE 1.6.6 or greater. Please update your IDE.
@@ -86,6 +91,12 @@ class NDPClass
     //   0 < - matched ID n + 1
     int poll(void);
 
+    // Queue every match the NDP has posted since the last poll, see
+    // NDP_events.h. Call from the NDP interrupt instead of poll, with the
+    // micros() the interrupt was raised at.
+    // returns a SYNTIANT_NDP_ERROR_ status code
+    int pollEvents(struct ndp_events_s *q, uint32_t micros);
+
     // Set the data extraction point to now, i.e. flush old data.
     // returns a SYNTIANT_NDP_ERROR_ status code
     int setExtractNow(void);
@@ -117,6 +128,37 @@ class NDPClass
     static int spiTransfer(void *d, int mcu, uint32_t address, void *_out,
                            void *_in, unsigned int count);
 
+    // Start a transfer and return once its payload is handed to DMA.
+    // Same arguments as spiTransfer; the buffer must stay valid until done.
+    // done (in): called from the DMA interrupt with a SYNTIANT_NDP_ERROR_
+    //            status once chip select is released, may be NULL
+    // returns a SYNTIANT_NDP_ERROR_ status code
+    //   NONE: transfer started
+    //   BUSY: a previous transfer has not completed
+    //   ARG:  invalid buffers or count
+    static int spiTransferAsync(int mcu, uint32_t address, void *_out,
+                                void *_in, unsigned int count,
+                                void (*done)(void *arg, int s), void *arg);
+
+    // true while an asynchronous transfer is in progress
+    static bool spiTransferBusy(void);
+
+    // Sleep until the asynchronous transfer completes
+    // returns the SYNTIANT_NDP_ERROR_ status code of the transfer
+    static int spiTransferWait(void);
+
+    // While enabled, spiTransfer returns as soon as a write is handed to
+    // DMA, so the caller can prepare the next buffer meanwhile. The
+    // written buffer must stay untouched until the write completes, see
+    // spiWritePending. A failed write is kept for the caller, not reported
+    // to other spiTransfer users such as the Timer4 interrupt.
+    // returns, when disabling, the SYNTIANT_NDP_ERROR_ status code of the
+    // first posted write that failed
+    static int spiPostWrites(bool enable);
+
+    // true while a posted write is sending from buf[0..count)
+    static bool spiWritePending(const void *buf, unsigned int count);
+
     void setSpiSpeed(uint32_t speed);
     void setSpiSpeedSw(uint32_t speed);
 
@@ -0,0 +1,219 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "NDP_DMA.h"
+
+// The NDP SPI payload is moved between memory and the SERCOM data register
+// by two DMA channels, one per direction. This library owns the DMA
+// controller: nothing else in the firmware uses it.
+
+static DmacDescriptor dmaDescriptors[NDP_DMA_CHANNELS] __attribute__((aligned(16)));
+static volatile DmacDescriptor dmaWriteback[NDP_DMA_CHANNELS] __attribute__((aligned(16)));
+
+static bool dmaInitialized = false;
+static volatile bool dmaBusy = false;
+static ndp_dma_done_f dmaDone = NULL;
+static void *dmaDoneArg = NULL;
+
+// source of the bytes sent during reads, sink of the bytes received
+// during writes
+static const uint8_t dmaZero = 0;
+static uint8_t dmaSink;
+
+static void ndpDmaChannelSetup(uint8_t channel, uint8_t trigger, uint8_t level)
+{
+    DMAC->CHID.reg = DMAC_CHID_ID(channel);
+    DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+    DMAC->CHCTRLA.reg = DMAC_CHCTRLA_SWRST;
+    while (DMAC->CHCTRLA.reg & DMAC_CHCTRLA_SWRST)
+        ;
+    DMAC->CHCTRLB.reg = DMAC_CHCTRLB_LVL(level) | DMAC_CHCTRLB_TRIGSRC(trigger)
+        | DMAC_CHCTRLB_TRIGACT_BEAT;
+}
+
+void ndpDmaInit(void)
+{
+    if (dmaInitialized) {
+        return;
+    }
+
+    PM->AHBMASK.reg |= PM_AHBMASK_DMAC;
+    PM->APBBMASK.reg |= PM_APBBMASK_DMAC;
+
+    DMAC->CTRL.reg &= ~DMAC_CTRL_DMAENABLE;
+    DMAC->CTRL.reg = DMAC_CTRL_SWRST;
+    while (DMAC->CTRL.reg & DMAC_CTRL_SWRST)
+        ;
+
+    memset(dmaDescriptors, 0, sizeof(dmaDescriptors));
+    DMAC->BASEADDR.reg = (uint32_t)dmaDescriptors;
+    DMAC->WRBADDR.reg = (uint32_t)dmaWriteback;
+    DMAC->CTRL.reg = DMAC_CTRL_DMAENABLE | DMAC_CTRL_LVLEN(0xf);
+
+    ndpDmaChannelSetup(NDP_DMA_CH_RX, NDP_DMA_TRIG_RX, 1);
+    ndpDmaChannelSetup(NDP_DMA_CH_TX, NDP_DMA_TRIG_TX, 0);
+
+    // the receive channel finishes last, so only it signals completion
+    DMAC->CHID.reg = DMAC_CHID_ID(NDP_DMA_CH_RX);
+    DMAC->CHINTENSET.reg = DMAC_CHINTENSET_TCMPL | DMAC_CHINTENSET_TERR;
+
+    // Above timer 4 (3), which does most of the NDP accesses, so a transfer
+    // started from its ISR can complete while the ISR sleeps
+    NVIC_ClearPendingIRQ(DMAC_IRQn);
+    NVIC_SetPriority(DMAC_IRQn, 1);
+    NVIC_EnableIRQ(DMAC_IRQn);
+
+    dmaInitialized = true;
+}
+
+void ndpDmaStart(const uint8_t *out, uint8_t *in, unsigned int count,
+                 ndp_dma_done_f done, void *arg)
+{
+    DmacDescriptor *rx = &dmaDescriptors[NDP_DMA_CH_RX];
+    DmacDescriptor *tx = &dmaDescriptors[NDP_DMA_CH_TX];
+    uint32_t data = (uint32_t)&NDP_DMA_SERCOM->SPI.DATA.reg;
+    uint32_t primask;
+
+    ndpDmaInit();
+
+    dmaDone = done;
+    dmaDoneArg = arg;
+    dmaBusy = true;
+
+    // drop anything the byte-wise header transfer left behind
+    while (NDP_DMA_SERCOM->SPI.INTFLAG.bit.RXC) {
+        (void)NDP_DMA_SERCOM->SPI.DATA.reg;
+    }
+    NDP_DMA_SERCOM->SPI.STATUS.reg = SERCOM_SPI_STATUS_BUFOVF;
+
+    // with address increment the descriptor holds the end address
+    rx->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE
+        | (in ? DMAC_BTCTRL_DSTINC : 0);
+    rx->BTCNT.reg = count;
+    rx->SRCADDR.reg = data;
+    rx->DSTADDR.reg = in ? (uint32_t)(in + count) : (uint32_t)&dmaSink;
+    rx->DESCADDR.reg = 0;
+
+    tx->BTCTRL.reg = DMAC_BTCTRL_VALID | DMAC_BTCTRL_BEATSIZE_BYTE
+        | (out ? DMAC_BTCTRL_SRCINC : 0);
+    tx->BTCNT.reg = count;
+    tx->SRCADDR.reg = out ? (uint32_t)(out + count) : (uint32_t)&dmaZero;
+    tx->DSTADDR.reg = data;
+    tx->DESCADDR.reg = 0;
+
+    // CHID is shared with the interrupt handler
+    primask = __get_PRIMASK();
+    __disable_irq();
+    DMAC->CHID.reg = DMAC_CHID_ID(NDP_DMA_CH_RX);
+    DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_ENABLE;
+    DMAC->CHID.reg = DMAC_CHID_ID(NDP_DMA_CH_TX);
+    DMAC->CHCTRLA.reg |= DMAC_CHCTRLA_ENABLE;
+    __set_PRIMASK(primask);
+}
+
+bool ndpDmaBusy(void)
+{
+    return dmaBusy;
+}
+
+// Check the receive channel for completion or error and finish the
+// transfer. Runs from the interrupt handler, or polled when the interrupt
+// cannot preempt the waiting context.
+static void ndpDmaService(void)
+{
+    uint8_t chid = DMAC->CHID.reg;
+    uint8_t flags;
+    ndp_dma_done_f done;
+
+    DMAC->CHID.reg = DMAC_CHID_ID(NDP_DMA_CH_RX);
+    flags = DMAC->CHINTFLAG.reg;
+    DMAC->CHINTFLAG.reg = flags;
+    if (flags & DMAC_CHINTFLAG_TERR) {
+        DMAC->CHID.reg = DMAC_CHID_ID(NDP_DMA_CH_TX);
+        DMAC->CHCTRLA.reg &= ~DMAC_CHCTRLA_ENABLE;
+    }
+    DMAC->CHID.reg = chid;
+
+    if (dmaBusy && (flags & (DMAC_CHINTFLAG_TCMPL | DMAC_CHINTFLAG_TERR))) {
+        done = dmaDone;
+        dmaDone = NULL;
+        dmaBusy = false;
+        if (done) {
+            done(dmaDoneArg, !(flags & DMAC_CHINTFLAG_TERR));
+        }
+    }
+}
+
+void DMAC_Handler(void)
+{
+    ndpDmaService();
+}
+
+// true if the DMAC interrupt can preempt whatever is running now
+static bool ndpDmaCanInterrupt(void)
+{
+    uint32_t ipsr = __get_IPSR();
+
+    if (__get_PRIMASK()) {
+        return false;
+    }
+    if (ipsr == 0) {
+        return true; // thread mode
+    }
+    if (ipsr < 16) {
+        return false; // system exception
+    }
+    return NVIC_GetPriority((IRQn_Type)(ipsr - 16)) > NVIC_GetPriority(DMAC_IRQn);
+}
+
+void ndpDmaWait(void)
+{
+    if (!ndpDmaCanInterrupt()) {
+        while (dmaBusy) {
+            ndpDmaService();
+        }
+        return;
+    }
+
+    // WFI with interrupts masked still wakes on the pending DMAC interrupt,
+    // which closes the race between testing dmaBusy and going to sleep
+    __disable_irq();
+    while (dmaBusy) {
+        // Standby would stop the SERCOM clock
+        if (!(SCB->SCR & SCB_SCR_SLEEPDEEP_Msk)) {
+            __WFI();
+        }
+        __enable_irq();
+        __disable_irq();
+    }
+    __enable_irq();
+}
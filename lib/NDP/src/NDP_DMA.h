@@ -0,0 +1,76 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NDP_DMA_H
+#define NDP_DMA_H
+
+#include <stdint.h>
+#include <Arduino.h>
+
+// SERCOM used by the SPI object that talks to the NDP (MKR pin layout)
+#ifndef NDP_DMA_SERCOM
+#define NDP_DMA_SERCOM SERCOM1
+#define NDP_DMA_TRIG_RX SERCOM1_DMAC_ID_RX
+#define NDP_DMA_TRIG_TX SERCOM1_DMAC_ID_TX
+#endif
+
+// DMA channels used for the NDP SPI payload. The receive channel gets the
+// higher priority so the SERCOM receive buffer never overflows.
+#define NDP_DMA_CH_RX 0
+#define NDP_DMA_CH_TX 1
+#define NDP_DMA_CHANNELS 2
+
+// Payloads shorter than this are clocked by the CPU, the DMA setup is not
+// worth it for a handful of bytes
+#define NDP_DMA_MIN_COUNT 16
+
+// Called from the DMAC interrupt once the last payload byte was received,
+// ok is false on a DMA bus error
+typedef void (*ndp_dma_done_f)(void *arg, bool ok);
+
+// Enable the DMA controller and claim the two NDP SPI channels
+void ndpDmaInit(void);
+
+// Start moving count bytes through the SPI data register.
+// out (in): bytes to send, or NULL to send zeros
+// in (in): buffer for the received bytes, or NULL to discard them
+// The caller owns chip select and must have sent the command header.
+void ndpDmaStart(const uint8_t *out, uint8_t *in, unsigned int count,
+                 ndp_dma_done_f done, void *arg);
+
+// true while a payload is being moved
+bool ndpDmaBusy(void);
+
+// Wait for the current payload, sleeping until the DMAC interrupt
+void ndpDmaWait(void);
+
+#endif
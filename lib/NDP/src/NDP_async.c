@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "NDP_async.h"
+
+void ndpAsyncInit(struct ndp_async_s *a,
+                  const struct ndp_async_backend_s *backend)
+{
+    memset(a, 0, sizeof(*a));
+    a->backend = *backend;
+}
+
+int ndpAsyncStart(struct ndp_async_s *a, int mcu, uint32_t address,
+                  const uint8_t *out, uint8_t *in, unsigned int count,
+                  ndp_async_done_f done, void *arg)
+{
+    if (in && out) {
+        return SYNTIANT_NDP_ERROR_ARG;
+    }
+    if (mcu && (count & 0x3) != 0) {
+        return SYNTIANT_NDP_ERROR_ARG;
+    }
+    if (count == 0 || NDP_ASYNC_MAX_COUNT < count) {
+        return SYNTIANT_NDP_ERROR_ARG;
+    }
+    if (a->busy) {
+        return SYNTIANT_NDP_ERROR_BUSY;
+    }
+
+    a->done = done;
+    a->arg = arg;
+    a->status = SYNTIANT_NDP_ERROR_NONE;
+    a->busy = 1;
+    a->started++;
+    a->backend.start(a->backend.d, mcu, address, out, in, count);
+    return SYNTIANT_NDP_ERROR_NONE;
+}
+
+void ndpAsyncComplete(struct ndp_async_s *a, int ok)
+{
+    ndp_async_done_f done = a->done;
+
+    if (!a->busy) {
+        return;
+    }
+    a->status = ok ? SYNTIANT_NDP_ERROR_NONE : SYNTIANT_NDP_ERROR_FAIL;
+    a->failed += !ok;
+    a->completed++;
+    a->done = NULL;
+    a->busy = 0;
+    if (done) {
+        done(a->arg, a->status);
+    }
+}
+
+int ndpAsyncBusy(const struct ndp_async_s *a)
+{
+    return a->busy;
+}
+
+int ndpAsyncWait(struct ndp_async_s *a)
+{
+    while (a->busy) {
+        a->backend.wait(a->backend.d);
+    }
+    return a->status;
+}
+
+void ndpAsyncFlush(struct ndp_async_s *a)
+{
+    int s = ndpAsyncWait(a);
+
+    if (a->posted) {
+        a->posted = 0;
+        if (!a->postedStatus) {
+            a->postedStatus = s;
+        }
+    }
+}
+
+int ndpAsyncTransfer(struct ndp_async_s *a, int mcu, uint32_t address,
+                     const uint8_t *out, uint8_t *in, unsigned int count)
+{
+    int s;
+
+    ndpAsyncFlush(a);
+    s = ndpAsyncStart(a, mcu, address, out, in, count, NULL, NULL);
+    if (s) {
+        return s;
+    }
+    if (a->post && out) {
+        a->posted = 1;
+        a->postedOut = out;
+        a->postedCount = count;
+        return SYNTIANT_NDP_ERROR_NONE;
+    }
+    return ndpAsyncWait(a);
+}
+
+int ndpAsyncPost(struct ndp_async_s *a, int enable)
+{
+    int s;
+
+    a->post = enable;
+    if (enable) {
+        return SYNTIANT_NDP_ERROR_NONE;
+    }
+    ndpAsyncFlush(a);
+    s = a->postedStatus;
+    a->postedStatus = SYNTIANT_NDP_ERROR_NONE;
+    return s;
+}
+
+int ndpAsyncPending(const struct ndp_async_s *a, const void *buf,
+                    unsigned int count)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+
+    return a->posted && a->busy && p < a->postedOut + a->postedCount
+        && a->postedOut < p + count;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NDP_ASYNC_H
+#define NDP_ASYNC_H
+
+#include <stdint.h>
+#include <syntiant_ndp10x_micro_arduino.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Asynchronous transfer queue. One transfer is in flight at a time: its
+// payload is moved by a backend, the DMA engine on the board and a mock in
+// the host simulator, which calls ndpAsyncComplete once the last byte has
+// moved, from its interrupt. With posting on, ndpAsyncTransfer returns as
+// soon as a write is started; the next transfer, or ndpAsyncFlush, waits
+// for it. A posted write fails for the context that posted it, not for
+// whichever flushes next (the Timer4 interrupt polling the NDP): its status
+// is kept until ndpAsyncPost turns posting off.
+struct ndp_async_backend_s {
+    void *d;
+    // send the header and start moving count payload bytes
+    void (*start)(void *d, int mcu, uint32_t address, const uint8_t *out,
+                  uint8_t *in, unsigned int count);
+    // return once ndpAsyncComplete has run, sleeping if the caller can
+    void (*wait)(void *d);
+};
+
+typedef void (*ndp_async_done_f)(void *arg, int s);
+
+struct ndp_async_s {
+    struct ndp_async_backend_s backend;
+
+    volatile int busy;
+    volatile int status; // SYNTIANT_NDP_ERROR_ code of the last transfer
+    ndp_async_done_f done;
+    void *arg;
+
+    int post;         // posting enabled
+    int posted;       // the transfer in flight is a posted write
+    int postedStatus; // first failed posted write, until ndpAsyncPost(0)
+    const uint8_t *postedOut;
+    unsigned int postedCount;
+
+    unsigned long started;   // transfers started
+    unsigned long completed; // transfers ndpAsyncComplete finished
+    unsigned long failed;
+};
+
+// limited by the DMA block transfer count
+#define NDP_ASYNC_MAX_COUNT 0xffffU
+
+void ndpAsyncInit(struct ndp_async_s *a,
+                  const struct ndp_async_backend_s *backend);
+
+// Start a transfer, out and in as the ilib transfer function. done, if not
+// NULL, is called from ndpAsyncComplete with the transfer's status.
+// Returns NONE, BUSY while a transfer is in flight or ARG.
+int ndpAsyncStart(struct ndp_async_s *a, int mcu, uint32_t address,
+                  const uint8_t *out, uint8_t *in, unsigned int count,
+                  ndp_async_done_f done, void *arg);
+
+// Called by the backend, from its interrupt, ok is 0 on a bus error
+void ndpAsyncComplete(struct ndp_async_s *a, int ok);
+
+int ndpAsyncBusy(const struct ndp_async_s *a);
+
+// Wait for the transfer in flight. Returns its status.
+int ndpAsyncWait(struct ndp_async_s *a);
+
+// Wait for the transfer in flight. A posted write's failure goes to
+// postedStatus.
+void ndpAsyncFlush(struct ndp_async_s *a);
+
+// Flush, then start a transfer and wait for it, or with posting on leave
+// a write in flight. Returns a SYNTIANT_NDP_ERROR_ code, never that of an
+// earlier posted write.
+int ndpAsyncTransfer(struct ndp_async_s *a, int mcu, uint32_t address,
+                     const uint8_t *out, uint8_t *in, unsigned int count);
+
+// Enable or disable posting. Disabling flushes and returns the status of
+// the first posted write that failed since it was last disabled, then
+// forgets it.
+int ndpAsyncPost(struct ndp_async_s *a, int enable);
+
+// true while a posted write is sending from buf[0..count)
+int ndpAsyncPending(const struct ndp_async_s *a, const void *buf,
+                    unsigned int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,278 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "NDP_bridge.h"
+
+// op code, address and count bytes
+#define OP_HEADER(mcu) ((mcu) ? 7U : 4U)
+#define OP_MCU(op) (!((op) & 0x2))
+#define OP_WRITE(op) ((op) & 0x1)
+
+// response assembled in io->chunk
+struct bridge_out_s {
+    const struct ndp_bridge_io_s *io;
+    unsigned int n;
+    uint16_t crc;
+};
+
+static uint32_t getLE(const uint8_t *p, unsigned int size)
+{
+    uint32_t v = 0;
+
+    while (size--) {
+        v = (v << 8) | p[size];
+    }
+    return v;
+}
+
+static void putLE(uint8_t *p, uint32_t v, unsigned int size)
+{
+    while (size--) {
+        *p++ = v & 0xff;
+        v >>= 8;
+    }
+}
+
+uint16_t ndpBridgeCrc16(uint16_t crc, const void *data, unsigned int count)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    int i;
+
+    while (count--) {
+        crc ^= (uint16_t)(*p++ << 8);
+        for (i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021)
+                                 : (uint16_t)(crc << 1);
+        }
+    }
+    return crc;
+}
+
+static void outFlush(struct bridge_out_s *out)
+{
+    if (out->n) {
+        out->io->write(out->io->ctx, out->io->chunk, out->n);
+        out->n = 0;
+    }
+}
+
+// bytes at out->io->chunk + out->n were filled in, count them and
+// checksum them
+static void outCommit(struct bridge_out_s *out, unsigned int count)
+{
+    out->crc = ndpBridgeCrc16(out->crc, out->io->chunk + out->n, count);
+    out->n += count;
+    if (out->n == out->io->chunkSize) {
+        outFlush(out);
+    }
+}
+
+static void outBytes(struct bridge_out_s *out, const uint8_t *data,
+                     unsigned int count)
+{
+    unsigned int piece;
+
+    while (count) {
+        piece = out->io->chunkSize - out->n;
+        piece = count < piece ? count : piece;
+        memcpy(out->io->chunk + out->n, data, piece);
+        outCommit(out, piece);
+        data += piece;
+        count -= piece;
+    }
+}
+
+// Checks the ops before anything is executed. Returns the status and the
+// number of bytes the reads will return.
+static int checkOps(const uint8_t *p, unsigned int len, uint32_t *readBytes)
+{
+    unsigned int off = 0;
+    unsigned int n;
+    unsigned int count;
+    int op;
+
+    *readBytes = 0;
+    while (off < len) {
+        op = p[off];
+        if (op > NDP_BRIDGE_DIRECT_WRITE) {
+            return NDP_BRIDGE_BAD_OP;
+        }
+        n = OP_HEADER(OP_MCU(op));
+        if (len - off < n) {
+            return NDP_BRIDGE_BAD_OP;
+        }
+        count = getLE(p + off + n - 2, 2);
+        if (OP_MCU(op) && (count & 0x3)) {
+            return NDP_BRIDGE_BAD_OP;
+        }
+        if (OP_WRITE(op)) {
+            if (len - off - n < count) {
+                return NDP_BRIDGE_BAD_OP;
+            }
+            n += count;
+        } else {
+            *readBytes += count;
+        }
+        off += n;
+    }
+    return NDP_BRIDGE_OK;
+}
+
+// Reads straight into the response buffer. After a failed transfer the
+// remaining bytes are sent as zeros so the length still holds.
+static int readOp(struct bridge_out_s *out, int mcu, uint32_t address,
+                  unsigned int count, int status)
+{
+    const struct ndp_bridge_io_s *io = out->io;
+    unsigned int piece;
+
+    while (count) {
+        piece = io->chunkSize - out->n;
+        if (mcu) {
+            piece &= ~0x3U;
+            if (!piece) {
+                outFlush(out);
+                continue;
+            }
+        }
+        piece = count < piece ? count : piece;
+        if (status == NDP_BRIDGE_OK
+            && io->transfer(io->d, mcu, address, NULL, io->chunk + out->n,
+                            piece)) {
+            status = NDP_BRIDGE_SPI;
+        }
+        if (status != NDP_BRIDGE_OK) {
+            memset(io->chunk + out->n, 0, piece);
+        }
+        outCommit(out, piece);
+        if (mcu) {
+            address += piece;
+        }
+        count -= piece;
+    }
+    return status;
+}
+
+static int runOps(struct bridge_out_s *out, const uint8_t *p,
+                  unsigned int len)
+{
+    const struct ndp_bridge_io_s *io = out->io;
+    int status = NDP_BRIDGE_OK;
+    unsigned int off = 0;
+    unsigned int count;
+    uint32_t address;
+    int op;
+    int mcu;
+
+    while (off < len) {
+        op = p[off];
+        mcu = OP_MCU(op);
+        address = getLE(p + off + 1, mcu ? 4 : 1);
+        off += OP_HEADER(mcu);
+        count = getLE(p + off - 2, 2);
+
+        if (!OP_WRITE(op)) {
+            status = readOp(out, mcu, address, count, status);
+            continue;
+        }
+        if (status == NDP_BRIDGE_OK && count) {
+            // the op bytes are not needed again, transfers may use them
+            if (io->transfer(io->d, mcu, address, (void *)(p + off), NULL,
+                             count)) {
+                status = NDP_BRIDGE_SPI;
+            } else if (io->written) {
+                io->written(io->ctx, mcu, address, p + off, count);
+            }
+        }
+        off += count;
+    }
+    return status;
+}
+
+int ndpBridgeFrame(const struct ndp_bridge_io_s *io)
+{
+    struct bridge_out_s out;
+    uint8_t header[7];
+    uint8_t tail[3];
+    unsigned int len;
+    unsigned int piece;
+    uint32_t readBytes = 0;
+    int status;
+
+    // seq and len; without them there is nothing to answer
+    if (io->read(io->ctx, header, 3) != 3) {
+        return NDP_BRIDGE_SHORT;
+    }
+    len = getLE(header + 1, 2);
+
+    if (len > io->frameSize) {
+        // drain the ops and crc so the next frame starts in sync
+        for (len += 2; len; len -= piece) {
+            piece = len < io->chunkSize ? len : io->chunkSize;
+            if (io->read(io->ctx, io->chunk, piece) != piece) {
+                break;
+            }
+        }
+        status = NDP_BRIDGE_TOO_LONG;
+    } else if (io->read(io->ctx, io->frame, len) != len
+               || io->read(io->ctx, tail, 2) != 2) {
+        status = NDP_BRIDGE_SHORT;
+    } else if (ndpBridgeCrc16(ndpBridgeCrc16(0xffff, header, 3), io->frame,
+                              len) != getLE(tail, 2)) {
+        status = NDP_BRIDGE_CRC;
+    } else {
+        status = checkOps(io->frame, len, &readBytes);
+    }
+    if (status != NDP_BRIDGE_OK) {
+        readBytes = 0;
+    }
+
+    out.io = io;
+    out.n = 0;
+    out.crc = 0xffff;
+    io->chunk[out.n++] = NDP_BRIDGE_SYNC;
+    header[1] = header[0];
+    putLE(header + 2, readBytes, 4);
+    outBytes(&out, header + 1, 5);
+
+    if (status == NDP_BRIDGE_OK) {
+        status = runOps(&out, io->frame, len);
+    }
+
+    tail[0] = (uint8_t)status;
+    outBytes(&out, tail, 1);
+    putLE(tail, out.crc, 2);
+    outBytes(&out, tail, 2);
+    outFlush(&out);
+    return status;
+}
@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NDP_BRIDGE_H
+#define NDP_BRIDGE_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Bridge protocol v2: framed, checksummed batches of NDP register
+// operations. A host may send several frames without waiting for the
+// responses; each response echoes the sequence number of its request.
+// Multi-byte fields are little endian. The CRC is CRC-16/CCITT-FALSE over
+// every byte after the sync byte.
+//
+// request:  sync, seq, len[2], ops[len], crc[2]
+// response: sync, seq, len[4], data[len], status, crc[2]
+//
+// ops, back to back:
+//   INDIRECT_READ   op, address[4], count[2]
+//   INDIRECT_WRITE  op, address[4], count[2], data[count]
+//   DIRECT_READ     op, address[1], count[2]
+//   DIRECT_WRITE    op, address[1], count[2], data[count]
+//
+// The response data is the read data of all ops in order. The status
+// follows the data so reads can be streamed as they complete; if the
+// frame was rejected len is 0.
+#define NDP_BRIDGE_SYNC 0xa5
+
+// Op codes, the same as the legacy ':' commands
+enum ndp_bridge_op_e {
+    NDP_BRIDGE_INDIRECT_READ = 0x00,
+    NDP_BRIDGE_INDIRECT_WRITE = 0x01,
+    NDP_BRIDGE_DIRECT_READ = 0x02,
+    NDP_BRIDGE_DIRECT_WRITE = 0x03
+};
+
+enum ndp_bridge_status_e {
+    NDP_BRIDGE_OK = 0,
+    NDP_BRIDGE_SHORT = 1,    // the frame ended early (read timeout)
+    NDP_BRIDGE_CRC = 2,      // checksum mismatch, nothing was executed
+    NDP_BRIDGE_TOO_LONG = 3, // ops larger than the frame buffer
+    NDP_BRIDGE_BAD_OP = 4,   // unknown or truncated op, MCU count not x4
+    NDP_BRIDGE_SPI = 5       // an NDP transfer failed, data is incomplete
+};
+
+struct ndp_bridge_io_s {
+    // host link. read returns the number of bytes read, fewer than count
+    // on timeout
+    void *ctx;
+    unsigned int (*read)(void *ctx, void *buf, unsigned int count);
+    void (*write)(void *ctx, const void *buf, unsigned int count);
+
+    // NDP access, as the ilib transfer function
+    void *d;
+    int (*transfer)(void *d, int mcu, uint32_t address, void *out, void *in,
+                    unsigned int count);
+
+    // called after each write op, may be NULL
+    void (*written)(void *ctx, int mcu, uint32_t address,
+                    const uint8_t *data, unsigned int count);
+
+    // holds the request ops, bounds the request size
+    uint8_t *frame;
+    unsigned int frameSize;
+
+    // response assembly, at least 16 bytes
+    uint8_t *chunk;
+    unsigned int chunkSize;
+};
+
+uint16_t ndpBridgeCrc16(uint16_t crc, const void *data, unsigned int count);
+
+// Receive one request, after its sync byte, execute it and send the
+// response. Returns an ndp_bridge_status_e. Nothing is sent if the
+// sequence number and length never arrive.
+int ndpBridgeFrame(const struct ndp_bridge_io_s *io);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
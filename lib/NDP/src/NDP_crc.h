@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NDP_CRC_H
+#define NDP_CRC_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// CRC-32 (IEEE 802.3, reflected polynomial 0xedb88320), the same value as
+// zlib's crc32(). Start with 0 and pass the previous result to continue
+// over the next chunk.
+//
+// Table driven, one 1 KB table in flash. Aligned data is taken a word at a
+// time: one load and one xor per 4 bytes, then 4 table steps. About 9
+// cycles a byte on a Cortex-M0+, against about 70 for the bit loop.
+uint32_t ndpCrc32(uint32_t crc, const void *data, unsigned int count);
+
+extern const uint32_t ndpCrc32Table[256];
+
+// A model digest is kept next to the model package with the extension
+// NDP_DIGEST_EXTENSION. When it is there the loader checks the CRC-32 of
+// every byte it feeds the uILib against it.
+#define NDP_DIGEST_MAGIC 0x4347444eU // "NDGC"
+#define NDP_DIGEST_EXTENSION ".crc"
+
+struct ndp_digest_s {
+    uint32_t magic;
+    uint32_t logBytes; // size of the model package
+    uint32_t crc;      // ndpCrc32 of the model package
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "NDP_events.h"
+
+void ndpEventsInit(struct ndp_events_s *q)
+{
+    memset(q, 0, sizeof(*q));
+}
+
+int ndpEventsPut(struct ndp_events_s *q, const struct ndp_event_s *e)
+{
+    uint32_t head = q->head;
+
+    if (head - q->tail == NDP_EVENTS_SIZE) {
+        q->lost++;
+        return 0;
+    }
+    q->ring[head & (NDP_EVENTS_SIZE - 1)] = *e;
+    // the event is in place before the consumer can see it
+    __sync_synchronize();
+    q->head = head + 1;
+    return 1;
+}
+
+int ndpEventsGet(struct ndp_events_s *q, struct ndp_event_s *e)
+{
+    uint32_t tail = q->tail;
+
+    if (tail == q->head) {
+        return 0;
+    }
+    __sync_synchronize();
+    *e = q->ring[tail & (NDP_EVENTS_SIZE - 1)];
+    // and copied out before the producer can reuse its slot
+    __sync_synchronize();
+    q->tail = tail + 1;
+    return 1;
+}
+
+uint32_t ndpEventsPending(const struct ndp_events_s *q)
+{
+    return q->head - q->tail;
+}
+
+int ndpEventsDrain(struct ndp_events_s *q,
+                   struct syntiant_ndp10x_micro_device_s *ndp,
+                   uint32_t micros)
+{
+    struct syntiant_ndp10x_micro_match_s m;
+    struct ndp_event_s e;
+    uint32_t causes;
+    int s;
+
+    s = syntiant_ndp10x_micro_poll(ndp, &causes, 1);
+    e.micros = micros;
+    // one entry a call, a non match entry gives -1
+    while (!s && ndp->match_producer != ndp->match_consumer) {
+        s = syntiant_ndp10x_micro_get_match_record(ndp, &m);
+        if (s) {
+            break;
+        }
+        q->entries++;
+        q->multiple += m.multiple;
+        if (0 <= m.match) {
+            e.winner = m.match;
+            e.summary = m.summary;
+            e.tankPtr = m.tankptr;
+            q->newest = e;
+            ndpEventsPut(q, &e);
+        }
+    }
+    return s;
+}
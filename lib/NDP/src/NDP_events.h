@@ -0,0 +1,98 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NDP_EVENTS_H
+#define NDP_EVENTS_H
+
+#include <stdint.h>
+#include <syntiant_ndp10x_micro_arduino.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Match event queue. The NDP firmware posts each match into a ring in its
+// state and raises one interrupt until the host answers, however many it
+// posts meanwhile; the ilib's get_match takes one entry a call. After an
+// NDP interrupt ndpEventsDrain takes every pending entry and queues the
+// matches with their class, summary word, holding tank pointer and the time
+// the NDP signaled them, for the main loop to take with ndpEventsGet.
+//
+// The entry holds no posteriors: the NDP posts a match once its posterior
+// handler has passed the class threshold, and keeps only the summary.
+//
+// One interrupt puts and one main loop gets: each side writes only its own
+// counter, so neither needs to mask the other. A full queue keeps the
+// oldest events and counts the ones it could not take.
+#define NDP_EVENTS_SIZE 16 // a power of 2
+
+struct ndp_event_s {
+    int winner;       // matched class, from 0
+    uint32_t summary; // match summary word as the NDP posted it
+    uint32_t tankPtr; // holding tank offset of the match
+    uint32_t micros;  // time of the NDP interrupt that signaled the match
+};
+
+struct ndp_events_s {
+    struct ndp_event_s ring[NDP_EVENTS_SIZE];
+    volatile uint32_t head; // events put, free running
+    volatile uint32_t tail; // events taken, free running
+
+    struct ndp_event_s newest; // last match drained, for the interrupt
+    unsigned long entries;     // match ring entries drained
+    unsigned long multiple;    // entries where more than one class matched
+    unsigned long lost;        // matches the full queue could not take
+};
+
+void ndpEventsInit(struct ndp_events_s *q);
+
+// Queue an event. Returns 0 if the queue is full.
+int ndpEventsPut(struct ndp_events_s *q, const struct ndp_event_s *e);
+
+// Take the oldest event. Returns 0 if there is none.
+int ndpEventsGet(struct ndp_events_s *q, struct ndp_event_s *e);
+
+uint32_t ndpEventsPending(const struct ndp_events_s *q);
+
+// Poll the NDP, clearing its interrupt, and queue every match in its match
+// ring, stamped with micros, the time the interrupt was raised. The ilib's
+// extract point is left at the newest one. Returns a SYNTIANT_NDP_ERROR_
+// status code.
+int ndpEventsDrain(struct ndp_events_s *q,
+                   struct syntiant_ndp10x_micro_device_s *ndp,
+                   uint32_t micros);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,152 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "NDP_flash.h"
+
+static int ctl(struct ndp_flash_s *f, uint32_t mode)
+{
+    uint32_t v = f->spictl | mode;
+
+    f->transfers++;
+    return (f->transfer)(f->d, 1, NDP_FLASH_SPICTL, &v, 0, sizeof(v));
+}
+
+static int readCtl(struct ndp_flash_s *f, uint32_t *v)
+{
+    f->transfers++;
+    return (f->transfer)(f->d, 1, NDP_FLASH_SPICTL, 0, v, sizeof(*v));
+}
+
+// issue the read command at f->address, SPICTL already in f->spictl
+static int command(struct ndp_flash_s *f)
+{
+    uint32_t v = NDP_FLASH_READ + f->address;
+    int s;
+
+    f->open = 0;
+    s = ctl(f, NDP_FLASH_MODE_IDLE);
+    s = s ? s : ctl(f, NDP_FLASH_MODE_ENABLE);
+    if (!s) {
+        f->transfers++;
+        s = (f->transfer)(f->d, 1, NDP_FLASH_SPITX, &v, 0, sizeof(v));
+    }
+    s = s ? s : ctl(f, NDP_FLASH_MODE_TRANSFER);
+    do {
+        s = s ? s : readCtl(f, &v);
+    } while (!s && !(v & NDP_FLASH_SPICTL_DONE));
+    f->open = !s;
+    return s;
+}
+
+int ndpFlashOpen(struct ndp_flash_s *f, uint32_t address)
+{
+    uint32_t v;
+    int s;
+
+    s = readCtl(f, &v);
+    if (s) {
+        return s;
+    }
+    // 4 byte transfers, as writeNumBytes(3)
+    f->spictl = ((v | NDP_FLASH_SPICTL_ENABLE) & ~NDP_FLASH_SPICTL_MODE)
+        | NDP_FLASH_SPICTL_NUMBYTES;
+    f->address = address;
+    return command(f);
+}
+
+static int word(struct ndp_flash_s *f, uint32_t *v)
+{
+    int s;
+
+    s = ctl(f, NDP_FLASH_MODE_UPDATE);
+    s = s ? s : ctl(f, NDP_FLASH_MODE_TRANSFER);
+    if (!s) {
+        f->transfers++;
+        s = (f->transfer)(f->d, 1, NDP_FLASH_SPIRX, 0, v, sizeof(*v));
+    }
+    f->address += 4;
+    return s;
+}
+
+int ndpFlashReadWords(struct ndp_flash_s *f, uint32_t *words, unsigned int n)
+{
+    int s = f->open ? 0 : command(f);
+
+    while (!s && n--) {
+        s = word(f, words++);
+    }
+    return s;
+}
+
+int ndpFlashRead(struct ndp_flash_s *f, uint8_t *buf, unsigned int count)
+{
+    unsigned int step = f->packed ? 3 : 4;
+    uint32_t v;
+    int s = f->open ? 0 : command(f);
+
+    for (; !s && step <= count; count -= step) {
+        s = word(f, &v);
+        if (!f->packed) {
+            *buf++ = (uint8_t)v;
+        }
+        *buf++ = (uint8_t)(v >> 8);
+        *buf++ = (uint8_t)(v >> 16);
+        *buf++ = (uint8_t)(v >> 24);
+    }
+    return s;
+}
+
+int ndpFlashResume(struct ndp_flash_s *f)
+{
+    uint32_t keep = NDP_FLASH_SPICTL_ENABLE | NDP_FLASH_SPICTL_NUMBYTES
+        | NDP_FLASH_SPICTL_MODE;
+    uint32_t v;
+    int s;
+
+    s = readCtl(f, &v);
+    if (s) {
+        return s;
+    }
+    if (f->open
+        && (v & keep) == ((f->spictl & keep) | NDP_FLASH_MODE_TRANSFER)) {
+        return 0;
+    }
+    f->spictl = ((v | NDP_FLASH_SPICTL_ENABLE) & ~NDP_FLASH_SPICTL_MODE)
+        | NDP_FLASH_SPICTL_NUMBYTES;
+    return command(f);
+}
+
+int ndpFlashClose(struct ndp_flash_s *f)
+{
+    f->open = 0;
+    return ctl(f, NDP_FLASH_MODE_IDLE);
+}
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NDP_FLASH_H
+#define NDP_FLASH_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Streaming reader for the serial flash on the NDP master SPI port, where
+// the NDP9101 USB dongle keeps its models.
+//
+// The master SPI clocks at most 4 bytes each time CHIP_CONFIG_SPICTL is
+// switched to transfer mode, so every flash word costs a re-arm write, a
+// transfer write and an SPIRX read. The reader keeps its own copy of
+// SPICTL, issues the flash read command once and keeps it streaming
+// across blocks, and unpacks the 3 byte "flash bug" layout as it goes.
+#define NDP_FLASH_SPICTL 0x40009014U
+#define NDP_FLASH_SPITX 0x40009018U
+#define NDP_FLASH_SPIRX 0x4000901cU
+
+#define NDP_FLASH_SPICTL_MODE 0x003U
+#define NDP_FLASH_SPICTL_NUMBYTES 0x00cU
+#define NDP_FLASH_SPICTL_ENABLE 0x100U
+#define NDP_FLASH_SPICTL_DONE 0x200U
+
+// SPICTL modes, as enum mspi_modes_e
+#define NDP_FLASH_MODE_IDLE 0x0U
+#define NDP_FLASH_MODE_ENABLE 0x1U
+#define NDP_FLASH_MODE_TRANSFER 0x2U
+#define NDP_FLASH_MODE_UPDATE 0x3U
+
+// The read command goes out as FLASH_READ + address
+#define NDP_FLASH_READ 0x03U
+
+struct ndp_flash_s {
+    // NDP access, as the ilib transfer function
+    void *d;
+    int (*transfer)(void *d, int mcu, uint32_t address, void *out, void *in,
+                    unsigned int count);
+
+    // 3 data bytes in the high bytes of each flash word
+    int packed;
+
+    // reader state
+    uint32_t address; // flash address of the next word
+    uint32_t spictl;  // SPICTL with the mode bits clear
+    int open;
+
+    unsigned long transfers; // NDP transfers issued
+};
+
+// Enable the master SPI and start reading at flash address. Returns 0 or
+// the status of the failing transfer.
+int ndpFlashOpen(struct ndp_flash_s *f, uint32_t address);
+
+// Read n raw flash words
+int ndpFlashReadWords(struct ndp_flash_s *f, uint32_t *words, unsigned int n);
+
+// Read count data bytes, a multiple of 3 if packed, otherwise of 4
+int ndpFlashRead(struct ndp_flash_s *f, uint8_t *buf, unsigned int count);
+
+// Call after anything else used the NDP. One SPICTL read tells whether the
+// read command is still streaming; if the port was reset or reprogrammed
+// the command is issued again at the next word.
+int ndpFlashResume(struct ndp_flash_s *f);
+
+// End the read command, leaving the master SPI enabled
+int ndpFlashClose(struct ndp_flash_s *f);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
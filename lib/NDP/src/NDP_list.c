@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "NDP_list.h"
+
+// Move n consecutive words in transactions of at most NDP_LIST_MAX_BYTES
+static int burst(ndp_list_transfer_f transfer, void *d, uint32_t address,
+                 const uint32_t *out, uint32_t *in, unsigned int n,
+                 unsigned int *transactions)
+{
+    unsigned int chunk;
+    int s;
+
+    while (n) {
+        chunk = n < NDP_LIST_MAX_BYTES / 4 ? n : NDP_LIST_MAX_BYTES / 4;
+        s = transfer(d, 1, address, (void *)out, in, chunk * 4);
+        if (transactions) {
+            (*transactions)++;
+        }
+        if (s) {
+            return s;
+        }
+        address += chunk * 4;
+        out = out ? out + chunk : out;
+        in = in ? in + chunk : in;
+        n -= chunk;
+    }
+    return 0;
+}
+
+int ndpReadList(ndp_list_transfer_f transfer, void *d,
+                const uint32_t *addresses, uint32_t *words, unsigned int n,
+                unsigned int *transactions)
+{
+    uint32_t scratch[NDP_LIST_SCRATCH_WORDS];
+    unsigned int i = 0;
+    unsigned int j, k, span;
+    int gaps, hole, s;
+
+    while (i < n) {
+        // extend the run while the next address follows closely
+        gaps = 0;
+        span = 1;
+        for (j = i + 1; j < n; j++) {
+            if (addresses[j] <= addresses[j - 1]
+                || (addresses[j] - addresses[j - 1]) & 0x3
+                || NDP_LIST_GAP_WORDS
+                   < (addresses[j] - addresses[j - 1]) / 4 - 1) {
+                break;
+            }
+            hole = addresses[j] != addresses[j - 1] + 4;
+            if ((gaps || hole) && NDP_LIST_SCRATCH_WORDS
+                < (addresses[j] - addresses[i]) / 4 + 1) {
+                break;
+            }
+            gaps = gaps || hole;
+            span = (addresses[j] - addresses[i]) / 4 + 1;
+        }
+
+        if (gaps) {
+            s = burst(transfer, d, addresses[i], 0, scratch, span,
+                      transactions);
+            for (k = i; !s && k < j; k++) {
+                words[k] = scratch[(addresses[k] - addresses[i]) / 4];
+            }
+        } else {
+            s = burst(transfer, d, addresses[i], 0, &words[i], span,
+                      transactions);
+        }
+        if (s) {
+            return s;
+        }
+        i = j;
+    }
+    return 0;
+}
+
+int ndpWriteList(ndp_list_transfer_f transfer, void *d,
+                 const uint32_t *addresses, const uint32_t *words,
+                 unsigned int n, unsigned int *transactions)
+{
+    unsigned int i = 0;
+    unsigned int j;
+    int s;
+
+    while (i < n) {
+        for (j = i + 1; j < n && addresses[j] == addresses[j - 1] + 4; j++)
+            ;
+        s = burst(transfer, d, addresses[i], &words[i], 0, j - i,
+                  transactions);
+        if (s) {
+            return s;
+        }
+        i = j;
+    }
+    return 0;
+}
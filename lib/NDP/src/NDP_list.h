@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NDP_LIST_H
+#define NDP_LIST_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Scatter-gather MCU access. Every MADDR transaction costs chip select
+// frames, a 5 byte address and, for reads, 4 dummy bytes before its data,
+// so runs of ascending addresses in a list are merged into single
+// transactions of at most NDP_LIST_MAX_BYTES. Reads also span holes of up
+// to NDP_LIST_GAP_WORDS unused words, cheaper than the about 14 bytes of
+// another transaction; writes can't, they would overwrite the holes.
+#define NDP_LIST_MAX_BYTES 2048U
+#define NDP_LIST_GAP_WORDS 4U
+#define NDP_LIST_SCRATCH_WORDS 64U // longest run read through holes
+
+// NDP access, as the ilib transfer function
+typedef int (*ndp_list_transfer_f)(void *d, int mcu, uint32_t address,
+                                   void *out, void *in, unsigned int count);
+
+// Read words[i] from addresses[i], for i < n. transactions, if not NULL,
+// is incremented by the transactions issued. Returns 0 or the status of
+// the failing transfer.
+int ndpReadList(ndp_list_transfer_f transfer, void *d,
+                const uint32_t *addresses, uint32_t *words, unsigned int n,
+                unsigned int *transactions);
+
+// Write words[i] to addresses[i], for i < n, in list order
+int ndpWriteList(ndp_list_transfer_f transfer, void *d,
+                 const uint32_t *addresses, const uint32_t *words,
+                 unsigned int n, unsigned int *transactions);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
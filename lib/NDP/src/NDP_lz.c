@@ -0,0 +1,295 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "NDP_lz.h"
+#include "NDP_plan.h"
+
+// LZ4 block format limits
+#define MIN_MATCH 4U
+#define LAST_LITERALS 5U
+#define MATCH_LIMIT 12U
+
+#define HASH_BITS 10U
+
+static unsigned int readLength(const uint8_t **ip, const uint8_t *iend,
+                               unsigned int len, int *ok)
+{
+    uint8_t b;
+
+    if (len != 15U) {
+        return len;
+    }
+    do {
+        if (*ip == iend) {
+            *ok = 0;
+            return 0;
+        }
+        b = *(*ip)++;
+        len += b;
+    } while (b == 255U);
+    return len;
+}
+
+int ndpLzDecodeBlock(const uint8_t *src, unsigned int srcLen, uint8_t *dst,
+                     unsigned int dstSize)
+{
+    const uint8_t *ip = src;
+    const uint8_t *iend = src + srcLen;
+    const uint8_t *match;
+    uint8_t *op = dst;
+    uint8_t *oend = dst + dstSize;
+    unsigned int token, len, offset;
+    int ok = 1;
+
+    while (ip < iend) {
+        token = *ip++;
+        len = readLength(&ip, iend, token >> 4, &ok);
+        if (!ok || (unsigned int)(iend - ip) < len
+            || (unsigned int)(oend - op) < len) {
+            return -1;
+        }
+        memcpy(op, ip, len);
+        op += len;
+        ip += len;
+        if (ip == iend) {
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return -1;
+        }
+        offset = ip[0] | (unsigned int)ip[1] << 8;
+        ip += 2;
+        len = readLength(&ip, iend, token & 15U, &ok) + MIN_MATCH;
+        if (!ok || !offset || (unsigned int)(op - dst) < offset
+            || (unsigned int)(oend - op) < len) {
+            return -1;
+        }
+        // matches may overlap what they write
+        match = op - offset;
+        while (len--) {
+            *op++ = *match++;
+        }
+    }
+    return (int)(op - dst);
+}
+
+static uint32_t read32(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static unsigned int hash(uint32_t v)
+{
+    return (v * 2654435761U) >> (32U - HASH_BITS);
+}
+
+static uint8_t *writeLength(uint8_t *op, unsigned int len)
+{
+    for (len -= 15U; 255U <= len; len -= 255U) {
+        *op++ = 255U;
+    }
+    *op++ = (uint8_t)len;
+    return op;
+}
+
+// One sequence: literals, then a match unless it is the last. Returns NULL
+// if it might not fit before oend.
+static uint8_t *sequence(uint8_t *op, const uint8_t *oend,
+                         const uint8_t *lit, unsigned int litLen,
+                         unsigned int offset, unsigned int matchLen)
+{
+    uint8_t *token = op;
+
+    // worst case: the token, both lengths extended, the literals and the
+    // offset
+    if ((unsigned int)(oend - op)
+        < 5U + litLen / 255U + matchLen / 255U + litLen) {
+        return NULL;
+    }
+    op++;
+    *token = (uint8_t)((litLen < 15U ? litLen : 15U) << 4);
+    if (15U <= litLen) {
+        op = writeLength(op, litLen);
+    }
+    memcpy(op, lit, litLen);
+    op += litLen;
+    if (!matchLen) {
+        return op;
+    }
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    matchLen -= MIN_MATCH;
+    *token |= (uint8_t)(matchLen < 15U ? matchLen : 15U);
+    if (15U <= matchLen) {
+        op = writeLength(op, matchLen);
+    }
+    return op;
+}
+
+// Greedy, one candidate per hash slot, which is enough for blocks this
+// small
+unsigned int ndpLzEncodeBlock(const uint8_t *src, unsigned int srcLen,
+                              uint8_t *dst)
+{
+    uint16_t table[1U << HASH_BITS];
+    const uint8_t *ip = src;
+    const uint8_t *anchor = src;
+    const uint8_t *limit = src + (srcLen < MATCH_LIMIT ? 0 : srcLen - MATCH_LIMIT);
+    const uint8_t *iend = src + srcLen;
+    const uint8_t *ref;
+    uint8_t *op = dst;
+    const uint8_t *oend = dst + srcLen;
+    unsigned int h, len;
+
+    if (NDP_LZ_BLOCK_MAX < srcLen) {
+        return 0;
+    }
+    memset(table, 0xff, sizeof(table));
+    while (ip < limit) {
+        h = hash(read32(ip));
+        ref = table[h] == 0xffffU ? NULL : src + table[h];
+        table[h] = (uint16_t)(ip - src);
+        if (!ref || read32(ref) != read32(ip)) {
+            ip++;
+            continue;
+        }
+        // the last LAST_LITERALS bytes stay literals
+        len = MIN_MATCH;
+        while (ip + len < iend - LAST_LITERALS && ref[len] == ip[len]) {
+            len++;
+        }
+        op = sequence(op, oend, anchor, (unsigned int)(ip - anchor),
+                      (unsigned int)(ip - ref), len);
+        if (!op) {
+            return 0;
+        }
+        ip += len;
+        anchor = ip;
+    }
+    op = sequence(op, oend, anchor, (unsigned int)(iend - anchor), 0, 0);
+    return op && op < oend ? (unsigned int)(op - dst) : 0;
+}
+
+uint32_t ndpLzMaxBytes(uint32_t logBytes, uint32_t blockSize)
+{
+    uint32_t blocks = blockSize ? (logBytes + blockSize - 1) / blockSize : 0;
+
+    return (uint32_t)sizeof(struct ndp_lz_header_s) + 2U * blocks + logBytes;
+}
+
+uint32_t ndpLzPack(const void *log, uint32_t logBytes, uint32_t blockSize,
+                   void *package)
+{
+    const uint8_t *in = (const uint8_t *)log;
+    uint8_t *out = (uint8_t *)package;
+    struct ndp_lz_header_s h;
+    uint32_t off, n, len;
+
+    if (!blockSize || blockSize % 4U || NDP_LZ_BLOCK_MAX < blockSize) {
+        return 0;
+    }
+    h.magic = NDP_LZ_MAGIC;
+    h.logBytes = logBytes;
+    h.blockSize = blockSize;
+    if (logBytes < NDP_PLAN_LOG_TAIL
+        || !ndpPlanLogChecksum(in + logBytes - NDP_PLAN_LOG_TAIL,
+                               &h.logChecksum)) {
+        return 0;
+    }
+    memcpy(out, &h, sizeof(h));
+    out += sizeof(h);
+
+    for (off = 0; off < logBytes; off += n) {
+        n = logBytes - off < blockSize ? logBytes - off : blockSize;
+        len = ndpLzEncodeBlock(in + off, n, out + 2);
+        if (!len) {
+            memcpy(out + 2, in + off, n);
+            len = n | NDP_LZ_STORED;
+        }
+        out[0] = (uint8_t)len;
+        out[1] = (uint8_t)(len >> 8);
+        out += 2 + (len & ~NDP_LZ_STORED);
+    }
+    return (uint32_t)(out - (uint8_t *)package);
+}
+
+int ndpLzOpen(struct ndp_lz_reader_s *r, const void *header)
+{
+    memcpy(&r->header, header, sizeof(r->header));
+    r->left = r->header.logBytes;
+    r->error = 0;
+    return r->header.magic == NDP_LZ_MAGIC && r->header.blockSize
+        && r->header.blockSize % 4U == 0
+        && r->header.blockSize <= NDP_LZ_BLOCK_MAX
+        && r->header.blockSize <= r->stageSize;
+}
+
+unsigned int ndpLzRead(struct ndp_lz_reader_s *r, void *buf,
+                       unsigned int count)
+{
+    uint32_t want = r->left < r->header.blockSize ? r->left
+        : r->header.blockSize;
+    uint8_t len[2];
+    unsigned int n;
+    int decoded;
+
+    if (!r->left || r->error) {
+        return 0;
+    }
+    r->error = 1;
+    if (count < want
+        || r->read(r->ctx, len, sizeof(len)) != sizeof(len)) {
+        return 0;
+    }
+    n = (len[0] | (unsigned int)len[1] << 8) & ~NDP_LZ_STORED;
+    if (len[1] & (NDP_LZ_STORED >> 8)) {
+        if (n != want || r->read(r->ctx, buf, n) != n) {
+            return 0;
+        }
+    } else {
+        if (r->stageSize < n || r->read(r->ctx, r->stage, n) != n) {
+            return 0;
+        }
+        decoded = ndpLzDecodeBlock(r->stage, n, (uint8_t *)buf, want);
+        if (decoded != (int)want) {
+            return 0;
+        }
+    }
+    r->error = 0;
+    r->left -= want;
+    return want;
+}
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NDP_LZ_H
+#define NDP_LZ_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Compressed model packages. The log is cut into blocks of blockSize
+// bytes, each compressed on its own in the LZ4 block format, so decoding
+// needs no history beyond the block being written: one staging buffer for
+// the compressed block and the caller's buffer for the decoded one.
+//
+// layout, little endian:
+//   header       struct ndp_lz_header_s
+//   blocks       uint16_t length, then length bytes; with NDP_LZ_STORED
+//                set the block is stored as is, (length & ~NDP_LZ_STORED)
+//                bytes of it
+//
+// Loaders tell a compressed package from a log by its first word: a log
+// starts with its header tag, 1.
+#define NDP_LZ_MAGIC 0x315a4c4eU // "NLZ1"
+#define NDP_LZ_BLOCK_MAX 1024U
+#define NDP_LZ_STORED 0x8000U
+
+struct ndp_lz_header_s {
+    uint32_t magic;
+    uint32_t logBytes;    // size of the log
+    uint32_t logChecksum; // value of the log's checksum tag
+    uint32_t blockSize;   // decoded bytes of every block but the last
+};
+
+// Decode one LZ4 block of srcLen bytes into at most dstSize bytes.
+// Returns the decoded size, or -1 if the block is malformed or too big.
+int ndpLzDecodeBlock(const uint8_t *src, unsigned int srcLen, uint8_t *dst,
+                     unsigned int dstSize);
+
+// Compress one block of at most NDP_LZ_BLOCK_MAX bytes into dst, which has
+// room for srcLen bytes. Returns the compressed size, or 0 if it does not
+// get smaller and the block should be stored. Used by the host tools.
+unsigned int ndpLzEncodeBlock(const uint8_t *src, unsigned int srcLen,
+                              uint8_t *dst);
+
+// Upper bound of the package size for a log of logBytes
+uint32_t ndpLzMaxBytes(uint32_t logBytes, uint32_t blockSize);
+
+// Compress a log into a package of blockSize blocks, a multiple of 4 of at
+// most NDP_LZ_BLOCK_MAX. Returns the package size, or 0 if blockSize is
+// not usable or the log has no checksum tag. Used by the host tools.
+uint32_t ndpLzPack(const void *log, uint32_t logBytes, uint32_t blockSize,
+                   void *package);
+
+// Sequential decoder over a package
+struct ndp_lz_reader_s {
+    // sequential read of the package, returns the number of bytes read
+    void *ctx;
+    unsigned int (*read)(void *ctx, void *buf, unsigned int count);
+
+    // compressed block staging, at least blockSize bytes
+    uint8_t *stage;
+    unsigned int stageSize;
+
+    struct ndp_lz_header_s header;
+    uint32_t left;  // log bytes still to decode
+    int error;
+};
+
+// Check a package header, as read from its first bytes. Returns 0 if it is
+// not a package the reader can decode into stageSize blocks.
+int ndpLzOpen(struct ndp_lz_reader_s *r, const void *header);
+
+// Decode the next block into buf, which takes count >= blockSize bytes.
+// Returns the bytes decoded, 0 at the end or on an error, which sets error.
+unsigned int ndpLzRead(struct ndp_lz_reader_s *r, void *buf,
+                       unsigned int count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,304 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "NDP_crc.h"
+#include "NDP_plan.h"
+
+#define TAG_HEADER 1U
+#define TAG_CHECKSUM 4U
+#define TAG_MCU_READ 75U
+#define LOG_MAGIC 0x53bde5a1U
+
+// records read per batch while replaying
+#define REPLAY_BATCH 8U
+
+// Direct writes to the sample FIFO do not advance the address
+#define SPI_SAMPLE 0x20U
+
+uint32_t ndpPlanMaxBytes(uint32_t logBytes)
+{
+    // every tag is at least 8 bytes and yields at most one record
+    return (uint32_t)sizeof(struct ndp_plan_header_s)
+        + logBytes / 8 * (uint32_t)sizeof(struct ndp_plan_record_s)
+        + logBytes;
+}
+
+static uint32_t word(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+int ndpPlanLogChecksum(const void *tail, uint32_t *checksum)
+{
+    const uint8_t *p = (const uint8_t *)tail;
+
+    if (word(p) != TAG_CHECKSUM || word(p + 4) != 4) {
+        return 0;
+    }
+    *checksum = word(p + 8);
+    return 1;
+}
+
+// One pass over the log. With records NULL only counts; otherwise fills
+// in the records and the payload.
+static int parseLog(const uint8_t *log, uint32_t logBytes,
+                    struct ndp_plan_record_s *records, uint8_t *payload,
+                    uint32_t *nrecords, uint32_t *payloadBytes,
+                    uint32_t *checksum)
+{
+    struct ndp_plan_record_s *last = NULL;
+    struct ndp_plan_record_s rec, prev;
+    uint32_t off = 0;
+    uint32_t tag, len, n;
+
+    *nrecords = 0;
+    *payloadBytes = 0;
+    while (off + 8 <= logBytes) {
+        tag = word(log + off);
+        len = word(log + off + 4);
+        off += 8;
+        if (logBytes - off < len) {
+            return 0;
+        }
+
+        switch (tag) {
+        case TAG_HEADER:
+            if (len != 4 || word(log + off) != LOG_MAGIC) {
+                return 0;
+            }
+            off += 4;
+            continue;
+        case TAG_MCU_READ:
+            if (len != 4) {
+                return 0;
+            }
+            off += 4;
+            continue;
+        case TAG_CHECKSUM:
+            if (len != 4) {
+                return 0;
+            }
+            *checksum = word(log + off);
+            return 1;
+        case NDP_PLAN_OP_EXT_CLK:
+        case NDP_PLAN_OP_INT_CLK:
+        case NDP_PLAN_OP_MB_NOP:
+            if (len) {
+                return 0;
+            }
+            rec.op = tag;
+            rec.address = 0;
+            rec.count = 0;
+            rec.offset = *payloadBytes;
+            break;
+        case NDP_PLAN_OP_SPI_WRITE:
+        case NDP_PLAN_OP_MCU_WRITE:
+            if (len < 4 || (tag == NDP_PLAN_OP_MCU_WRITE && len % 4)) {
+                return 0;
+            }
+            rec.op = tag;
+            rec.address = word(log + off);
+            rec.count = len - 4;
+            rec.offset = *payloadBytes;
+            off += 4;
+            n = (rec.count + 3) & ~3U;
+            if (logBytes - off < n) {
+                return 0;
+            }
+            if (payload) {
+                memcpy(payload + rec.offset, log + off, rec.count);
+                memset(payload + rec.offset + rec.count, 0, n - rec.count);
+            }
+            *payloadBytes += n;
+            off += n;
+            break;
+        default:
+            return 0;
+        }
+
+        // MCU payloads are word sized, so a merged record's payload stays
+        // contiguous
+        if (last && last->op == NDP_PLAN_OP_MCU_WRITE
+            && rec.op == NDP_PLAN_OP_MCU_WRITE
+            && last->address + last->count == rec.address) {
+            last->count += rec.count;
+            continue;
+        }
+        if (records) {
+            records[*nrecords] = rec;
+            last = &records[*nrecords];
+        } else {
+            prev = rec;
+            last = &prev;
+        }
+        (*nrecords)++;
+    }
+    // no checksum tag
+    return 0;
+}
+
+uint32_t ndpPlanBuild(const void *log, uint32_t logBytes, void *plan)
+{
+    struct ndp_plan_header_s h;
+    struct ndp_plan_record_s *records;
+    uint8_t *p = (uint8_t *)plan;
+    uint8_t *payload;
+    uint32_t table, i;
+
+    memset(&h, 0, sizeof(h));
+    if (logBytes % 4
+        || !parseLog((const uint8_t *)log, logBytes, NULL, NULL, &h.records,
+                     &h.payloadBytes, &h.logChecksum)) {
+        return 0;
+    }
+    table = h.records * (uint32_t)sizeof(*records);
+    records = (struct ndp_plan_record_s *)(p + sizeof(h));
+    payload = p + sizeof(h) + table;
+    parseLog((const uint8_t *)log, logBytes, records, payload,
+             &h.records, &h.payloadBytes, &h.logChecksum);
+
+    h.magic = NDP_PLAN_MAGIC;
+    h.version = NDP_PLAN_VERSION;
+    h.logBytes = logBytes;
+    for (i = 0; i < h.records; i++) {
+        h.payloadCrc = ndpCrc32(h.payloadCrc, payload + records[i].offset,
+                                records[i].count);
+    }
+    h.crc = ndpCrc32(ndpCrc32(0, &h, sizeof(h)), records, table);
+    memcpy(p, &h, sizeof(h));
+
+    return (uint32_t)sizeof(h) + table + h.payloadBytes;
+}
+
+static int readAll(const struct ndp_plan_io_s *io, uint32_t offset, void *buf,
+                   unsigned int count)
+{
+    return io->read(io->ctx, offset, buf, count) == count;
+}
+
+// Header and record table are checked before anything is sent
+static int checkPlan(const struct ndp_plan_io_s *io,
+                     struct ndp_plan_header_s *h, uint32_t logBytes,
+                     uint32_t logChecksum)
+{
+    struct ndp_plan_record_s batch[REPLAY_BATCH];
+    uint32_t crc, want, i, n;
+
+    if (!readAll(io, 0, h, sizeof(*h)) || h->magic != NDP_PLAN_MAGIC
+        || h->version != NDP_PLAN_VERSION || h->logBytes != logBytes
+        || h->logChecksum != logChecksum) {
+        return 0;
+    }
+    want = h->crc;
+    h->crc = 0;
+    crc = ndpCrc32(0, h, sizeof(*h));
+    h->crc = want;
+    for (i = 0; i < h->records; i += n) {
+        n = h->records - i < REPLAY_BATCH ? h->records - i : REPLAY_BATCH;
+        if (!readAll(io, sizeof(*h) + i * sizeof(batch[0]), batch,
+                     n * sizeof(batch[0]))) {
+            return 0;
+        }
+        crc = ndpCrc32(crc, batch, n * sizeof(batch[0]));
+    }
+    return crc == want;
+}
+
+static int replayWrite(const struct ndp_plan_io_s *io, uint32_t payload,
+                       const struct ndp_plan_record_s *rec, uint32_t *crc)
+{
+    int mcu = rec->op == NDP_PLAN_OP_MCU_WRITE;
+    uint32_t address = rec->address;
+    uint32_t offset = payload + rec->offset;
+    uint32_t count = rec->count;
+    uint32_t piece, edge;
+
+    while (count) {
+        piece = count < io->bufSize ? count : io->bufSize;
+        if (mcu) {
+            edge = NDP_PLAN_MAX_TRANSFER - address % NDP_PLAN_MAX_TRANSFER;
+            piece = piece < edge ? piece : edge;
+        }
+        if (!readAll(io, offset, io->buf, piece)) {
+            return 0;
+        }
+        *crc = ndpCrc32(*crc, io->buf, piece);
+        if (io->transfer(io->d, mcu, address, io->buf, NULL, piece)) {
+            return 0;
+        }
+        if (mcu || address != SPI_SAMPLE) {
+            address += piece;
+        }
+        offset += piece;
+        count -= piece;
+    }
+    return 1;
+}
+
+int ndpPlanReplay(const struct ndp_plan_io_s *io, uint32_t logBytes,
+                  uint32_t logChecksum)
+{
+    struct ndp_plan_header_s h;
+    struct ndp_plan_record_s batch[REPLAY_BATCH];
+    uint32_t payload, crc, i, j, n;
+    int ok;
+
+    if (!checkPlan(io, &h, logBytes, logChecksum)) {
+        return NDP_PLAN_STALE;
+    }
+    payload = (uint32_t)sizeof(h) + h.records * (uint32_t)sizeof(batch[0]);
+    crc = 0;
+
+    for (i = 0; i < h.records; i += n) {
+        n = h.records - i < REPLAY_BATCH ? h.records - i : REPLAY_BATCH;
+        if (!readAll(io, sizeof(h) + i * sizeof(batch[0]), batch,
+                     n * sizeof(batch[0]))) {
+            return NDP_PLAN_FAIL;
+        }
+        for (j = 0; j < n; j++) {
+            if (batch[j].op == NDP_PLAN_OP_SPI_WRITE
+                || batch[j].op == NDP_PLAN_OP_MCU_WRITE) {
+                ok = replayWrite(io, payload, &batch[j], &crc);
+            } else {
+                ok = !io->step(io->d, batch[j].op);
+            }
+            if (!ok) {
+                return NDP_PLAN_FAIL;
+            }
+        }
+    }
+    return crc == h.payloadCrc ? NDP_PLAN_OK : NDP_PLAN_CORRUPT;
+}
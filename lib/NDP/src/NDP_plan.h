@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NDP_PLAN_H
+#define NDP_PLAN_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A transfer plan is a uILib load log compiled into a flat list of
+// transfers, so boot can replay it without decoding tags and with the
+// largest bursts the NDP accepts. Build it once from a log that loads, and
+// store it next to the model with the extension NDP_PLAN_EXTENSION.
+//
+// layout, little endian:
+//   header       struct ndp_plan_header_s
+//   records      struct ndp_plan_record_s[records]
+//   payload      payloadBytes, each write padded to 4 bytes
+//
+// A record's op is the log tag it came from. Writes to consecutive MCU
+// addresses are merged into one record. Clock and mailbox steps carry no
+// payload and are replayed through the uILib.
+#define NDP_PLAN_MAGIC 0x504c504eU // "NPLP"
+#define NDP_PLAN_VERSION 2
+#define NDP_PLAN_EXTENSION ".pln"
+
+// Log tags a plan records
+#define NDP_PLAN_OP_EXT_CLK 28U
+#define NDP_PLAN_OP_INT_CLK 29U
+#define NDP_PLAN_OP_SPI_WRITE 30U
+#define NDP_PLAN_OP_MCU_WRITE 31U
+#define NDP_PLAN_OP_MB_NOP 74U
+
+// Longest MCU transfer, transfers do not cross a multiple of it
+#define NDP_PLAN_MAX_TRANSFER 2048U
+
+enum ndp_plan_status_e {
+    NDP_PLAN_OK = 0,
+    NDP_PLAN_STALE = 1, // no usable plan for this log, nothing was sent
+    NDP_PLAN_FAIL = 2,  // a transfer or step failed part way
+    NDP_PLAN_CORRUPT = 3 // sent, but the payload failed its CRC check
+};
+
+struct ndp_plan_header_s {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t records;
+    uint32_t payloadBytes;
+    uint32_t logBytes;    // size of the source log
+    uint32_t logChecksum; // value of the source log's checksum tag
+    uint32_t payloadCrc;  // CRC-32 of the payload in replay order
+    uint32_t crc;         // CRC-32 of the header, crc 0, and the records
+};
+
+struct ndp_plan_record_s {
+    uint32_t op;
+    uint32_t address;
+    uint32_t count;  // payload bytes
+    uint32_t offset; // into the payload
+};
+
+struct ndp_plan_io_s {
+    // positional read of the plan, returns the number of bytes read
+    void *ctx;
+    unsigned int (*read)(void *ctx, uint32_t offset, void *buf,
+                         unsigned int count);
+
+    // NDP access, as the ilib transfer function
+    void *d;
+    int (*transfer)(void *d, int mcu, uint32_t address, void *out, void *in,
+                    unsigned int count);
+
+    // run a clock or mailbox step, returns 0 on success
+    int (*step)(void *d, uint32_t op);
+
+    // payload staging, a multiple of 4 bytes
+    uint8_t *buf;
+    unsigned int bufSize;
+};
+
+// Upper bound of the plan size for a log of logBytes
+uint32_t ndpPlanMaxBytes(uint32_t logBytes);
+
+// Compile a complete, word aligned log. Returns the plan size, or 0 if
+// the log is malformed.
+uint32_t ndpPlanBuild(const void *log, uint32_t logBytes, void *plan);
+
+// Bytes at the end of a log holding its checksum tag
+#define NDP_PLAN_LOG_TAIL 12U
+
+// Get the checksum from the last NDP_PLAN_LOG_TAIL bytes of a log.
+// Returns 0 if they are not a checksum tag.
+int ndpPlanLogChecksum(const void *tail, uint32_t *checksum);
+
+// Replay the plan if it was built from a log of logBytes ending in
+// logChecksum. Returns an ndp_plan_status_e.
+int ndpPlanReplay(const struct ndp_plan_io_s *io, uint32_t logBytes,
+                  uint32_t logChecksum);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
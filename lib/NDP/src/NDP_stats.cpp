@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "NDP_stats.h"
+
+#if NDP_SPI_STATS
+
+#include <Arduino.h>
+
+volatile uint8_t ndpSpiSite = NDP_SPI_SITE_OTHER;
+
+static struct ndp_spi_stats_s spiStats;
+
+void ndpSpiStatsRecord(uint8_t site, int mcu, bool read, unsigned int count,
+                       uint32_t start)
+{
+    uint32_t elapsed = micros() - start;
+    uint8_t kind = NDP_SPI_KIND(mcu, read);
+    struct ndp_spi_counter_s *c;
+    uint32_t primask;
+
+    if (NDP_SPI_SITES <= site) {
+        site = NDP_SPI_SITE_OTHER;
+    }
+    c = &spiStats.counter[site][kind];
+
+    primask = __get_PRIMASK();
+    __disable_irq();
+    c->calls++;
+    c->bytes += count;
+    c->micros += elapsed;
+#if NDP_SPI_TRACE
+    struct ndp_spi_trace_s *t = &spiStats.trace[spiStats.traced % NDP_SPI_TRACE];
+    t->start = start;
+    t->count = count < 0xffff ? count : 0xffff;
+    t->micros = elapsed < 0xffff ? elapsed : 0xffff;
+    t->site = site;
+    t->kind = kind;
+#endif
+    spiStats.traced++;
+    __set_PRIMASK(primask);
+}
+
+void ndpSpiStatsGet(struct ndp_spi_stats_s *stats)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    memcpy(stats, &spiStats, sizeof(*stats));
+    __set_PRIMASK(primask);
+}
+
+void ndpSpiStatsClear(void)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    memset(&spiStats, 0, sizeof(spiStats));
+    __set_PRIMASK(primask);
+}
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NDP_STATS_H
+#define NDP_STATS_H
+
+#include <stdint.h>
+
+// Build with -DNDP_SPI_STATS=1 to count every NDP SPI transfer. When 0
+// (the default) no counting code is compiled in.
+#ifndef NDP_SPI_STATS
+#define NDP_SPI_STATS 0
+#endif
+
+// Entries in the trace ring of the most recent transfers, 0 for counters
+// only
+#ifndef NDP_SPI_TRACE
+#define NDP_SPI_TRACE 64
+#endif
+
+// Call sites transfers are attributed to
+enum ndp_spi_site_e {
+    NDP_SPI_SITE_OTHER = 0,
+    NDP_SPI_SITE_POLL = 1,   // match polling
+    NDP_SPI_SITE_TANK = 2,   // holding tank reads
+    NDP_SPI_SITE_LOAD = 3,   // uilib log loading
+    NDP_SPI_SITE_FLASH = 4,  // NDP master SPI flash access
+    NDP_SPI_SITE_BRIDGE = 5, // host management commands
+    NDP_SPI_SITES = 6
+};
+
+// Address class and direction of a transfer
+enum ndp_spi_kind_e {
+    NDP_SPI_DIRECT_READ = 0,
+    NDP_SPI_DIRECT_WRITE = 1,
+    NDP_SPI_MCU_READ = 2,
+    NDP_SPI_MCU_WRITE = 3,
+    NDP_SPI_KINDS = 4
+};
+
+#define NDP_SPI_KIND(mcu, read) (((mcu) ? 2 : 0) + ((read) ? 0 : 1))
+
+struct ndp_spi_counter_s {
+    uint32_t calls;
+    uint32_t bytes;
+    uint32_t micros;
+};
+
+struct ndp_spi_trace_s {
+    uint32_t start;  // micros() when the transfer started
+    uint16_t count;  // payload bytes
+    uint16_t micros; // duration, saturated
+    uint8_t site;
+    uint8_t kind;
+};
+
+struct ndp_spi_stats_s {
+    struct ndp_spi_counter_s counter[NDP_SPI_SITES][NDP_SPI_KINDS];
+#if NDP_SPI_TRACE
+    struct ndp_spi_trace_s trace[NDP_SPI_TRACE];
+#endif
+    uint32_t traced; // transfers recorded in the ring since the last clear
+};
+
+#if NDP_SPI_STATS
+
+// site the next transfers are attributed to
+extern volatile uint8_t ndpSpiSite;
+
+// Attributes the transfers of the enclosing scope to a site, restoring the
+// outer site on exit so nested and interrupting scopes work
+class NDPSpiSiteScope
+{
+ public:
+    NDPSpiSiteScope(uint8_t site) : prev(ndpSpiSite) { ndpSpiSite = site; }
+    ~NDPSpiSiteScope() { ndpSpiSite = prev; }
+
+ private:
+    uint8_t prev;
+};
+
+#define NDP_SPI_SITE(site) NDPSpiSiteScope ndpSpiSiteScope_(site)
+
+// Record one finished transfer, safe from interrupts
+void ndpSpiStatsRecord(uint8_t site, int mcu, bool read, unsigned int count,
+                       uint32_t start);
+
+// Take a consistent copy of the counters and trace ring
+void ndpSpiStatsGet(struct ndp_spi_stats_s *stats);
+
+void ndpSpiStatsClear(void);
+
+#else
+
+#define NDP_SPI_SITE(site) do {} while (0)
+
+#endif
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <string.h>
+#include "NDP_list.h"
+#include "NDP_tank.h"
+
+static int readWord(struct ndp_tank_s *t, uint32_t address, uint32_t *v)
+{
+    t->transfers++;
+    return (t->transfer)(t->d, 1, address, 0, v, sizeof(*v));
+}
+
+int ndpTankOpen(struct ndp_tank_s *t)
+{
+    // the tank registers are a word apart, one transaction reads both
+    static const uint32_t config[2] = {NDP_TANK_TANK, NDP_TANK_TANKADDR};
+    uint32_t words[2];
+    unsigned int transactions = 0;
+    uint32_t v;
+    int s;
+
+    t->head = 0;
+    s = ndpReadList(t->transfer, t->d, config, words, 2, &transactions);
+    t->transfers += transactions;
+    if (s) {
+        t->tankSize = 0;
+        return s;
+    }
+    t->tankSize = ((words[0] >> 4) & 0x3ffff) & ~3U;
+    t->tankAddress = words[1];
+    s = readWord(t, NDP_TANK_FW_STATE, &t->tankPtrAddress);
+    s = s ? s : readWord(t, t->tankPtrAddress, &v);
+    if (s) {
+        t->tankSize = 0;
+        return s;
+    }
+    t->readPtr = t->tankSize ? (v & ~3U) % t->tankSize : 0;
+    return 0;
+}
+
+int ndpTankPoll(struct ndp_tank_s *t, uint32_t max)
+{
+    uint32_t mask = t->ringSize - 1;
+    uint32_t p, n, chunk, at;
+    int s;
+
+    if (!t->tankSize) {
+        return 0;
+    }
+    s = readWord(t, t->tankPtrAddress, &p);
+    if (s) {
+        return s;
+    }
+    // the DSP writes words, the pointer can be between two of them
+    p = (p & ~3U) % t->tankSize;
+    n = (p + t->tankSize - t->readPtr) % t->tankSize;
+
+    if (max > t->ringSize) {
+        max = t->ringSize;
+    }
+    max &= ~3U;
+    if (n > max) {
+        t->skipped += n - max;
+        t->readPtr = (t->readPtr + n - max) % t->tankSize;
+        n = max;
+    }
+
+    // one burst per piece: split where the tank or the ring wraps
+    while (n) {
+        at = t->head & mask;
+        chunk = n;
+        if (chunk > t->tankSize - t->readPtr) {
+            chunk = t->tankSize - t->readPtr;
+        }
+        if (chunk > t->ringSize - at) {
+            chunk = t->ringSize - at;
+        }
+        t->transfers++;
+        s = (t->transfer)(t->d, 1, t->tankAddress + t->readPtr, 0,
+                          t->ring + at, chunk);
+        if (s) {
+            return s;
+        }
+        t->head += chunk;
+        t->readPtr = (t->readPtr + chunk) % t->tankSize;
+        n -= chunk;
+    }
+    return 0;
+}
+
+void ndpTankReaderStart(const struct ndp_tank_s *t, struct ndp_tank_reader_s *r)
+{
+    r->tail = t->head;
+    r->dropped = 0;
+    r->underruns = 0;
+    r->primed = 0;
+}
+
+uint32_t ndpTankAvailable(const struct ndp_tank_s *t,
+                          struct ndp_tank_reader_s *r)
+{
+    uint32_t lag = t->head - r->tail;
+
+    if (lag > t->ringSize) {
+        r->dropped += lag - t->ringSize;
+        r->tail += lag - t->ringSize;
+        lag = t->ringSize;
+    }
+    return lag;
+}
+
+uint32_t ndpTankRead(const struct ndp_tank_s *t, struct ndp_tank_reader_s *r,
+                     void *buf, uint32_t count)
+{
+    uint32_t mask = t->ringSize - 1;
+    uint32_t n = ndpTankAvailable(t, r);
+    uint32_t at, first;
+
+    if (count > n) {
+        count = n;
+    }
+    at = r->tail & mask;
+    first = t->ringSize - at < count ? t->ringSize - at : count;
+    memcpy(buf, t->ring + at, first);
+    memcpy((uint8_t *)buf + first, t->ring, count - first);
+    r->tail += count;
+    // a poll in between may have reused the start of what was copied
+    ndpTankAvailable(t, r);
+    return count;
+}
+
+uint32_t ndpTankReadPaced(const struct ndp_tank_s *t,
+                          struct ndp_tank_reader_s *r, void *buf,
+                          uint32_t count, uint32_t prefill)
+{
+    uint32_t n = ndpTankAvailable(t, r);
+
+    if (!r->primed) {
+        if (n < prefill || n < count) {
+            return 0;
+        }
+        r->primed = 1;
+    } else if (n < count) {
+        r->underruns++;
+        r->primed = 0;
+        return 0;
+    }
+    return ndpTankRead(t, r, buf, count);
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NDP_TANK_H
+#define NDP_TANK_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Holding tank streamer. The DSP writes its samples into a ring in NDP
+// memory, the holding tank, and the firmware keeps its write offset, the
+// tank pointer, at the start of its state. A poll reads the tank pointer
+// and fetches everything written since the last poll in one burst, or two
+// where the tank wraps, into a ring on the SAMD side.
+//
+// The SAMD ring has one producer, ndpTankPoll, and any number of readers
+// with their own positions, so USB audio and a recording can both consume
+// it. The producer never waits: a reader more than the ring behind loses
+// the oldest bytes and counts them. A reader in another context than the
+// poll must stay more than one poll of bytes behind the ring's end.
+#define NDP_TANK_TANK 0x4000c0a8U     // DSP_CONFIG_TANK, size in bits 4-21
+#define NDP_TANK_TANKADDR 0x4000c0b0U // DSP_CONFIG_TANKADDR
+#define NDP_TANK_FW_STATE 0x1fffc0c0U // address of the firmware state
+
+struct ndp_tank_s {
+    // NDP access, as the ilib transfer function
+    void *d;
+    int (*transfer)(void *d, int mcu, uint32_t address, void *out, void *in,
+                    unsigned int count);
+
+    // SAMD side ring, a power of 2 bytes, word aligned
+    uint8_t *ring;
+    uint32_t ringSize;
+
+    // set up by ndpTankOpen
+    uint32_t tankAddress;
+    uint32_t tankSize;
+    uint32_t tankPtrAddress;
+    uint32_t readPtr; // tank offset of the next byte to fetch
+
+    volatile uint32_t head; // bytes put in the ring, free running
+
+    unsigned long transfers; // NDP transfers issued
+    unsigned long skipped;   // tank bytes too old to fetch when polled
+};
+
+struct ndp_tank_reader_s {
+    uint32_t tail;         // bytes consumed, free running
+    unsigned long dropped; // bytes the ring overwrote before they were read
+    unsigned long underruns;
+    int primed;            // ndpTankReadPaced has its prefill
+};
+
+// Read the tank layout and start at the current tank pointer, so the
+// first poll fetches only what is written after it. Returns 0 or the
+// status of the failing transfer.
+int ndpTankOpen(struct ndp_tank_s *t);
+
+// Fetch the bytes written since the last poll. At most the newest max
+// bytes are fetched, and never more than the ring; older unread ones are
+// skipped. Returns 0 or the status of the failing transfer.
+int ndpTankPoll(struct ndp_tank_s *t, uint32_t max);
+
+// Start a reader at the newest byte of the ring
+void ndpTankReaderStart(const struct ndp_tank_s *t, struct ndp_tank_reader_s *r);
+
+uint32_t ndpTankAvailable(const struct ndp_tank_s *t,
+                          struct ndp_tank_reader_s *r);
+
+// Copy up to count bytes. Returns the bytes copied.
+uint32_t ndpTankRead(const struct ndp_tank_s *t, struct ndp_tank_reader_s *r,
+                     void *buf, uint32_t count);
+
+// For a fixed rate consumer such as USB audio: copy exactly count bytes,
+// or nothing until prefill bytes are buffered. An underrun waits for the
+// prefill again. Returns the bytes copied.
+uint32_t ndpTankReadPaced(const struct ndp_tank_s *t,
+                          struct ndp_tank_reader_s *r, void *buf,
+                          uint32_t count, uint32_t prefill);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
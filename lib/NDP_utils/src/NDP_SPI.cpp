@@ -48,25 +48,107 @@ unsigned long indirectRead(unsigned long indirectRegister)
     return indirectData;
 }
 
+unsigned int indirectReadBurst(unsigned long indirectRegister, uint32_t *words,
+                               unsigned int n)
+{
+    unsigned int chunk;
+    unsigned int transactions = 0;
+
+    while (n) {
+        chunk = min(n, INDIRECT_BURST_MAX_BYTES / 4);
+        NDP.spiTransfer(NULL, 1, indirectRegister, NULL, words, chunk * 4);
+        indirectRegister += chunk * 4;
+        words += chunk;
+        n -= chunk;
+        transactions++;
+    }
+    return transactions;
+}
+
+unsigned int indirectWriteBurst(unsigned long indirectRegister,
+                                const uint32_t *words, unsigned int n)
+{
+    unsigned int chunk;
+    unsigned int transactions = 0;
+
+    while (n) {
+        chunk = min(n, INDIRECT_BURST_MAX_BYTES / 4);
+        NDP.spiTransfer(NULL, 1, indirectRegister, (void *)words, NULL,
+                        chunk * 4);
+        indirectRegister += chunk * 4;
+        words += chunk;
+        n -= chunk;
+        transactions++;
+    }
+    return transactions;
+}
+
+unsigned int indirectReadList(const uint32_t *addresses, uint32_t *words,
+                              unsigned int n)
+{
+    unsigned int transactions = 0;
+
+    ndpReadList(NDP.spiTransfer, NULL, addresses, words, n, &transactions);
+    return transactions;
+}
+
+unsigned int indirectWriteList(const uint32_t *addresses,
+                               const uint32_t *words, unsigned int n)
+{
+    unsigned int transactions = 0;
+
+    ndpWriteList(NDP.spiTransfer, NULL, addresses, words, n, &transactions);
+    return transactions;
+}
+
+// Host copy of CHIP_CONFIG_SPICTL. Every write still goes through to the
+// chip, only the read half of the read-modify-write sequences is saved.
+// spiWait refreshes it since the chip sets the done bit.
+static unsigned long spictlShadow;
+static bool spictlShadowValid = false;
+
+static unsigned long readSpictl()
+{
+    if (!spictlShadowValid) {
+        spictlShadow = indirectRead(CHIP_CONFIG_SPICTL);
+        spictlShadowValid = true;
+    }
+    return spictlShadow;
+}
+
+static void writeSpictl(unsigned long value)
+{
+    indirectWrite(CHIP_CONFIG_SPICTL, value);
+    spictlShadow = value;
+    spictlShadowValid = true;
+}
+
+// Forget the SPICTL copy. Call after anything else may have changed the
+// register: an NDP reset, a uilib log, or a bridge register write.
+void invalidateMasterSpiShadow()
+{
+    spictlShadowValid = false;
+}
+
 // Enables NDP Master SPI interface. Caution - this disables NDP LED outputs
 void enableMasterSpi()
 {
-    indirectWrite(CHIP_CONFIG_SPICTL,
-                  (((indirectRead(CHIP_CONFIG_SPICTL) | 0x100) & 0xfffffffc)));
+    writeSpictl((readSpictl() | 0x100) & 0xfffffffc);
 }
 
 // Disables NDP Master SPI interface. Needed to use NDP LED outputs
 void disableMasterSpi()
 {
-    indirectWrite(CHIP_CONFIG_SPICTL,
-                  (indirectRead(CHIP_CONFIG_SPICTL) & 0xfffffeff));
+    writeSpictl(readSpictl() & 0xfffffeff);
 }
 
 // Waits for SPI master command to be written
 void spiWait()
 {
-    while ((indirectRead(CHIP_CONFIG_SPICTL) & FLASH_SPI_DONE) == 0)
-        ;
+    do {
+        spictlShadow = indirectRead(CHIP_CONFIG_SPICTL);
+    } while ((spictlShadow & FLASH_SPI_DONE) == 0);
+    spictlShadowValid = true;
 }
 
 // reverse byte ordering of a 32 bit word
@@ -84,16 +166,20 @@ unsigned long reverseBytes(unsigned long value)
 // MSPI_UPDATE = accepts data into output buffer
 void changeMasterSpiMode(byte mode)
 {
-    indirectWrite(CHIP_CONFIG_SPICTL,
-                  (((indirectRead(CHIP_CONFIG_SPICTL) & 0xfffffffc) | mode)));
+    writeSpictl((readSpictl() & 0xfffffffc) | mode);
+}
+
+// Set mode and number of bytes (numBytes + 1 are clocked) in one write
+void setMasterSpiControl(byte mode, unsigned long numBytes)
+{
+    writeSpictl((readSpictl() & 0xfffffff0) | (numBytes << 2) | mode);
 }
 
 // Tells NDP how many bytes to write on Master SPI interface
 void writeNumBytes(unsigned long numBytes)
 {
     //write spictl=mode=1,ss=0,numbytes=numBytes,enable=1
-    indirectWrite(CHIP_CONFIG_SPICTL,
-                  (((indirectRead(CHIP_CONFIG_SPICTL) & 0xfffffff3) | (numBytes << 2))));
+    writeSpictl((readSpictl() & 0xfffffff3) | (numBytes << 2));
     changeMasterSpiMode(MSPI_TRANSFER);
 }
 
@@ -105,8 +191,7 @@ uint32_t getFlashStatus()
     changeMasterSpiMode(MSPI_ENABLE);
     indirectWrite(CHIP_CONFIG_SPITX, FLASH_READ_STATUS_REGISTER);
     // write spictl=mode=1,ss=0,numbytes=3,enable=1
-    indirectWrite(CHIP_CONFIG_SPICTL,
-                  ((indirectRead(CHIP_CONFIG_SPICTL) | 0xc)));
+    setMasterSpiControl(MSPI_ENABLE, 0x3);
     changeMasterSpiMode(MSPI_TRANSFER);
     spiWait();
     changeMasterSpiMode(MSPI_UPDATE);
@@ -121,8 +206,7 @@ void writeFlashCommand(uint32_t command)
     changeMasterSpiMode(MSPI_IDLE);
     changeMasterSpiMode(MSPI_ENABLE);
     indirectWrite(CHIP_CONFIG_SPITX, command);
-    indirectWrite(CHIP_CONFIG_SPICTL,
-                  (((indirectRead(CHIP_CONFIG_SPICTL) & 0xfffffff0) | 0x1)));
+    setMasterSpiControl(MSPI_ENABLE, 0x0);
     changeMasterSpiMode(MSPI_TRANSFER);
     spiWait();
     changeMasterSpiMode(MSPI_IDLE);
@@ -134,33 +218,49 @@ void sectorEraseCommand(uint32_t address)
     changeMasterSpiMode(MSPI_IDLE);
     changeMasterSpiMode(MSPI_ENABLE);
     indirectWrite(CHIP_CONFIG_SPITX, FLASH_SECTOR_ERASE + address);
-    indirectWrite(CHIP_CONFIG_SPICTL,
-                  ((indirectRead(CHIP_CONFIG_SPICTL) & 0xfffffff0) | 0xd));
+    setMasterSpiControl(MSPI_ENABLE, 0x3);
     changeMasterSpiMode(MSPI_TRANSFER);
     spiWait();
     changeMasterSpiMode(MSPI_IDLE);
 }
 
-// writes "count" bytes from the ilib_buff buffer to the
-// flash device at address "address"
-void flashWrite(unsigned long address, uint32_t count)
+// Set while a program or erase may still be running in the flash. The
+// flash is only polled when it is, as the NDP may have been reset since
+// and its master SPI disabled.
+static bool flashBusy = false;
+
+void flashWaitReady()
 {
-    uint16_t i;
-    uint32_t writeWord;
+    if (!flashBusy)
+        return;
 
+    NDP_SPI_SITE(NDP_SPI_SITE_FLASH);
     enableMasterSpi();
-
-    // if 4K boundary, erase block
-    if ((address & 0xfff) == 0)
-    {
-        while ((getFlashStatus() & FLASH_STATUS_WIP) == FLASH_STATUS_WIP)
-            ;
-        writeFlashCommand(FLASH_WRITE_ENABLE);
-        sectorEraseCommand(address);
-    }
-
     while ((getFlashStatus() & FLASH_STATUS_WIP) == FLASH_STATUS_WIP)
         ;
+    flashBusy = false;
+}
+
+void flashEraseStart(uint32_t address)
+{
+    flashWaitReady();
+
+    NDP_SPI_SITE(NDP_SPI_SITE_FLASH);
+    enableMasterSpi();
+    writeFlashCommand(FLASH_WRITE_ENABLE);
+    sectorEraseCommand(address);
+    flashBusy = true;
+}
+
+void flashProgramStart(unsigned long address, const uint8_t *data, uint32_t count)
+{
+    uint16_t i;
+    uint32_t writeWord;
+
+    flashWaitReady();
+
+    NDP_SPI_SITE(NDP_SPI_SITE_FLASH);
+    enableMasterSpi();
     writeFlashCommand(FLASH_WRITE_ENABLE);
     changeMasterSpiMode(MSPI_IDLE);
     changeMasterSpiMode(MSPI_ENABLE);
@@ -171,12 +271,23 @@ void flashWrite(unsigned long address, uint32_t count)
 
     for (i = 0; i < count; i += 4)
     {
-        writeWord = (ilibBuf[i + 3] | (ilibBuf[i + 2] << 8) | (ilibBuf[i + 1] << 16) | (ilibBuf[i + 0] << 24));
+        writeWord = (data[i + 3] | (data[i + 2] << 8) | (data[i + 1] << 16) | (data[i + 0] << 24));
         indirectWrite(CHIP_CONFIG_SPITX, writeWord);
         changeMasterSpiMode(MSPI_ENABLE);
         changeMasterSpiMode(MSPI_TRANSFER);
     }
+    flashBusy = true;
+}
 
-    while ((getFlashStatus() & FLASH_STATUS_WIP) == FLASH_STATUS_WIP)
-        ;
+// writes "count" bytes from the ilib_buff buffer to the
+// flash device at address "address"
+void flashWrite(unsigned long address, uint32_t count)
+{
+    // if 4K boundary, erase block
+    if ((address & 0xfff) == 0)
+    {
+        flashEraseStart(address);
+    }
+    flashProgramStart(address, ilibBuf, count);
+    flashWaitReady();
 }
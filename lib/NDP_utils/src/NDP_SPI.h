@@ -79,17 +79,44 @@ const unsigned long FLASH_RESET = 0x99;        // RST
 const unsigned long FLASH_ENABLE_WRITE_STATUS = 0x50;
 const unsigned long FLASH_DP = 0xB9;        // Flash Deep Power Down
 
+// Longest single MADDR transaction issued by the burst functions
+const unsigned int INDIRECT_BURST_MAX_BYTES = 2048;
+
 void indirectWrite(unsigned long indirectRegister, unsigned long indirectData);
 unsigned long indirectRead(unsigned long indirectRegister);
+
+// Read/write n consecutive 32 bit words starting at indirectRegister.
+// Returns the number of SPI transactions used.
+unsigned int indirectReadBurst(unsigned long indirectRegister, uint32_t *words,
+                               unsigned int n);
+unsigned int indirectWriteBurst(unsigned long indirectRegister,
+                                const uint32_t *words, unsigned int n);
+
+// Read/write words[i] at addresses[i], for i < n. Runs of ascending
+// addresses in the list are merged into single transactions, see
+// NDP_list.h. Returns the number of SPI transactions used.
+unsigned int indirectReadList(const uint32_t *addresses, uint32_t *words,
+                              unsigned int n);
+unsigned int indirectWriteList(const uint32_t *addresses,
+                               const uint32_t *words, unsigned int n);
+void invalidateMasterSpiShadow();
 void enableMasterSpi();
 void disableMasterSpi();
 void spiWait();
 unsigned long reverseBytes(unsigned long value);
 void changeMasterSpiMode(byte mode);
+void setMasterSpiControl(byte mode, unsigned long numBytes);
 void writeNumBytes(unsigned long numBytes);
 uint32_t getFlashStatus();
 void writeFlashCommand(uint32_t command);
 void sectorEraseCommand(uint32_t address);
+
+// The start functions leave the flash busy with the erase or page program,
+// so the caller can get on with something else. Every flash access waits
+// for it first, flashWaitReady does so explicitly.
+void flashWaitReady();
+void flashEraseStart(uint32_t address);
+void flashProgramStart(unsigned long address, const uint8_t *data, uint32_t count);
 void flashWrite(unsigned long address, uint32_t count);
 
 #endif
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "NDP_calibrate.h"
+#include "NDP_SPI.h"
+#include "NDP_loadModel.h" // For SD
+#include "NDP_plan.h"      // For NDP_PLAN_OP_INT_CLK
+
+// Direct register written and read back to check the bus without the NDP MCU
+const uint32_t SPI_CAL_MADDR = 0x40;
+
+struct spi_speed_config_s {
+    uint32_t magic;
+    uint32_t general;
+    uint32_t sampleWrite;
+    uint32_t check;
+};
+
+// Calibration runs before anything else uses spiData, so the pattern and
+// the read back words live there
+static uint32_t *const calPattern = (uint32_t *)spiData;
+static uint32_t *const calReadBack = calPattern + SPI_CAL_WORDS;
+
+static void setSpiBusSpeed(uint32_t speed)
+{
+    spiSpeedGeneral = speed;
+    SPI.beginTransaction(SPISettings(spiSpeedGeneral, MSBFIRST, SPI_MODE0));
+}
+
+static uint32_t xorshift32(uint32_t x)
+{
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return x;
+}
+
+// One round of patterns at the current bus speed. Short direct transfers
+// are clocked by the CPU, the MCU bursts go through DMA, so both paths are
+// covered.
+static bool runPatterns(unsigned int pass)
+{
+    uint32_t walk = 1UL << (pass & 31);
+    const uint32_t direct[] = {0x00000000, 0xffffffff, 0x55aa55aa,
+                               0xaa55aa55, walk, ~walk};
+    uint32_t seed = 0x9e3779b9 * (pass + 1);
+    uint32_t r;
+    unsigned int i;
+
+    for (i = 0; i < sizeof(direct) / sizeof(direct[0]); i++) {
+        r = ~direct[i];
+        NDP.spiTransfer(NULL, 0, SPI_CAL_MADDR, (void *)&direct[i], NULL, 4);
+        NDP.spiTransfer(NULL, 0, SPI_CAL_MADDR, NULL, &r, 4);
+        if (r != direct[i]) {
+            return false;
+        }
+    }
+
+    for (i = 0; i < SPI_CAL_WORDS; i++) {
+        seed = xorshift32(seed);
+        calPattern[i] = (pass & 1) ? ~seed : seed;
+        calReadBack[i] = ~calPattern[i];
+    }
+    indirectWriteBurst(SPI_CAL_SCRATCH, calPattern, SPI_CAL_WORDS);
+    indirectReadBurst(SPI_CAL_SCRATCH, calReadBack, SPI_CAL_WORDS);
+    return !memcmp(calPattern, calReadBack, SPI_CAL_WORDS * 4);
+}
+
+static bool testSpeed(uint32_t speed, unsigned int passes)
+{
+    unsigned int pass;
+
+    setSpiBusSpeed(speed);
+    for (pass = 0; pass < passes; pass++) {
+        if (!runPatterns(pass)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Bring up the NDP internal clock on the freshly reset chip, fed to the
+// uilib as a one tag log like the plan replay steps. Nothing else of the
+// model is loaded, so no core reads or writes the scratch words.
+static bool startCalClock()
+{
+    uint32_t tlv[2] = {NDP_PLAN_OP_INT_CLK, 0};
+    int s;
+
+    NDP.init();
+    s = NDP.loadLog((uint8_t *)tlv, sizeof(tlv));
+    return s == SYNTIANT_NDP_ERROR_NONE || s == SYNTIANT_NDP_ERROR_MORE;
+}
+
+// The model log loaded next starts from its header on a fresh uilib
+static void endCal(uint32_t speed)
+{
+    setSpiBusSpeed(speed);
+    NDP.init();
+    invalidateMasterSpiShadow();
+}
+
+bool verifySpiSpeed(uint32_t speed, unsigned int passes)
+{
+    uint32_t current = spiSpeedGeneral;
+    bool ok;
+
+    ok = startCalClock() && testSpeed(speed, passes);
+    endCal(current);
+    return ok;
+}
+
+uint32_t calibrateSpiSpeed()
+{
+    uint32_t current = spiSpeedGeneral;
+    unsigned int step = 0;
+    unsigned int selected;
+
+    if (startCalClock()) {
+        for (; step < SPI_SPEED_NUM_STEPS; step++) {
+            if (!testSpeed(SPI_SPEED_STEPS[step], SPI_CAL_PASSES)) {
+                break;
+            }
+        }
+    }
+
+    if (step == 0) {
+        endCal(current);
+        return 0;
+    }
+
+    // Every step passed: the SERCOM limit was reached, not the NDP's.
+    // Otherwise back off one step from the fastest pass for margin.
+    if (step == SPI_SPEED_NUM_STEPS || step == 1) {
+        selected = step - 1;
+    } else {
+        selected = step - 2;
+    }
+
+    endCal(SPI_SPEED_STEPS[selected]);
+    if (spiSpeedSampleWrite > spiSpeedGeneral) {
+        spiSpeedSampleWrite = spiSpeedGeneral;
+    }
+    return spiSpeedGeneral;
+}
+
+static uint32_t configCheck(const struct spi_speed_config_s *cfg)
+{
+    return ~(cfg->magic ^ cfg->general ^ cfg->sampleWrite);
+}
+
+bool loadSpiSpeedConfig(uint32_t *general, uint32_t *sampleWrite)
+{
+    struct spi_speed_config_s cfg;
+    File f;
+    int n;
+
+    f = SD.open(SPI_SPEED_CONFIG_FILE, FILE_READ);
+    if (!f) {
+        return false;
+    }
+    n = f.read(&cfg, sizeof(cfg));
+    f.close();
+
+    if (n != sizeof(cfg) || cfg.magic != SPI_SPEED_CONFIG_MAGIC
+        || cfg.check != configCheck(&cfg) || !cfg.general
+        || cfg.general > SPI_SPEED_STEPS[SPI_SPEED_NUM_STEPS - 1]
+        || !cfg.sampleWrite) {
+        return false;
+    }
+    *general = cfg.general;
+    *sampleWrite = cfg.sampleWrite;
+    return true;
+}
+
+bool saveSpiSpeedConfig(uint32_t general, uint32_t sampleWrite)
+{
+    struct spi_speed_config_s cfg;
+    File f;
+    bool ok;
+
+    cfg.magic = SPI_SPEED_CONFIG_MAGIC;
+    cfg.general = general;
+    cfg.sampleWrite = sampleWrite;
+    cfg.check = configCheck(&cfg);
+
+    if (SD.exists(SPI_SPEED_CONFIG_FILE) && !SD.remove(SPI_SPEED_CONFIG_FILE)) {
+        return false;
+    }
+    f = SD.open(SPI_SPEED_CONFIG_FILE, FILE_WRITE);
+    if (!f) {
+        return false;
+    }
+    ok = f.write((const uint8_t *)&cfg, sizeof(cfg)) == sizeof(cfg);
+    f.close();
+    return ok;
+}
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ * 
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ * 
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NDP_CALIBRATE_H
+#define NDP_CALIBRATE_H
+
+#include "NDP.h"
+
+// SPI clocks tried by calibrateSpiSpeed, slowest first. All divide the
+// SAMD21's 48 MHz SERCOM clock exactly; 12 MHz is the SERCOM maximum.
+const uint32_t SPI_SPEED_STEPS[] = {1000000, 2000000, 3000000, 4000000,
+                                    6000000, 8000000, 12000000};
+const unsigned int SPI_SPEED_NUM_STEPS =
+    sizeof(SPI_SPEED_STEPS) / sizeof(SPI_SPEED_STEPS[0]);
+
+// Pattern rounds a clock must pass before it is accepted
+const unsigned int SPI_CAL_PASSES = 8;
+
+// NDP MCU memory used for write/read-back patterns. This is the start of
+// the NDP MCU RAM, which the model log fills with the firmware afterwards.
+const unsigned long SPI_CAL_SCRATCH = 0x20000000;
+const unsigned int SPI_CAL_WORDS = 64;
+
+// Calibration result kept on the SD card
+#define SPI_SPEED_CONFIG_FILE "ndp_spi.cfg"
+const uint32_t SPI_SPEED_CONFIG_MAGIC = 0x4e535043; // "NSPC"
+
+// Run the write/read-back patterns passes times at speed. Leaves the SPI
+// bus at spiSpeedGeneral. Same conditions as calibrateSpiSpeed.
+bool verifySpiSpeed(uint32_t speed, unsigned int passes);
+
+// Step the clock up through SPI_SPEED_STEPS until a step fails and select
+// the step below the fastest one that passed, or the last step if none
+// failed. Sets spiSpeedGeneral, caps spiSpeedSampleWrite to it and returns
+// it. Returns 0 and leaves the speeds unchanged if even the slowest step
+// fails. Must be called on a freshly reset NDP, before the model log is
+// loaded: only the internal clock is started for it, and the uilib is
+// started over afterwards.
+uint32_t calibrateSpiSpeed();
+
+// Read/write the calibrated speeds from/to SPI_SPEED_CONFIG_FILE. The SD
+// card must already be initialized.
+bool loadSpiSpeedConfig(uint32_t *general, uint32_t *sampleWrite);
+bool saveSpiSpeedConfig(uint32_t general, uint32_t sampleWrite);
+
+#endif
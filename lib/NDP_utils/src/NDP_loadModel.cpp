@@ -15,6 +15,10 @@
 */
 
 #include "NDP_loadModel.h"
+#include "NDP_crc.h"
+#include "NDP_flash.h"
+#include "NDP_lz.h"
+#include "NDP_plan.h"
 
 SdFat SD;
 
@@ -30,24 +34,413 @@ uint8_t sectorBuffer[512];
 byte runningFromFlash = 0; // indicates successful boot from flash
 byte patchApplied = 0;     // Patch applied (from slot 1) to uilib load (slot 0)
 
-int loadModel(String model)
+typedef unsigned int (*planRead_f)(void *file, uint32_t offset, void *buf,
+                                   unsigned int count);
+
+static unsigned int planReadSd(void *file, uint32_t offset, void *buf,
+                               unsigned int count)
+{
+    File *f = (File *)file;
+    int n;
+
+    if (!f->seek(offset))
+        return 0;
+    n = f->read(buf, count);
+    return n < 0 ? 0 : n;
+}
+
+static unsigned int planReadFlash(void *file, uint32_t offset, void *buf,
+                                  unsigned int count)
+{
+    SerialFlashFile *f = (SerialFlashFile *)file;
+
+    f->seek(offset);
+    return f->read(buf, count);
+}
+
+// clock and mailbox steps are fed to the uilib as a one tag log
+static int planStep(void *d, uint32_t op)
+{
+    uint32_t tlv[2] = {op, 0};
+    int s;
+
+    s = NDP.loadLog((uint8_t *)tlv, sizeof(tlv));
+    return s == SYNTIANT_NDP_ERROR_MORE ? SYNTIANT_NDP_ERROR_NONE : s;
+}
+
+// "ei_model.bin" -> "ei_model.pln"
+static String sideName(String model, const char *extension)
+{
+    int dot = model.lastIndexOf('.');
+
+    return (dot < 0 ? model : model.substring(0, dot)) + extension;
+}
+
+static bool readDigest(planRead_f read, void *file,
+                       struct ndp_digest_s *digest)
+{
+    return read(file, 0, digest, sizeof(*digest)) == sizeof(*digest)
+        && digest->magic == NDP_DIGEST_MAGIC;
+}
+
+void removeModelSideFiles(String model, bool fromSd)
+{
+    String planName = sideName(model, NDP_PLAN_EXTENSION);
+    String digestName = sideName(model, NDP_DIGEST_EXTENSION);
+
+    if (fromSd)
+    {
+        SD.remove(planName.c_str());
+        SD.remove(digestName.c_str());
+        SD.remove(MODEL_SLOT_TABLE);
+    }
+    else
+    {
+        SerialFlash.remove(planName.c_str());
+        SerialFlash.remove(digestName.c_str());
+        SerialFlash.remove(MODEL_SLOT_TABLE);
+    }
+}
+
+// The Serial Flash can't rename files, so a model streamed to it is staged
+// as "model.new" and copied over the model once it has loaded. The stage
+// is removed last, so a switch cut short can be finished at boot.
+static bool copyFlashStage(String model, String stage)
+{
+    SerialFlashFile from = SerialFlash.open(stage.c_str());
+    SerialFlashFile to;
+    uint32_t left, n;
+    bool ok;
+
+    if (!from)
+    {
+        return false;
+    }
+    left = from.size();
+    removeModelSideFiles(model, false);
+    SerialFlash.remove(model.c_str());
+    ok = SerialFlash.create(model.c_str(), left);
+    if (ok)
+    {
+        to = SerialFlash.open(model.c_str());
+        ok = to;
+    }
+    while (ok && left)
+    {
+        n = left < sizeof(spiData) ? left : sizeof(spiData);
+        ok = from.read(spiData, n) == n && to.write(spiData, n) == n;
+        left -= n;
+    }
+    from.close();
+    if (to)
+    {
+        to.close();
+    }
+    return ok;
+}
+
+// A stage is only left behind by a switch cut short or a stream cut short.
+// Only the first leaves the model missing or part copied, and the stage
+// complete, so the switch is finished when the model doesn't load.
+static bool finishFlashStage(String model)
+{
+    String stage = sideName(model, ".new");
+
+    if (!SerialFlash.exists(stage.c_str()) || !copyFlashStage(model, stage))
+    {
+        return false;
+    }
+    Serial2.print("Finished switching to staged ");
+    Serial2.println(model);
+    SerialFlash.remove(stage.c_str());
+    return true;
+}
+
+// Start over on a chip a load left part way
+static void restartLoad(void)
+{
+    NDP.init();
+    invalidateMasterSpiShadow();
+}
+
+// Get the size of the log in a model file, compressed or not, and the
+// checksum tag closing it
+static bool logIdentity(planRead_f read, void *file, uint32_t fileBytes,
+                        uint32_t *logBytes, uint32_t *checksum)
+{
+    struct ndp_lz_header_s h;
+    uint8_t tail[NDP_PLAN_LOG_TAIL];
+
+    if (read(file, 0, &h, sizeof(h)) == sizeof(h) && h.magic == NDP_LZ_MAGIC)
+    {
+        *logBytes = h.logBytes;
+        *checksum = h.logChecksum;
+        return true;
+    }
+    *logBytes = fileBytes;
+    return sizeof(tail) <= fileBytes
+        && read(file, fileBytes - sizeof(tail), tail, sizeof(tail)) == sizeof(tail)
+        && ndpPlanLogChecksum(tail, checksum);
+}
+
+// Replay the transfer plan of the log, if the plan was built from it.
+// Returns an ndp_plan_status_e, NDP_PLAN_STALE when the log itself has to
+// be loaded.
+static int loadPlan(planRead_f read, void *log, uint32_t fileBytes,
+                    void *plan)
+{
+    struct ndp_plan_io_s io = {plan, read, NULL, NDPClass::spiTransfer,
+                               planStep, spiData, sizeof(spiData)};
+    uint32_t logBytes, checksum;
+
+    if (!logIdentity(read, log, fileBytes, &logBytes, &checksum))
+    {
+        return NDP_PLAN_STALE;
+    }
+
+    NDP_SPI_SITE(NDP_SPI_SITE_LOAD);
+    NDP.loadLog(NULL, 0);
+    return ndpPlanReplay(&io, logBytes, checksum);
+}
+
+static_assert(LOAD_MODEL_BLOCK_SIZE % 4 == 0
+              && 2 * LOAD_MODEL_BLOCK_SIZE <= sizeof(spiData),
+              "LOAD_MODEL_BLOCK_SIZE must be a multiple of 4 and fit twice in spiData");
+
+struct load_model_timing_s loadModelTiming;
+
+static unsigned int logReadSd(void *file, void *buf, unsigned int count)
+{
+    int n = ((File *)file)->read(buf, count);
+
+    return n < 0 ? 0 : n;
+}
+
+static unsigned int logReadFlash(void *file, void *buf, unsigned int count)
+{
+    return ((SerialFlashFile *)file)->read(buf, count);
+}
+
+static unsigned int logReadLz(void *file, void *buf, unsigned int count)
+{
+    return ndpLzRead((struct ndp_lz_reader_s *)file, buf, count);
+}
+
+// Set lz up to decode the model file, if it is a compressed package, with
+// ilibBuf staging the compressed blocks. Returns false for a log, which
+// then has to be read again from the start.
+static bool openPackage(struct ndp_lz_reader_s *lz, logRead_f read, void *file)
+{
+    uint8_t header[sizeof(lz->header)];
+
+    lz->ctx = file;
+    lz->read = read;
+    lz->stage = ilibBuf;
+    lz->stageSize = sizeof(ilibBuf);
+    return read(file, header, sizeof(header)) == sizeof(header)
+        && ndpLzOpen(lz, header);
+}
+
+// Feed the log to the uilib in blocks, ping-ponging between the two halves
+// of spiData. NDP writes are posted to DMA so reading the next block
+// overlaps sending the previous one; the SD card and the serial flash are
+// both on SPI1, apart from the NDP's SPI. With crc, the blocks are added to
+// it once they are handed to the uilib, so a posted write also overlaps the
+// CRC.
+static int loadLogPipelined(logRead_f read, void *file, uint32_t *crc)
+{
+    uint8_t *buf[2] = {spiData, spiData + LOAD_MODEL_BLOCK_SIZE};
+    unsigned int n;
+    uint32_t t;
+    int s = SYNTIANT_NDP_ERROR_MORE;
+    int s0;
+    int i = 0;
+
+    NDP.spiPostWrites(true);
+    while (s == SYNTIANT_NDP_ERROR_MORE)
+    {
+        // a block without transfers leaves the older one's write pending
+        if (NDP.spiWritePending(buf[i], LOAD_MODEL_BLOCK_SIZE))
+            NDP.spiTransferWait();
+
+        t = micros();
+        n = read(file, buf[i], LOAD_MODEL_BLOCK_SIZE);
+        loadModelTiming.read += micros() - t;
+        if (!n)
+            break;
+
+        t = micros();
+        s = NDP.loadLog(buf[i], n);
+        loadModelTiming.load += micros() - t;
+        loadModelTiming.bytes += n;
+
+        if (crc)
+        {
+            t = micros();
+            *crc = ndpCrc32(*crc, buf[i], n);
+            loadModelTiming.check += micros() - t;
+        }
+        i = !i;
+    }
+    t = micros();
+    s0 = NDP.spiPostWrites(false);
+    loadModelTiming.load += micros() - t;
+
+    return s0 ? s0 : s;
+}
+
+// Load a model package from the SD card, already begun
+static int loadSdFile(String model)
 {
     File myFile;
-    uint32_t numBytes;
-    uint8_t fileBuf[1024] __attribute__((aligned(4)));
     int s;
-    byte cardInserted;
-    byte FoundSerialFlash = 0;
 
-    delay(2000);
+    // open the file. Have to close this one before opening another.
+    myFile = SD.open(model, FILE_READ);
+    if (!myFile)
+    {
+        myFile.close();
+        return BIN_NOT_OPENED;
+    }
+
+    File planFile = SD.open(sideName(model, NDP_PLAN_EXTENSION), FILE_READ);
+    if (planFile)
+    {
+        s = loadPlan(planReadSd, &myFile, myFile.size(), &planFile);
+        planFile.close();
+        if (s == NDP_PLAN_OK)
+        {
+            myFile.close();
+            return BIN_LOAD_OK;
+        }
+        if (s == NDP_PLAN_FAIL)
+        {
+            myFile.close();
+            return ERROR_LOADING_SD;
+        }
+        if (s == NDP_PLAN_CORRUPT)
+        {
+            Serial2.println("Transfer plan failed its CRC check");
+            restartLoad();
+        }
+        myFile.seek(0);
+    }
+
+    struct ndp_digest_s digest;
+    bool check = false;
+    uint32_t crc = 0;
+
+    File digestFile = SD.open(sideName(model, NDP_DIGEST_EXTENSION), FILE_READ);
+    if (digestFile)
+    {
+        check = readDigest(planReadSd, &digestFile, &digest);
+        digestFile.close();
+    }
+
+    struct ndp_lz_reader_s lz;
+    uint32_t size = myFile.size();
+
+    // read from the SD card file until there's nothing else in it:
+    if (openPackage(&lz, logReadSd, &myFile))
+    {
+        size = lz.header.logBytes;
+        s = loadLogPipelined(logReadLz, &lz, check ? &crc : NULL);
+    }
+    else
+    {
+        myFile.seek(0);
+        s = loadLogPipelined(logReadSd, &myFile, check ? &crc : NULL);
+    }
+    myFile.close();
+    Serial2.println();
+    if (s != SYNTIANT_NDP_ERROR_NONE)
+    {
+        return ERROR_LOADING_SD;
+    }
+    if (check && (digest.logBytes != size || digest.crc != crc))
+    {
+        return ERROR_BIN_CRC;
+    }
+    return BIN_LOAD_OK;
+}
+
+// Load a model package from the Serial Flash, already begun
+static int loadFlashFile(String model)
+{
+    int s;
+
+    SerialFlashFile file = SerialFlash.open(model.c_str());
+    if (!file)
+    {
+        return BIN_NOT_OPENED;
+    }
+    unsigned long count = file.size();
+
+    SerialFlashFile planFile = SerialFlash.open(sideName(model, NDP_PLAN_EXTENSION).c_str());
+    if (planFile)
+    {
+        s = loadPlan(planReadFlash, &file, count, &planFile);
+        planFile.close();
+        if (s == NDP_PLAN_OK)
+        {
+            return LOADED_FROM_SERIAL_FLASH;
+        }
+        if (s == NDP_PLAN_FAIL)
+        {
+            return ERROR_LOADING_FLASH;
+        }
+        if (s == NDP_PLAN_CORRUPT)
+        {
+            Serial2.println("Transfer plan failed its CRC check");
+            restartLoad();
+        }
+        file.seek(0);
+    }
+
+    struct ndp_digest_s digest;
+    bool check = false;
+    uint32_t crc = 0;
+
+    SerialFlashFile digestFile =
+        SerialFlash.open(sideName(model, NDP_DIGEST_EXTENSION).c_str());
+    if (digestFile)
+    {
+        check = readDigest(planReadFlash, &digestFile, &digest);
+        digestFile.close();
+    }
+
+    struct ndp_lz_reader_s lz;
+
+    if (openPackage(&lz, logReadFlash, &file))
+    {
+        count = lz.header.logBytes;
+        s = loadLogPipelined(logReadLz, &lz, check ? &crc : NULL);
+    }
+    else
+    {
+        file.seek(0);
+        s = loadLogPipelined(logReadFlash, &file, check ? &crc : NULL);
+    }
+    if (s != SYNTIANT_NDP_ERROR_NONE)
+    {
+        return ERROR_LOADING_FLASH;
+    }
+    if (check && (digest.logBytes != count || digest.crc != crc))
+    {
+        return ERROR_BIN_CRC;
+    }
+    return LOADED_FROM_SERIAL_FLASH;
+}
+
+static int loadKnownGood(String model, bool fromSd);
+
+bool sdCardInserted(void)
+{
+    byte cardInserted;
 
     // Initialize SD insertion sense pin
     pinMode(SD_CARD_SENSE, INPUT_PULLUP);
 
-    // Can cause issue with sensor if PDM enabled. Will be enabled for audio in syntiant.cpp
-    //pinMode(ENABLE_PDM, OUTPUT);
-    //digitalWrite(ENABLE_PDM, LOW); // Enable PDM clock
-
     // Bluebank board uses SST25VF016B. SD_CARD_SENSE pin is HIGH with card inserted
     // Tesolve board uses MX25R6435FSN. SD_CARD_SENSE pin is LOW with card inserted
     cardInserted = digitalRead(SD_CARD_SENSE);
@@ -55,8 +448,22 @@ int loadModel(String model)
     {
         cardInserted = !cardInserted;
     }
+    return cardInserted;
+}
 
-    if (!cardInserted)
+static int loadModelFile(String model)
+{
+    int s;
+    byte FoundSerialFlash = 0;
+
+    // the log resets the chip
+    invalidateMasterSpiShadow();
+
+    // Can cause issue with sensor if PDM enabled. Will be enabled for audio in syntiant.cpp
+    //pinMode(ENABLE_PDM, OUTPUT);
+    //digitalWrite(ENABLE_PDM, LOW); // Enable PDM clock
+
+    if (!sdCardInserted())
     {
         // See if Serial Flash installed
         if (SerialFlash.begin(FLASH_CS))
@@ -80,32 +487,29 @@ int loadModel(String model)
             delayMicroseconds(1);
 
             byte found = flashCat(model); // read filenames in Serial Flash looking for bin file "model"
+            if (!found && finishFlashStage(model))
+            {
+                found = 1;
+            }
             if (found)
             {
-                SerialFlashFile file = SerialFlash.open(model.c_str());
-                unsigned long count = file.size();
-                unsigned long n = count;
-
-                while (file.available())
+                s = loadFlashFile(model);
+                if (s != LOADED_FROM_SERIAL_FLASH && s != ERROR_BIN_CRC
+                    && finishFlashStage(model))
                 {
-                    unsigned long rd = n;
-                    if (rd > sizeof(fileBuf))
-                        rd = sizeof(fileBuf);
-                    numBytes = file.read(fileBuf, rd);
-
-                    s = NDP.loadLog(fileBuf, numBytes);
-                    if (s != SYNTIANT_NDP_ERROR_NONE && s != SYNTIANT_NDP_ERROR_MORE)
-                    {
-                        return ERROR_LOADING_FLASH;
-                    }
-                    n = n - rd;
+                    restartLoad();
+                    s = loadFlashFile(model);
+                }
+                if (s == ERROR_BIN_CRC)
+                {
+                    return loadKnownGood(model, false);
+                }
+                if (s != BIN_NOT_OPENED)
+                {
+                    return s;
                 }
             }
             FoundSerialFlash = 1;
-            if (s == SYNTIANT_NDP_ERROR_NONE)
-            {
-                return LOADED_FROM_SERIAL_FLASH;
-            }
         }
         return NO_SD;
     }
@@ -115,31 +519,498 @@ int loadModel(String model)
         return SD_NOT_INITIALIZED;
     }
 
-    // open the file. Have to close this one before opening another.
-    myFile = SD.open(model, FILE_READ);
-    if (!myFile)
+    s = loadSdFile(model);
+    if (s == ERROR_BIN_CRC)
+    {
+        return loadKnownGood(model, true);
+    }
+    return s;
+}
+
+int loadModel(String model)
+{
+    uint32_t start = micros();
+    int s;
+
+    memset(&loadModelTiming, 0, sizeof(loadModelTiming));
+    s = loadModelFile(model);
+    loadModelTiming.total = micros() - start;
+    return s;
+}
+
+struct model_slot_s modelSlots[MODEL_SLOTS];
+int modelSlotCount = 0;
+int modelSlotActive = -1;
+static bool modelSlotsOnSd;
+
+// model packages are the .bin files, transfer plans sit next to them
+static bool isModelName(const char *name)
+{
+    size_t len = strlen(name);
+
+    return 4 < len && len < MODEL_SLOT_NAME
+        && !strcasecmp(name + len - 4, ".bin");
+}
+
+// the version of a slot is its log checksum, 0 if it has none
+static uint32_t logVersion(planRead_f read, void *file, uint32_t fileBytes)
+{
+    uint32_t logBytes, checksum;
+
+    return logIdentity(read, file, fileBytes, &logBytes, &checksum) ? checksum : 0;
+}
+
+static void addModelSlot(const char *name, uint32_t size, uint32_t version,
+                         bool digest)
+{
+    struct model_slot_s *slot = &modelSlots[modelSlotCount++];
+
+    strcpy(slot->name, name);
+    slot->size = size;
+    slot->version = version;
+    slot->digest = digest;
+}
+
+struct model_slot_table_s {
+    uint32_t magic;
+    uint32_t count;
+    uint32_t crc; // ndpCrc32 of the count slots following
+};
+
+// Check a model file of the directory listing against the next slot of the
+// table: a file rewritten to the same size still differs in its log checksum,
+// and a digest added or removed next to it changes the fallback candidates
+static bool slotListed(const char *name, uint32_t size, uint32_t version,
+                       bool digest, int *listed)
+{
+    struct model_slot_s *slot = &modelSlots[*listed];
+
+    if (modelSlotCount <= *listed || strcmp(slot->name, name) || slot->size != size
+        || slot->version != version || slot->digest != digest)
+    {
+        return false;
+    }
+    (*listed)++;
+    return true;
+}
+
+// Read the slot table into modelSlots and list the directory against it.
+// False when there is none or the models changed since it was saved.
+static bool loadSlotTable(bool fromSd)
+{
+    struct model_slot_table_s t;
+    char name[MODEL_SLOT_NAME + 1];
+    uint32_t size;
+    unsigned int bytes;
+    int listed = 0;
+    bool ok = true;
+
+    if (fromSd)
+    {
+        File f = SD.open(MODEL_SLOT_TABLE, FILE_READ);
+        if (!f)
+        {
+            return false;
+        }
+        ok = f.read(&t, sizeof(t)) == sizeof(t) && t.count <= MODEL_SLOTS;
+        bytes = ok ? t.count * sizeof(modelSlots[0]) : 0;
+        ok = ok && f.read(modelSlots, bytes) == (int)bytes;
+        f.close();
+    }
+    else
+    {
+        SerialFlashFile f = SerialFlash.open(MODEL_SLOT_TABLE);
+        if (!f)
+        {
+            return false;
+        }
+        ok = f.read(&t, sizeof(t)) == sizeof(t) && t.count <= MODEL_SLOTS;
+        bytes = ok ? t.count * sizeof(modelSlots[0]) : 0;
+        ok = ok && f.read(modelSlots, bytes) == bytes;
+        f.close();
+    }
+    if (!ok || t.magic != MODEL_SLOT_TABLE_MAGIC
+        || t.crc != ndpCrc32(0, modelSlots, bytes))
+    {
+        return false;
+    }
+    modelSlotCount = t.count;
+
+    if (fromSd)
+    {
+        File root = SD.open("/");
+        File f;
+
+        while (ok && listed < MODEL_SLOTS && (f = root.openNextFile()))
+        {
+            f.getName(name, sizeof(name));
+            if (!f.isDir() && isModelName(name))
+            {
+                ok = slotListed(name, f.size(),
+                                logVersion(planReadSd, &f, f.size()),
+                                SD.exists(sideName(name, NDP_DIGEST_EXTENSION).c_str()),
+                                &listed);
+            }
+            f.close();
+        }
+        root.close();
+    }
+    else
+    {
+        SerialFlash.opendir();
+        while (ok && listed < MODEL_SLOTS
+               && SerialFlash.readdir(name, sizeof(name), size))
+        {
+            if (isModelName(name))
+            {
+                SerialFlashFile f = SerialFlash.open(name);
+                ok = slotListed(name, size, logVersion(planReadFlash, &f, size),
+                                SerialFlash.exists(
+                                    sideName(name, NDP_DIGEST_EXTENSION).c_str()),
+                                &listed);
+                f.close();
+            }
+        }
+    }
+    if (!ok || listed != modelSlotCount)
+    {
+        modelSlotCount = 0;
+        return false;
+    }
+    return true;
+}
+
+static void saveSlotTable(bool fromSd)
+{
+    struct model_slot_table_s t;
+    unsigned int bytes = modelSlotCount * sizeof(modelSlots[0]);
+
+    t.magic = MODEL_SLOT_TABLE_MAGIC;
+    t.count = modelSlotCount;
+    t.crc = ndpCrc32(0, modelSlots, bytes);
+
+    if (fromSd)
+    {
+        SD.remove(MODEL_SLOT_TABLE);
+        File f = SD.open(MODEL_SLOT_TABLE, FILE_WRITE);
+        if (f)
+        {
+            f.write((const uint8_t *)&t, sizeof(t));
+            f.write((const uint8_t *)modelSlots, bytes);
+            f.close();
+        }
+        return;
+    }
+
+    SerialFlash.remove(MODEL_SLOT_TABLE);
+    if (!SerialFlash.create(MODEL_SLOT_TABLE, sizeof(t) + bytes))
+        return;
+    SerialFlashFile f = SerialFlash.open(MODEL_SLOT_TABLE);
+    if (f)
+    {
+        f.write(&t, sizeof(t));
+        f.write(modelSlots, bytes);
+        f.close();
+    }
+}
+
+int scanModelSlots(bool fromSd)
+{
+    char name[MODEL_SLOT_NAME + 1];
+    uint32_t size;
+
+    modelSlotCount = 0;
+    modelSlotActive = -1;
+    modelSlotsOnSd = fromSd;
+
+    if (loadSlotTable(fromSd))
+    {
+        return modelSlotCount;
+    }
+
+    if (fromSd)
+    {
+        File root = SD.open("/");
+        File f;
+
+        while (modelSlotCount < MODEL_SLOTS && (f = root.openNextFile()))
+        {
+            f.getName(name, sizeof(name));
+            if (!f.isDir() && isModelName(name))
+            {
+                addModelSlot(name, f.size(), logVersion(planReadSd, &f, f.size()),
+                             SD.exists(sideName(name, NDP_DIGEST_EXTENSION).c_str()));
+            }
+            f.close();
+        }
+        root.close();
+    }
+    else
+    {
+        SerialFlash.opendir();
+        while (modelSlotCount < MODEL_SLOTS
+               && SerialFlash.readdir(name, sizeof(name), size))
+        {
+            if (isModelName(name))
+            {
+                SerialFlashFile f = SerialFlash.open(name);
+                addModelSlot(name, size, logVersion(planReadFlash, &f, size),
+                             SerialFlash.exists(
+                                 sideName(name, NDP_DIGEST_EXTENSION).c_str()));
+                f.close();
+            }
+        }
+    }
+    saveSlotTable(fromSd);
+    return modelSlotCount;
+}
+
+int findModelSlot(const char *name)
+{
+    for (int i = 0; i < modelSlotCount; i++)
+    {
+        if (!strcasecmp(modelSlots[i].name, name))
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int loadModelSlot(int slot)
+{
+    uint32_t start = micros();
+    int s;
+
+    if (slot < 0 || modelSlotCount <= slot)
     {
-        myFile.close();
         return BIN_NOT_OPENED;
     }
 
-    // read from the SD card file until there's nothing else in it:
-    while (myFile.available())
+    memset(&loadModelTiming, 0, sizeof(loadModelTiming));
+    // the log resets the chip
+    invalidateMasterSpiShadow();
+    if (modelSlotsOnSd)
+    {
+        s = loadSdFile(modelSlots[slot].name);
+    }
+    else
+    {
+        s = loadFlashFile(modelSlots[slot].name);
+    }
+    loadModelTiming.total = micros() - start;
+
+    if (s == BIN_LOAD_OK || s == LOADED_FROM_SERIAL_FLASH)
+    {
+        modelSlotActive = slot;
+    }
+    return s;
+}
+
+// The model failed its CRC check. Boot the first other slot whose digest
+// checks out instead, the storage is already begun.
+static int loadKnownGood(String model, bool fromSd)
+{
+    int s;
+
+    scanModelSlots(fromSd);
+    for (int i = 0; i < modelSlotCount; i++)
     {
-        numBytes = myFile.read(fileBuf, sizeof(fileBuf));
-        s = NDP.loadLog(fileBuf, numBytes);
-        if (s != SYNTIANT_NDP_ERROR_NONE && s != SYNTIANT_NDP_ERROR_MORE)
+        if (!modelSlots[i].digest || !strcasecmp(modelSlots[i].name, model.c_str()))
         {
-            myFile.close();
-            return ERROR_LOADING_SD;
+            continue;
+        }
+        Serial2.print("Falling back to ");
+        Serial2.println(modelSlots[i].name);
+
+        restartLoad();
+        s = fromSd ? loadSdFile(modelSlots[i].name)
+                   : loadFlashFile(modelSlots[i].name);
+        if (s == BIN_LOAD_OK || s == LOADED_FROM_SERIAL_FLASH)
+        {
+            modelSlotActive = i;
+            return s;
         }
     }
-    Serial2.println();
-    if (s == SYNTIANT_NDP_ERROR_NONE)
+    return ERROR_BIN_CRC;
+}
+
+// A model streamed in from the host. left counts it down so no byte past
+// it is read, and every byte read is also written to the persist file.
+struct model_stream_s {
+    logRead_f read;
+    void *file;
+    uint32_t left;
+    File *sd;
+    SerialFlashFile *flash;
+    bool saved; // every byte so far reached the persist file
+
+    // the bytes read looking for a package header, handed out again
+    // first when it is a plain log
+    uint8_t head[sizeof(struct ndp_lz_header_s)];
+    unsigned int headBytes;
+    unsigned int replay;
+};
+
+static unsigned int logReadStream(void *file, void *buf, unsigned int count)
+{
+    struct model_stream_s *st = (struct model_stream_s *)file;
+    unsigned int n;
+
+    if (st->replay)
     {
-        myFile.close();
-        return BIN_LOAD_OK;
+        n = st->replay < count ? st->replay : count;
+        memcpy(buf, st->head + st->headBytes - st->replay, n);
+        st->replay -= n;
+        return n;
     }
+
+    n = st->left < count ? st->left : count;
+    n = n ? st->read(st->file, buf, n) : 0;
+    st->left -= n;
+    if (st->sd && st->sd->write(buf, n) != n)
+        st->saved = false;
+    if (st->flash && st->flash->write(buf, n) != n)
+        st->saved = false;
+    return n;
+}
+
+// Replace the model's digest, and drop its transfer plan, which the new
+// model would only have to reject at boot
+static bool saveDigest(String model, bool toSd, uint32_t logBytes, uint32_t crc)
+{
+    struct ndp_digest_s digest = {NDP_DIGEST_MAGIC, logBytes, crc};
+    String digestName = sideName(model, NDP_DIGEST_EXTENSION);
+    bool saved;
+
+    removeModelSideFiles(model, toSd);
+    if (toSd)
+    {
+        File f = SD.open(digestName, FILE_WRITE);
+        saved = f && f.write(&digest, sizeof(digest)) == sizeof(digest);
+        f.close();
+        return saved;
+    }
+
+    if (!SerialFlash.create(digestName.c_str(), sizeof(digest)))
+        return false;
+    SerialFlashFile f = SerialFlash.open(digestName.c_str());
+    saved = f && f.write(&digest, sizeof(digest)) == sizeof(digest);
+    f.close();
+    return saved;
+}
+
+int loadModelStream(String model, uint32_t fileBytes, bool persist,
+                    logRead_f read, void *file, uint32_t *crc)
+{
+    struct model_stream_s st;
+    struct ndp_lz_reader_s lz;
+    String stage = sideName(model, ".new");
+    File sdFile;
+    SerialFlashFile flashFile;
+    bool toSd = false;
+    bool loaded;
+    uint32_t logBytes = fileBytes;
+    uint32_t start = micros();
+    int s;
+
+    memset(&loadModelTiming, 0, sizeof(loadModelTiming));
+    memset(&st, 0, sizeof(st));
+    st.read = read;
+    st.file = file;
+    st.left = fileBytes;
+    *crc = 0;
+
+    if (persist)
+    {
+        if (SD.begin(SDCARD_SS_PIN))
+        {
+            // staged next to the model, which it replaces once it loads
+            toSd = true;
+            SD.remove(stage.c_str());
+            sdFile = SD.open(stage, FILE_WRITE);
+            if (sdFile)
+                st.sd = &sdFile;
+        }
+        else if (SerialFlash.begin(FLASH_CS))
+        {
+            // staged too, and copied over the model once it loads
+            SerialFlash.remove(stage.c_str());
+            if (SerialFlash.create(stage.c_str(), fileBytes))
+            {
+                flashFile = SerialFlash.open(stage.c_str());
+                if (flashFile)
+                    st.flash = &flashFile;
+            }
+        }
+        st.saved = st.sd || st.flash;
+    }
+
+    // the log resets the chip
+    invalidateMasterSpiShadow();
+
+    // the stream can't seek back, so the header is kept for a plain log
+    lz.ctx = &st;
+    lz.read = logReadStream;
+    lz.stage = ilibBuf;
+    lz.stageSize = sizeof(ilibBuf);
+    st.headBytes = logReadStream(&st, st.head, sizeof(st.head));
+    if (st.headBytes == sizeof(st.head) && ndpLzOpen(&lz, st.head))
+    {
+        logBytes = lz.header.logBytes;
+        s = loadLogPipelined(logReadLz, &lz, crc);
+    }
+    else
+    {
+        st.replay = st.headBytes;
+        s = loadLogPipelined(logReadStream, &st, crc);
+    }
+
+    // a failed load keeps nothing of the rest, but still has to take it
+    // off the link
+    if (s != SYNTIANT_NDP_ERROR_NONE)
+    {
+        st.sd = NULL;
+        st.flash = NULL;
+    }
+    while (st.left && logReadStream(&st, spiData, sizeof(spiData)))
+        ;
+    loaded = s == SYNTIANT_NDP_ERROR_NONE && !st.left;
+
+    if (sdFile)
+    {
+        sdFile.close();
+        if (loaded && st.saved)
+        {
+            SD.remove(model.c_str());
+            st.saved = SD.rename(stage.c_str(), model.c_str());
+        }
+        else
+        {
+            SD.remove(stage.c_str());
+        }
+    }
+    if (flashFile)
+    {
+        flashFile.close();
+        if (loaded && st.saved)
+            st.saved = copyFlashStage(model, stage);
+        else
+            SerialFlash.remove(stage.c_str());
+    }
+    if (loaded && st.saved)
+    {
+        st.saved = saveDigest(model, toSd, logBytes, *crc);
+        if (!toSd)
+            SerialFlash.remove(stage.c_str());
+        scanModelSlots(toSd);
+    }
+    modelSlotActive = loaded && st.saved ? findModelSlot(model.c_str()) : -1;
+    loadModelTiming.total = micros() - start;
+
+    if (!loaded)
+        return ERROR_LOADING_BIN;
+    return persist && !st.saved ? ERROR_SAVING_BIN : BIN_LOAD_OK;
 }
 
 // Clears the onboard SST25VF016B device, & copies the SD flash files to it
@@ -558,24 +1429,25 @@ byte flashCat(String foundFile)
 // The 4 byte checksum is at 0xffff4
 void loadUilibFlash(byte record)
 {
+    struct ndp_flash_s flash;
+    uint32_t index[2];
+    uint32_t flashOffset = record << 20;
+    unsigned int wordBytes, n;
+    unsigned long words;
+    uint32_t start = micros();
     int s;
 
-    // Enable SPI Master Mode for Flash access
-    enableMasterSpi();
-    uint32_t flashOffset = record << 20;
+    // an upload may have left the last page programming
+    flashWaitReady();
+    NDP_SPI_SITE(NDP_SPI_SITE_LOAD);
 
-    changeMasterSpiMode(MSPI_ENABLE);
-    indirectWrite(CHIP_CONFIG_SPITX, FLASH_READ + flashOffset + FLASH_INDEX_LOCATION);
-    writeNumBytes(0x3); // 3 + 1 == 4 bytes at a time
-    changeMasterSpiMode(MSPI_TRANSFER);
-    spiWait();
-    changeMasterSpiMode(MSPI_UPDATE);
-    changeMasterSpiMode(MSPI_TRANSFER);
-    unsigned long fileLength = indirectRead(CHIP_CONFIG_SPIRX);
+    memset(&flash, 0, sizeof(flash));
+    flash.transfer = NDPClass::spiTransfer;
+    s = ndpFlashOpen(&flash, flashOffset + FLASH_INDEX_LOCATION);
+    s = s ? s : ndpFlashReadWords(&flash, index, 2);
+    unsigned long fileLength = index[0];
+    unsigned long magicNumber = index[1];
     Serial2.println(fileLength, HEX);
-    changeMasterSpiMode(MSPI_UPDATE);
-    changeMasterSpiMode(MSPI_TRANSFER);
-    unsigned long magicNumber = indirectRead(CHIP_CONFIG_SPIRX);
 
     byte flashBug = 0;
 
@@ -589,69 +1461,46 @@ void loadUilibFlash(byte record)
     Serial2.println(magicNumber, HEX);
     Serial2.println(MAGIC_NUMBER, HEX);
     // Check if magic number is correct
-    if (magicNumber == MAGIC_NUMBER)
+    if (!s && magicNumber == MAGIC_NUMBER)
     {
-        changeMasterSpiMode(MSPI_IDLE);
-
-        // start to read uilib from flash address 0x000000
-        int bufferCount = 0;
-        long bufferIndex = 0;
-
-        for (long i = 0; i < (int)fileLength; i += 4)
+        // start to read uilib from the start of the segment, a full ilibBuf
+        // of data bytes at a time
+        flash.packed = flashBug;
+        wordBytes = flashBug ? 3 : 4;
+        words = (fileLength + 3) / 4;
+        s = ndpFlashOpen(&flash, flashOffset);
+        while (!s && words)
         {
-            if (bufferIndex == 0)
-            {
-                changeMasterSpiMode(MSPI_IDLE);
-                changeMasterSpiMode(MSPI_ENABLE);
-                indirectWrite(CHIP_CONFIG_SPITX, FLASH_READ + flashOffset + i);
-                writeNumBytes(0x3); // read 3 + 1 = 4 bytes
-                changeMasterSpiMode(MSPI_TRANSFER);
-                spiWait();
-            }
-
-            changeMasterSpiMode(MSPI_UPDATE);
-            changeMasterSpiMode(MSPI_TRANSFER);
-            long read = indirectRead(CHIP_CONFIG_SPIRX);
-            if (flashBug)
-            {
-                ilibBuf[bufferIndex + 0] = (read >> 8) & 0xff;
-                ilibBuf[bufferIndex + 1] = (read >> 16) & 0xff;
-                ilibBuf[bufferIndex + 2] = (read >> 24) & 0xff;
-                bufferIndex += 3;
-            }
-            else
+            n = min(words, sizeof(ilibBuf) / wordBytes);
+            s = ndpFlashRead(&flash, ilibBuf, n * wordBytes);
+            if (s)
+                break;
+            words -= n;
+
+            // the uilib takes whole words, pad as the flash is padded
+            for (n *= wordBytes; n & 0x3; n++)
             {
-                ilibBuf[bufferIndex + 0] = read & 0xff;
-                ilibBuf[bufferIndex + 1] = (read >> 8) & 0xff;
-                ilibBuf[bufferIndex + 2] = (read >> 16) & 0xff;
-                ilibBuf[bufferIndex + 3] = (read >> 24) & 0xff;
-                bufferIndex += 4;
+                ilibBuf[n] = 0xff;
             }
 
-            if (bufferIndex == sizeof(ilibBuf))
-            {
-                bufferIndex = 0;
-                // Toggle LED to show progress reading Flash
-                digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
-                bufferCount += 1;
-
-                int s = NDP.loadLog(ilibBuf, sizeof(ilibBuf));
+            // Toggle LED to show progress reading Flash
+            digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
+            s = NDP.loadLog(ilibBuf, n);
+            if (s != SYNTIANT_NDP_ERROR_MORE || !words)
+                break;
 
-                // reenable master SPI -- it may have been disabled as the
-                // result of a reset performed in the uilib log sequence
-                // this is needed to stop master SPI hanging!!!!!
-                enableMasterSpi();
-            }
+            // master SPI may have been disabled as the result of a reset
+            // performed in the uilib log sequence, the reader starts the
+            // read again if so
+            s = ndpFlashResume(&flash);
         }
         digitalWrite(LED_BUILTIN, LOW);
+        ndpFlashClose(&flash);
 
-        for (long i = bufferIndex; i < (int)sizeof(ilibBuf); i++)
-        {
-            ilibBuf[i] = 0xff;
-        }
-        // load last buffer
-        s = NDP.loadLog(ilibBuf, sizeof(ilibBuf));
-        changeMasterSpiMode(MSPI_IDLE);
+        Serial2.print("Flash load ");
+        Serial2.print(flash.transfers);
+        Serial2.print(" reader transfers, us ");
+        Serial2.println(micros() - start);
 
         // check if last reasponse from uilib is 0x00.
         // This indicates uilib successfully loaded
@@ -668,6 +1517,8 @@ void loadUilibFlash(byte record)
         }
     }
 
+    // the reader wrote SPICTL behind the NDP_SPI copy
+    invalidateMasterSpiShadow();
     // Disable Master SPI so we can access NDP LED GPIOs (bug)
     disableMasterSpi();
 }
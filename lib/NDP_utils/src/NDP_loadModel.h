@@ -53,6 +53,25 @@ extern SdFat SD;
 
 #define SD_CONFIG SdSpiConfig(SD_CS, DEDICATED_SPI)
 
+// Bytes of the model file passed to NDP.loadLog at a time. Two blocks are
+// staged in spiData, so at most half its size. Compressed packages (see
+// NDP_lz.h) are decoded a block at a time into them, so their blocks can't
+// be larger.
+#ifndef LOAD_MODEL_BLOCK_SIZE
+#define LOAD_MODEL_BLOCK_SIZE 1024
+#endif
+
+// Time spent in the last loadModel, in microseconds
+struct load_model_timing_s {
+    uint32_t total;
+    uint32_t read;  // reading the model file, and decoding a compressed one
+    uint32_t load;  // in NDP.loadLog, less the writes overlapped with reads
+    uint32_t bytes; // log bytes loaded, 0 when a transfer plan was used
+    uint32_t check; // CRC of the loaded bytes, when the model has a digest
+};
+
+extern struct load_model_timing_s loadModelTiming;
+
 // For loading from flash (USB dongle)
 const unsigned long FLASH_SEGMENT_SIZE = 0x100000;
 const unsigned long FLASH_INDEX_LOCATION = FLASH_SEGMENT_SIZE - 0x8;
@@ -74,7 +93,9 @@ enum Load_BIN_error_messages
     ERROR_LOADING_BIN = 4,
     ERROR_LOADING_FLASH = 5,
     ERROR_LOADING_SD = 6,
-    LOADED_FROM_SERIAL_FLASH = 8
+    LOADED_FROM_SERIAL_FLASH = 8,
+    ERROR_BIN_CRC = 9,   // loaded, but failed its digest (see NDP_crc.h)
+    ERROR_SAVING_BIN = 10 // streamed in and running, but not saved
 };
 
 extern uint32_t cardSectorCount;
@@ -83,6 +104,62 @@ extern byte runningFromFlash;
 extern byte patchApplied;
 
 int loadModel(String model);
+
+// Whether the SD card sense pin shows a card, on either board
+bool sdCardInserted(void);
+
+// Model slots are the model packages (.bin) on the storage the board
+// booted from, the SD card or the Serial Flash. They are kept in RAM, so
+// switching models only costs the load, and in MODEL_SLOT_TABLE next to
+// the models, so a boot only checks the directory against it instead of
+// rewriting it. The table is dropped whenever a model is replaced and is
+// scanned again when the name, size, log checksum or digest of a model no
+// longer matches it, so a model copied over with the same size is caught.
+#define MODEL_SLOTS 8
+#define MODEL_SLOT_NAME 24 // longest file name, with the terminator
+#define MODEL_SLOT_TABLE "slots.tbl"
+const uint32_t MODEL_SLOT_TABLE_MAGIC = 0x544c534e; // "NSLT"
+
+struct model_slot_s {
+    char name[MODEL_SLOT_NAME];
+    uint32_t size;
+    uint32_t version; // checksum tag of the log, 0 if missing
+    bool digest;      // has a digest, so its loads are checked
+};
+
+extern struct model_slot_s modelSlots[MODEL_SLOTS];
+extern int modelSlotCount;
+extern int modelSlotActive; // -1 until a slot is loaded
+
+// Read the slot table of the SD card (it must be begun) or the Serial
+// Flash, scanning the models when it is missing or stale. Returns the
+// number of slots.
+int scanModelSlots(bool fromSd);
+int findModelSlot(const char *name);
+
+// Load a slot into a freshly reset NDP. Returns a loadModel status and
+// makes the slot active on success.
+//
+// loadModel itself falls back to the first other slot with a digest when
+// the model fails its digest, and makes that slot active.
+int loadModelSlot(int slot);
+
+// Reads the next bytes of a model, fewer than count once it ends
+typedef unsigned int (*logRead_f)(void *file, void *buf, unsigned int count);
+
+// Load a model of fileBytes, compressed or not, straight from a stream (the
+// USB serial port) into a freshly reset NDP. All fileBytes are consumed,
+// even when the load fails; crc returns the CRC-32 of the log. With
+// persist, the model is also saved as "model" with its digest, on the SD
+// card or the Serial Flash without one. Either keeps the old model until
+// the new one has loaded: the SD card renames the staged model over it, the
+// Serial Flash copies it over, taking twice the model size.
+int loadModelStream(String model, uint32_t fileBytes, bool persist,
+                    logRead_f read, void *file, uint32_t *crc);
+
+// Remove the transfer plan and digest of a model being replaced, so the new
+// one is not checked against them at boot, and the slot table listing it
+void removeModelSideFiles(String model, bool fromSd);
 void copySdToFlash();
 bool compareFiles(File &file, SerialFlashFile &ffile);
 void fatFormatSd();
@@ -37,6 +37,7 @@
 #include "NDP_SPI.h"
 #include "NDP_Serial.h"
 #include "NDP_loadModel.h"
+#include "NDP_calibrate.h"
 #include "NDP_PMU.h"
 
 #endif
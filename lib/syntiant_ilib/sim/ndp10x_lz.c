@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ *
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Compresses a uILib load log into a package (see NDP_lz.h), and checks
+ * that it decodes back to the log.  The firmware tells packages from logs
+ * by their first word, so the package can keep the model's name.
+ *
+ *   ndp10x_lz model.bin model.lz [block]
+ */
+
+#include <syntiant_ilib/syntiant_portability.h>
+#include <NDP_lz.h>
+
+struct lz_buf_s {
+    const uint8_t *data;
+    uint32_t size;
+    uint32_t off;
+};
+
+static unsigned int
+lz_buf_read(void *ctx, void *buf, unsigned int count)
+{
+    struct lz_buf_s *b = (struct lz_buf_s *) ctx;
+
+    if (b->size - b->off < count) {
+        count = b->size - b->off;
+    }
+    memcpy(buf, b->data + b->off, count);
+    b->off += count;
+    return count;
+}
+
+static uint8_t *
+lz_read_file(const char *path, uint32_t *lenp)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *data;
+    long len;
+
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = (uint8_t *) malloc((size_t) len + 4);
+    if (data && fread(data, 1, (size_t) len, f) != (size_t) len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *lenp = (uint32_t) len;
+    return data;
+}
+
+/* decode the package the way the firmware does and compare */
+static int
+lz_check(const uint8_t *log, uint32_t log_len, const uint8_t *pkg,
+         uint32_t pkg_len)
+{
+    struct ndp_lz_reader_s r;
+    struct lz_buf_s b;
+    uint8_t stage[NDP_LZ_BLOCK_MAX], out[NDP_LZ_BLOCK_MAX];
+    uint32_t off = 0;
+    unsigned int n;
+
+    b.data = pkg;
+    b.size = pkg_len;
+    b.off = sizeof(r.header);
+    r.ctx = &b;
+    r.read = lz_buf_read;
+    r.stage = stage;
+    r.stageSize = sizeof(stage);
+    if (!ndpLzOpen(&r, pkg)) {
+        return 0;
+    }
+    while ((n = ndpLzRead(&r, out, sizeof(out)))) {
+        if (log_len - off < n || memcmp(log + off, out, n)) {
+            return 0;
+        }
+        off += n;
+    }
+    return !r.error && off == log_len && b.off == pkg_len;
+}
+
+int
+main(int argc, char **argv)
+{
+    uint8_t *log, *pkg;
+    uint32_t log_len, pkg_len;
+    uint32_t block = NDP_LZ_BLOCK_MAX;
+    FILE *f;
+
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "usage: %s model.bin model.lz [block]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 4) {
+        block = (uint32_t) strtoul(argv[3], NULL, 0);
+    }
+
+    log = lz_read_file(argv[1], &log_len);
+    if (!log) {
+        fprintf(stderr, "unable to read %s\n", argv[1]);
+        return 1;
+    }
+    pkg = (uint8_t *) malloc(ndpLzMaxBytes(log_len, block));
+    pkg_len = pkg ? ndpLzPack(log, log_len, block, pkg) : 0;
+    if (!pkg_len || !lz_check(log, log_len, pkg, pkg_len)) {
+        fprintf(stderr, "unable to compress %s in %u byte blocks, it must "
+                "end in a checksum tag and blocks be a multiple of 4 up to "
+                "%u\n", argv[1], (unsigned int) block, NDP_LZ_BLOCK_MAX);
+        return 1;
+    }
+
+    f = fopen(argv[2], "wb");
+    if (!f || fwrite(pkg, 1, pkg_len, f) != pkg_len || fclose(f)) {
+        fprintf(stderr, "unable to write %s\n", argv[2]);
+        return 1;
+    }
+    printf("%s: %u log bytes -> %u package bytes (%.1f%%)\n", argv[2],
+           (unsigned int) log_len, (unsigned int) pkg_len,
+           log_len ? 100.0 * pkg_len / log_len : 0.0);
+
+    free(pkg);
+    free(log);
+    return 0;
+}
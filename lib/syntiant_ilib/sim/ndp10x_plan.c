@@ -0,0 +1,176 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ *
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Compiles a uILib load log into a transfer plan (see NDP_plan.h).  The
+ * log is first loaded into the NDP10x simulator and must load cleanly.
+ * Optionally writes the log's digest (see NDP_crc.h) as well.
+ *
+ *   ndp10x_plan model.bin model.pln [model.crc]
+ */
+
+#include <syntiant_ilib/syntiant_portability.h>
+#include <syntiant_ilib/syntiant_ndp_error.h>
+#include <syntiant_ilib/syntiant_ndp10x_micro.h>
+#include <NDP_crc.h>
+#include <NDP_plan.h>
+#include "ndp10x_sim.h"
+
+/* log chunk size used by the firmware */
+#define PLAN_LOG_CHUNK 1024U
+
+static const char *plan_error_names[] = SYNTIANT_NDP_ERROR_NAMES;
+
+static const char *
+plan_error_name(int e)
+{
+    return (e < SYNTIANT_NDP_ERROR_NONE || SYNTIANT_NDP_ERROR_LAST < e)
+        ? "*unknown*" : plan_error_names[e];
+}
+
+static uint8_t *
+plan_read_file(const char *path, uint32_t *lenp)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *data;
+    long len;
+
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = (uint8_t *) malloc((size_t) len + 4);
+    if (data && fread(data, 1, (size_t) len, f) != (size_t) len) {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    *lenp = (uint32_t) len;
+    return data;
+}
+
+static int
+plan_write_file(const char *path, const void *data, uint32_t len)
+{
+    FILE *f = fopen(path, "wb");
+
+    if (!f || fwrite(data, 1, len, f) != len || fclose(f)) {
+        fprintf(stderr, "unable to write %s\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+/* load the log the way the firmware does, returns a SYNTIANT_NDP_ERROR */
+static int
+plan_validate(uint8_t *log, uint32_t log_len)
+{
+    struct syntiant_ndp10x_micro_device_s ndp;
+    struct ndp10x_sim_s sim;
+    uint32_t off, n;
+    int s;
+
+    s = ndp10x_sim_init(&sim);
+    if (s) {
+        return s;
+    }
+    memset(&ndp, 0, sizeof(ndp));
+    ndp.d = &sim;
+    ndp.transfer = ndp10x_sim_transfer;
+
+    s = syntiant_ndp10x_micro_load_log(&ndp, NULL, 0);
+    for (off = 0; s == SYNTIANT_NDP_ERROR_MORE && off < log_len; off += n) {
+        n = log_len - off < PLAN_LOG_CHUNK ? log_len - off : PLAN_LOG_CHUNK;
+        s = syntiant_ndp10x_micro_load_log(&ndp, log + off, (int) n);
+    }
+    ndp10x_sim_free(&sim);
+    return s == SYNTIANT_NDP_ERROR_MORE ? SYNTIANT_NDP_ERROR_PACKAGE : s;
+}
+
+int
+main(int argc, char **argv)
+{
+    struct ndp_plan_header_s h;
+    struct ndp_digest_s digest;
+    uint8_t *log, *plan;
+    uint32_t log_len, plan_len;
+    int s;
+
+    if (argc != 3 && argc != 4) {
+        fprintf(stderr, "usage: %s model.bin model.pln [model.crc]\n",
+                argv[0]);
+        return 1;
+    }
+
+    log = plan_read_file(argv[1], &log_len);
+    if (!log) {
+        fprintf(stderr, "unable to read %s\n", argv[1]);
+        return 1;
+    }
+    s = plan_validate(log, log_len);
+    if (s) {
+        fprintf(stderr, "%s does not load: %s\n", argv[1], plan_error_name(s));
+        return 1;
+    }
+
+    plan = (uint8_t *) malloc(ndpPlanMaxBytes(log_len));
+    plan_len = plan ? ndpPlanBuild(log, log_len, plan) : 0;
+    if (!plan_len) {
+        fprintf(stderr, "unable to build a plan of %s\n", argv[1]);
+        return 1;
+    }
+
+    if (!plan_write_file(argv[2], plan, plan_len)) {
+        return 1;
+    }
+
+    memcpy(&h, plan, sizeof(h));
+    printf("%s: %u log bytes -> %u records, %u payload bytes, %u plan bytes\n",
+           argv[2], (unsigned int) log_len, (unsigned int) h.records,
+           (unsigned int) h.payloadBytes, (unsigned int) plan_len);
+
+    if (argc == 4) {
+        digest.magic = NDP_DIGEST_MAGIC;
+        digest.logBytes = log_len;
+        digest.crc = ndpCrc32(0, log, log_len);
+        if (!plan_write_file(argv[3], &digest, sizeof(digest))) {
+            return 1;
+        }
+        printf("%s: crc %08x\n", argv[3], (unsigned int) digest.crc);
+    }
+
+    free(plan);
+    free(log);
+    return 0;
+}
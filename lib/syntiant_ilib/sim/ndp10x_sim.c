@@ -0,0 +1,427 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ *
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include <syntiant_ilib/syntiant_portability.h>
+#include <syntiant_ilib/syntiant_ndp_error.h>
+#include "ndp10x_sim.h"
+
+/*
+ * register and memory map, mirrors the private definitions in
+ * syntiant_ndp10x_micro.c
+ */
+#define NDP10X_SPI_ID0 0x00U
+#define NDP10X_SPI_ID0_VALUE 0x20U
+#define NDP10X_SPI_INTSTS 0x02U
+#define NDP10X_SPI_INTSTS_MBIN_INT 0x02U
+#define NDP10X_SPI_SAMPLE 0x20U
+#define NDP10X_SPI_MBIN 0x30U
+#define NDP10X_SPI_MBIN_RESP 0x31U
+#define NDP10X_SPI_MADDR 0x40U
+#define NDP10X_SPI_MDATA 0x44U
+#define NDP10X_SPI_MATCH_MATCH_MASK 0x40U
+
+#define NDP10X_MB_HOST_TO_MCU_OWNER 0x08U
+#define NDP10X_MB_HOST_TO_MCU_M 0x07U
+#define NDP10X_MB_MCU_TO_HOST_OWNER 0x80U
+#define NDP10X_MB_RESPONSE_SUCCESS 0x0U
+
+#define NDP10X_BOOTROM 0x01000000U
+#define NDP10X_CHIP_CONFIG_FLLSTS0 0x40009068U
+#define NDP10X_CHIP_CONFIG_FLLSTS0_MODE_LOCKED 0x5U
+#define NDP10X_DSP_CONFIG_TANK 0x4000c0a8U
+#define NDP10X_DSP_CONFIG_TANK_SIZE_SHIFT 4
+#define NDP10X_DSP_CONFIG_TANKADDR 0x4000c0b0U
+#define NDP10X_FW_STATE_POINTERS_FW_STATE 0x1fffc0c0U
+#define NDP10X_FW_STATE_TANKPTR_OFFSET 0
+#define NDP10X_FW_STATE_MATCH_RING_SIZE_OFFSET 4
+#define NDP10X_FW_STATE_MATCH_PRODUCER_OFFSET 8
+#define NDP10X_FW_STATE_MATCH_RING_OFFSET 12
+#define NDP10X_FW_STATE_MATCH_RING_ENTRY_BYTES 8
+
+#define NDP10X_CHIP_CONFIG_SPICTL 0x40009014U
+#define NDP10X_CHIP_CONFIG_SPITX 0x40009018U
+#define NDP10X_CHIP_CONFIG_SPIRX 0x4000901cU
+#define NDP10X_SPICTL_MODE 0x3U
+#define NDP10X_SPICTL_MODE_IDLE 0x0U
+#define NDP10X_SPICTL_MODE_TRANSFER 0x2U
+#define NDP10X_SPICTL_NUMBYTES_SHIFT 2
+#define NDP10X_SPICTL_NUMBYTES_MASK 0x3U
+#define NDP10X_SPICTL_ENABLE 0x100U
+#define NDP10X_SPICTL_DONE 0x200U
+#define NDP10X_FLASH_READ 0x03U
+
+/* command and address bytes per frame of the Arduino SPI driver */
+#define NDP10X_SIM_MCU_HEADER 5U
+#define NDP10X_SIM_SPI_HEADER 1U
+
+static uint8_t *
+ndp10x_sim_byte(struct ndp10x_sim_s *sim, uint32_t addr, int alloc)
+{
+    struct ndp10x_sim_page_s **pages;
+    struct ndp10x_sim_page_s *page;
+    uint32_t base = addr & ~(NDP10X_SIM_PAGE_SIZE - 1);
+    unsigned int i;
+
+    for (i = 0; i < sim->npages; i++) {
+        if (sim->pages[i]->base == base) {
+            return &sim->pages[i]->data[addr - base];
+        }
+    }
+    if (!alloc) {
+        return NULL;
+    }
+
+    pages = (struct ndp10x_sim_page_s **)
+        realloc(sim->pages, (sim->npages + 1) * sizeof(*pages));
+    page = (struct ndp10x_sim_page_s *) calloc(1, sizeof(*page));
+    if (!pages || !page) {
+        fprintf(stderr, "ndp10x_sim: out of memory\n");
+        abort();
+    }
+    page->base = base;
+    pages[sim->npages++] = page;
+    sim->pages = pages;
+    return &page->data[addr - base];
+}
+
+static uint8_t
+ndp10x_sim_mem_get(struct ndp10x_sim_s *sim, uint32_t addr)
+{
+    uint8_t *p = ndp10x_sim_byte(sim, addr, 0);
+
+    return p ? *p : 0;
+}
+
+static void
+ndp10x_sim_mem_set(struct ndp10x_sim_s *sim, uint32_t addr, uint8_t v)
+{
+    *ndp10x_sim_byte(sim, addr, 1) = v;
+}
+
+uint32_t
+ndp10x_sim_read(struct ndp10x_sim_s *sim, uint32_t addr)
+{
+    uint32_t v = 0;
+    int i;
+
+    for (i = 3; 0 <= i; i--) {
+        v = (v << 8) | ndp10x_sim_mem_get(sim, addr + (uint32_t) i);
+    }
+    return v;
+}
+
+void
+ndp10x_sim_write(struct ndp10x_sim_s *sim, uint32_t addr, uint32_t v)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        ndp10x_sim_mem_set(sim, addr + (uint32_t) i, (uint8_t) (v >> (8 * i)));
+    }
+}
+
+int
+ndp10x_sim_init(struct ndp10x_sim_s *sim)
+{
+    uint32_t fw = NDP10X_SIM_FW_STATE;
+
+    memset(sim, 0, sizeof(*sim));
+
+    sim->spi[NDP10X_SPI_ID0] = NDP10X_SPI_ID0_VALUE;
+
+    /* the external clock probe wants two distinct boot ROM words */
+    ndp10x_sim_write(sim, NDP10X_BOOTROM, 0x20001000U);
+    ndp10x_sim_write(sim, NDP10X_BOOTROM + 4, 0x01000101U);
+    ndp10x_sim_write(sim, NDP10X_CHIP_CONFIG_FLLSTS0,
+                     NDP10X_CHIP_CONFIG_FLLSTS0_MODE_LOCKED);
+
+    ndp10x_sim_write(sim, NDP10X_DSP_CONFIG_TANK,
+                     NDP10X_SIM_TANK_SIZE << NDP10X_DSP_CONFIG_TANK_SIZE_SHIFT);
+    ndp10x_sim_write(sim, NDP10X_DSP_CONFIG_TANKADDR, NDP10X_SIM_TANK_ADDR);
+
+    ndp10x_sim_write(sim, NDP10X_FW_STATE_POINTERS_FW_STATE, fw);
+    ndp10x_sim_write(sim, fw + NDP10X_FW_STATE_TANKPTR_OFFSET, 0);
+    ndp10x_sim_write(sim, fw + NDP10X_FW_STATE_MATCH_RING_SIZE_OFFSET,
+                     NDP10X_SIM_MATCH_RING_SIZE);
+    ndp10x_sim_write(sim, fw + NDP10X_FW_STATE_MATCH_PRODUCER_OFFSET, 0);
+
+    return SYNTIANT_NDP_ERROR_NONE;
+}
+
+void
+ndp10x_sim_free(struct ndp10x_sim_s *sim)
+{
+    unsigned int i;
+
+    for (i = 0; i < sim->npages; i++) {
+        free(sim->pages[i]);
+    }
+    free(sim->pages);
+    sim->pages = NULL;
+    sim->npages = 0;
+}
+
+void
+ndp10x_sim_clear_stats(struct ndp10x_sim_s *sim)
+{
+    memset(&sim->stats, 0, sizeof(sim->stats));
+}
+
+void
+ndp10x_sim_audio(struct ndp10x_sim_s *sim, const uint8_t *data,
+                 unsigned int len)
+{
+    unsigned int i;
+
+    for (i = 0; i < len; i++) {
+        ndp10x_sim_mem_set(sim, NDP10X_SIM_TANK_ADDR + sim->tankptr, data[i]);
+        sim->tankptr++;
+        if (sim->tankptr == NDP10X_SIM_TANK_SIZE) {
+            sim->tankptr = 0;
+        }
+    }
+    ndp10x_sim_write(sim, NDP10X_SIM_FW_STATE + NDP10X_FW_STATE_TANKPTR_OFFSET,
+                     sim->tankptr);
+}
+
+void
+ndp10x_sim_match(struct ndp10x_sim_s *sim, int winner)
+{
+    uint32_t entry = NDP10X_SIM_FW_STATE + NDP10X_FW_STATE_MATCH_RING_OFFSET
+        + sim->producer * NDP10X_FW_STATE_MATCH_RING_ENTRY_BYTES;
+
+    ndp10x_sim_write(sim, entry,
+                     NDP10X_SPI_MATCH_MATCH_MASK | (uint32_t) winner);
+    ndp10x_sim_write(sim, entry + 4, sim->tankptr);
+    sim->producer++;
+    if (sim->producer == NDP10X_SIM_MATCH_RING_SIZE) {
+        sim->producer = 0;
+    }
+    ndp10x_sim_write(sim,
+                     NDP10X_SIM_FW_STATE + NDP10X_FW_STATE_MATCH_PRODUCER_OFFSET,
+                     sim->producer);
+
+    /* one notification until the host answers, it covers later matches */
+    if (!((sim->spi[NDP10X_SPI_MBIN] ^ sim->spi[NDP10X_SPI_MBIN_RESP])
+          & NDP10X_MB_MCU_TO_HOST_OWNER)) {
+        sim->spi[NDP10X_SPI_MBIN_RESP] ^= NDP10X_MB_MCU_TO_HOST_OWNER;
+        sim->spi[NDP10X_SPI_INTSTS] |= NDP10X_SPI_INTSTS_MBIN_INT;
+    }
+}
+
+void
+ndp10x_sim_flash(struct ndp10x_sim_s *sim, const uint8_t *image,
+                 uint32_t size)
+{
+    sim->flash = image;
+    sim->flash_size = size;
+    sim->flash_open = 0;
+}
+
+/*
+ * SPICTL was written over a value of old: the done bit is status and
+ * keeps its value, a switch into transfer mode clocks numbytes + 1 bytes,
+ * finishing at once
+ */
+static void
+ndp10x_sim_mspi(struct ndp10x_sim_s *sim, uint32_t old)
+{
+    uint32_t ctl = (ndp10x_sim_read(sim, NDP10X_CHIP_CONFIG_SPICTL)
+                    & ~NDP10X_SPICTL_DONE) | (old & NDP10X_SPICTL_DONE);
+    uint32_t mode = ctl & NDP10X_SPICTL_MODE;
+    uint32_t rx = 0;
+    unsigned int n, k;
+
+    ndp10x_sim_write(sim, NDP10X_CHIP_CONFIG_SPICTL, ctl);
+
+    if (!(ctl & NDP10X_SPICTL_ENABLE) || mode == NDP10X_SPICTL_MODE_IDLE) {
+        sim->flash_open = 0;
+        return;
+    }
+    if (mode != NDP10X_SPICTL_MODE_TRANSFER
+        || (old & NDP10X_SPICTL_MODE) == NDP10X_SPICTL_MODE_TRANSFER) {
+        return;
+    }
+
+    if (!sim->flash_open) {
+        sim->flash_addr = ndp10x_sim_read(sim, NDP10X_CHIP_CONFIG_SPITX)
+            - NDP10X_FLASH_READ;
+        sim->flash_open = 1;
+    } else {
+        n = ((ctl >> NDP10X_SPICTL_NUMBYTES_SHIFT)
+             & NDP10X_SPICTL_NUMBYTES_MASK) + 1;
+        for (k = 0; k < n; k++, sim->flash_addr++) {
+            rx |= (uint32_t) (sim->flash_addr < sim->flash_size
+                              ? sim->flash[sim->flash_addr] : 0xffU)
+                << (8 * k);
+        }
+        ndp10x_sim_write(sim, NDP10X_CHIP_CONFIG_SPIRX, rx);
+    }
+    ndp10x_sim_write(sim, NDP10X_CHIP_CONFIG_SPICTL,
+                     ctl | NDP10X_SPICTL_DONE);
+}
+
+/*
+ * one byte of a transfer in SPI register space; reg keeps counting past
+ * the MADDR window into the data stream of MCU memory
+ */
+static uint8_t
+ndp10x_sim_spi_byte(struct ndp10x_sim_s *sim, uint32_t reg, int write,
+                    uint8_t v)
+{
+    unsigned int shift;
+    uint8_t old;
+
+    if (NDP10X_SPI_MDATA <= reg) {
+        if (write) {
+            ndp10x_sim_mem_set(sim, sim->maddr + reg - NDP10X_SPI_MDATA, v);
+        }
+        return ndp10x_sim_mem_get(sim, sim->maddr + reg - NDP10X_SPI_MDATA);
+    }
+
+    if (NDP10X_SPI_MADDR <= reg) {
+        shift = 8 * (reg - NDP10X_SPI_MADDR);
+        if (write) {
+            sim->maddr = (sim->maddr & ~(0xffU << shift))
+                | ((uint32_t) v << shift);
+        }
+        return (uint8_t) (sim->maddr >> shift);
+    }
+
+    if (!write) {
+        return sim->spi[reg];
+    }
+
+    switch (reg) {
+    case NDP10X_SPI_ID0:
+    case NDP10X_SPI_MBIN_RESP:
+        break;
+    case NDP10X_SPI_INTSTS:
+        sim->spi[reg] &= (uint8_t) ~v;
+        break;
+    case NDP10X_SPI_MBIN:
+        old = sim->spi[reg];
+        sim->spi[reg] = v;
+        /* a flipped host owner bit is a new request, answer it at once */
+        if ((old ^ v) & NDP10X_MB_HOST_TO_MCU_OWNER) {
+            sim->spi[NDP10X_SPI_MBIN_RESP] = (uint8_t)
+                ((sim->spi[NDP10X_SPI_MBIN_RESP]
+                  & ~(NDP10X_MB_HOST_TO_MCU_OWNER | NDP10X_MB_HOST_TO_MCU_M))
+                 | (v & NDP10X_MB_HOST_TO_MCU_OWNER)
+                 | NDP10X_MB_RESPONSE_SUCCESS);
+        }
+        break;
+    default:
+        sim->spi[reg] = v;
+    }
+    return v;
+}
+
+int
+ndp10x_sim_transfer(void *d, int mcu, uint32_t addr, void *out, void *in,
+                    unsigned int count)
+{
+    struct ndp10x_sim_s *sim = (struct ndp10x_sim_s *) d;
+    uint8_t *o = (uint8_t *) out;
+    uint8_t *i = (uint8_t *) in;
+    uint32_t ctl;
+    uint8_t v;
+    unsigned int k;
+
+    if (out && in) {
+        return SYNTIANT_NDP_ERROR_ARG;
+    }
+
+    sim->stats.transfers++;
+    sim->stats.payload_bytes += count;
+
+    if (mcu) {
+        if (count % 4 || addr % 4) {
+            return SYNTIANT_NDP_ERROR_ARG;
+        }
+        if (out) {
+            sim->stats.mcu_writes++;
+            sim->stats.frames++;
+            sim->stats.wire_bytes += NDP10X_SIM_MCU_HEADER + count;
+            ctl = ndp10x_sim_read(sim, NDP10X_CHIP_CONFIG_SPICTL);
+            for (k = 0; k < count; k++) {
+                ndp10x_sim_mem_set(sim, addr + k, o[k]);
+            }
+            if (addr <= NDP10X_CHIP_CONFIG_SPICTL
+                && NDP10X_CHIP_CONFIG_SPICTL - addr < count) {
+                ndp10x_sim_mspi(sim, ctl);
+            }
+        } else {
+            /* address frame, then command and 4 dummy bytes */
+            sim->stats.mcu_reads++;
+            sim->stats.frames += 2;
+            sim->stats.wire_bytes += 2 * NDP10X_SIM_MCU_HEADER + count;
+            for (k = 0; k < count; k++) {
+                v = ndp10x_sim_mem_get(sim, addr + k);
+                if (i) {
+                    i[k] = v;
+                }
+            }
+        }
+        sim->maddr = addr;
+        return SYNTIANT_NDP_ERROR_NONE;
+    }
+
+    if (0xff < addr) {
+        return SYNTIANT_NDP_ERROR_ARG;
+    }
+    sim->stats.frames++;
+    sim->stats.wire_bytes += NDP10X_SIM_SPI_HEADER + count;
+    if (out) {
+        sim->stats.spi_writes++;
+    } else {
+        sim->stats.spi_reads++;
+    }
+
+    if (addr == NDP10X_SPI_SAMPLE) {
+        /* the sample FIFO feeds the holding tank directly */
+        if (out) {
+            ndp10x_sim_audio(sim, o, count & ~0x3U);
+        } else if (i) {
+            memset(i, 0, count);
+        }
+        return SYNTIANT_NDP_ERROR_NONE;
+    }
+
+    for (k = 0; k < count; k++) {
+        v = ndp10x_sim_spi_byte(sim, addr + k, out != NULL, o ? o[k] : 0);
+        if (i) {
+            i[k] = v;
+        }
+    }
+    return SYNTIANT_NDP_ERROR_NONE;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ *
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#ifndef NDP10X_SIM_H
+#define NDP10X_SIM_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @file ndp10x_sim.h
+ * @brief Host-side behavioral model of an NDP10x for the micro ILib
+ *
+ * The simulator plugs in as the @c transfer function of a
+ * @c syntiant_ndp10x_micro_device_s.  It models the SPI register file,
+ * the MADDR window into MCU space, sparse MCU memory, the DSP holding tank
+ * with its moving tank pointer, the mailbox, the firmware-state match
+ * ring and a serial flash on the master SPI port.  Every transfer is counted the way the Arduino SPI driver puts it
+ * on the wire, so transport and driver changes can be measured on Linux.
+ */
+
+#include <stdint.h>
+
+/** @brief bytes per page of simulated MCU memory */
+#define NDP10X_SIM_PAGE_SIZE 4096U
+
+/** @brief simulated MCU memory layout */
+#define NDP10X_SIM_FW_STATE 0x20017f00U
+#define NDP10X_SIM_MATCH_RING_SIZE 4U
+#define NDP10X_SIM_TANK_ADDR 0x20008000U
+#define NDP10X_SIM_TANK_SIZE 0x00008000U
+
+/**
+ * @brief transfer counters
+ *
+ * A transfer is one call of the transfer function.  A frame is one chip
+ * select assertion: MCU reads need two (address phase and data phase).
+ * Wire bytes include the command, address and dummy bytes of each frame.
+ */
+struct ndp10x_sim_stats_s {
+    unsigned long transfers;        /**< transfer function calls */
+    unsigned long frames;           /**< chip select assertions */
+    unsigned long wire_bytes;       /**< bytes clocked on the SPI bus */
+    unsigned long payload_bytes;    /**< data bytes requested by the caller */
+    unsigned long mcu_reads;        /**< MCU space read transfers */
+    unsigned long mcu_writes;       /**< MCU space write transfers */
+    unsigned long spi_reads;        /**< SPI register read transfers */
+    unsigned long spi_writes;       /**< SPI register write transfers */
+};
+
+struct ndp10x_sim_page_s {
+    uint32_t base;
+    uint8_t data[NDP10X_SIM_PAGE_SIZE];
+};
+
+/**
+ * @brief simulated device state
+ *
+ * Zeroed and set up by @c ndp10x_sim_init, released by @c ndp10x_sim_free.
+ */
+struct ndp10x_sim_s {
+    uint8_t spi[256];               /**< SPI register file */
+    uint32_t maddr;                 /**< MADDR window address */
+    struct ndp10x_sim_page_s **pages; /**< sparse MCU memory */
+    unsigned int npages;
+    uint32_t tankptr;               /**< tank write offset in bytes */
+    uint32_t producer;              /**< match ring producer */
+    const uint8_t *flash;           /**< master SPI flash image */
+    uint32_t flash_size;
+    uint32_t flash_addr;            /**< next byte of the open read */
+    int flash_open;
+    struct ndp10x_sim_stats_s stats;
+};
+
+/**
+ * @brief set up a freshly reset device with the firmware state, holding
+ *        tank and match ring already in place
+ *
+ * @param sim simulator state
+ * @return a @c SYNTIANT_NDP_ERROR_* code
+ */
+extern int ndp10x_sim_init(struct ndp10x_sim_s *sim);
+
+/**
+ * @brief release the simulated MCU memory
+ */
+extern void ndp10x_sim_free(struct ndp10x_sim_s *sim);
+
+/**
+ * @brief @c syntiant_ndp10x_micro_transfer_f provider, @p d is the
+ *        @c ndp10x_sim_s
+ */
+extern int ndp10x_sim_transfer(void *d, int mcu, uint32_t addr, void *out,
+                               void *in, unsigned int count);
+
+/**
+ * @brief read or write simulated MCU memory without counting it as SPI
+ *        traffic
+ */
+extern uint32_t ndp10x_sim_read(struct ndp10x_sim_s *sim, uint32_t addr);
+extern void ndp10x_sim_write(struct ndp10x_sim_s *sim, uint32_t addr,
+                             uint32_t v);
+
+/**
+ * @brief append audio to the holding tank as the microphone path would,
+ *        advancing the firmware tank pointer
+ *
+ * @param sim simulator state
+ * @param data bytes to append
+ * @param len number of bytes, a multiple of 4
+ */
+extern void ndp10x_sim_audio(struct ndp10x_sim_s *sim, const uint8_t *data,
+                             unsigned int len);
+
+/**
+ * @brief post a match the way the firmware does: add a match ring entry
+ *        at the current tank pointer and, unless the host has yet to answer
+ *        the last one, flip the MCU-to-host mailbox owner and raise the
+ *        mailbox interrupt.  Posting a ring's worth of unread matches
+ *        overwrites the oldest.
+ *
+ * @param sim simulator state
+ * @param winner winning class
+ */
+extern void ndp10x_sim_match(struct ndp10x_sim_s *sim, int winner);
+
+/**
+ * @brief attach a serial flash image to the master SPI port
+ *
+ * A transfer started with no read open takes SPITX as the read command
+ * @c FLASH_READ @c + @c address; later transfers shift the following
+ * flash bytes into SPIRX, first byte lowest.  Idle mode or disabling the
+ * port ends the read.  Reads past the image return 0xff.
+ *
+ * @param sim simulator state
+ * @param image flash contents, not copied
+ * @param size bytes in @p image
+ */
+extern void ndp10x_sim_flash(struct ndp10x_sim_s *sim, const uint8_t *image,
+                             uint32_t size);
+
+/**
+ * @brief zero the transfer counters
+ */
+extern void ndp10x_sim_clear_stats(struct ndp10x_sim_s *sim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1747 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ *
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/*
+ * Runs the micro ILib against the NDP10x simulator and reports the SPI
+ * traffic of boot (log loading), match polling and holding tank
+ * extraction, compares booting from the log with replaying its transfer
+ * plan and with reading it from the master SPI flash, times the CRC-32
+ * that checks model loads, boots from compressed packages, streams USB
+ * audio through the tank streamer, drains bursts of matches into the
+ * match event queue, then runs v2 bridge frames through a loopback link.
+ *
+ *   ndp10x_sim_bench [-l log.bin] [-c chunk] [-n polls] [-m every]
+ *                    [-x extract] [-s seconds] [-b frames] [-k ops]
+ *                    [-r boots]
+ */
+
+#include <syntiant_ilib/syntiant_portability.h>
+#include <syntiant_ilib/syntiant_ndp_error.h>
+#include <syntiant_ilib/syntiant_ndp10x_micro.h>
+#include <unistd.h>
+#include <time.h>
+#include <NDP_async.h>
+#include <NDP_bridge.h>
+#include <NDP_crc.h>
+#include <NDP_events.h>
+#include <NDP_flash.h>
+#include <NDP_list.h>
+#include <NDP_lz.h>
+#include <NDP_plan.h>
+#include <NDP_tank.h>
+#include "ndp10x_sim.h"
+
+#define TAG_HEADER 1U
+#define TAG_CHECKSUM 4U
+#define TAG_UILIB_EXT_CLK 28U
+#define TAG_UILIB_INT_CLK 29U
+#define TAG_UILIB_SPI_WRITE 30U
+#define TAG_UILIB_MCU_WRITE 31U
+#define TAG_UILIB_MB_NOP 74U
+#define MAGIC_VALUE 0x53bde5a1U
+
+/* size of the synthetic firmware image, close to a small audio model */
+#define BENCH_IMAGE_BYTES (64U * 1024U)
+#define BENCH_IMAGE_ADDR 0x20000000U
+
+/* bridge frames poke words here, away from the image and the tank */
+#define BENCH_BRIDGE_ADDR 0x20010000U
+#define BENCH_BRIDGE_FRAME 1032U
+#define BENCH_BRIDGE_CHUNK 2048U
+
+/* flash reads go to the uILib in ilibBuf blocks */
+#define BENCH_FLASH_BLOCK 1032U
+
+/*
+ * tank: the DSP writes 10 ms frames of 16 kHz 16-bit audio and USB audio
+ * takes 32 bytes a 1 ms tick, with the firmware's ring, poll interval and
+ * prefill
+ */
+#define BENCH_TANK_FRAME_MS 10U
+#define BENCH_TANK_FRAME 320U
+#define BENCH_TANK_RING 2048U
+#define BENCH_TANK_POLL 4U
+#define BENCH_TANK_PREFILL 512U
+
+/*
+ * events: up to a match ring less one of matches posted back to back
+ * between two NDP interrupts, and the main loop taking the queue every
+ * few interrupts
+ */
+#define BENCH_EVENTS_BURST (NDP10X_SIM_MATCH_RING_SIZE - 1U)
+#define BENCH_EVENTS_MAIN 4U
+#define BENCH_EVENTS_AUDIO 64U
+#define BENCH_EVENTS_SUMMARY_MATCH 0x40U /* summary word match bit */
+
+/*
+ * dma: payloads from this size go through the transfer queue, as
+ * NDP_DMA_MIN_COUNT, fed from two alternating blocks as loadLogPipelined
+ */
+#define BENCH_DMA_MIN_COUNT 16U
+#define BENCH_DMA_BLOCK 1024U
+
+/* list: words read or written in each address pattern */
+#define BENCH_LIST_WORDS 256U
+#define BENCH_LIST_PATTERNS 4
+
+/* NDP SPI clock, and the pause between the two frames of an MCU read */
+#define BENCH_SPI_MHZ 12.0
+#define BENCH_MCU_READ_US 1.0
+
+/*
+ * Cortex-M0+ cycles a byte of each CRC-32 loop, counted from the
+ * instructions it compiles to with one flash wait state (SAMD21 at 48 MHz):
+ * bit loop 8 steps of 6 and the byte load, byte table one step of 10 with
+ * the load and loop, word table a word load and 4 steps of 7 per 4 bytes
+ */
+#define BENCH_M0_MHZ 48.0
+static const double bench_crc_m0_cycles[3] = {70.0, 13.0, 9.0};
+
+/*
+ * a stored package decodes at copy speed, a few microseconds a log, so the
+ * decode is repeated for at least this long to time it above the clock
+ */
+#define BENCH_LZ_MIN_S 0.25
+static const char *bench_crc_names[3] = {"bit loop", "byte table",
+                                         "word table"};
+
+static const char *bench_error_names[] = SYNTIANT_NDP_ERROR_NAMES;
+
+static const char *
+bench_error_name(int e)
+{
+    return (e < SYNTIANT_NDP_ERROR_NONE || SYNTIANT_NDP_ERROR_LAST < e)
+        ? "*unknown*" : bench_error_names[e];
+}
+
+static uint32_t *
+bench_put(uint32_t *p, uint32_t tag, uint32_t len)
+{
+    *p++ = tag;
+    *p++ = len;
+    return p;
+}
+
+/*
+ * a log with the same TLV mix as a real model package: header, clock
+ * setup, one large MCU write, a register write, a mailbox NOP and the
+ * closing checksum. The image is incompressible, or with sparse like
+ * pruned 4-bit weights: 60% zero bytes, the rest small values.
+ */
+static uint8_t *
+bench_synthetic_log(unsigned int *lenp, int sparse)
+{
+    uint32_t x = 2463534242U;
+    uint8_t *b;
+    unsigned int words = 32 + BENCH_IMAGE_BYTES / 4;
+    uint32_t *log = (uint32_t *) calloc(words, sizeof(uint32_t));
+    uint32_t *p = log;
+    unsigned int i;
+
+    if (!log) {
+        return NULL;
+    }
+    p = bench_put(p, TAG_HEADER, 4);
+    *p++ = MAGIC_VALUE;
+    p = bench_put(p, TAG_UILIB_INT_CLK, 0);
+    p = bench_put(p, TAG_UILIB_EXT_CLK, 0);
+    p = bench_put(p, TAG_UILIB_MCU_WRITE, 4 + BENCH_IMAGE_BYTES);
+    *p++ = BENCH_IMAGE_ADDR;
+    for (i = 0; i < BENCH_IMAGE_BYTES / 4; i++) {
+        *p++ = i * 2654435761U;
+    }
+    if (sparse) {
+        b = (uint8_t *) (p - BENCH_IMAGE_BYTES / 4);
+        for (i = 0; i < BENCH_IMAGE_BYTES; i++) {
+            x ^= x << 13;
+            x ^= x >> 17;
+            x ^= x << 5;
+            b[i] = x % 100 < 60 ? 0 : (uint8_t) ((x >> 8) & 0x0f);
+        }
+    }
+    p = bench_put(p, TAG_UILIB_SPI_WRITE, 4 + 1);
+    *p++ = 0x10;
+    *p++ = 0x01;
+    p = bench_put(p, TAG_UILIB_MB_NOP, 0);
+    p = bench_put(p, TAG_CHECKSUM, 4);
+    *p++ = 0;
+
+    *lenp = (unsigned int) ((uint8_t *) p - (uint8_t *) log);
+    return (uint8_t *) log;
+}
+
+static uint8_t *
+bench_read_log(const char *path, unsigned int *lenp)
+{
+    FILE *f = fopen(path, "rb");
+    uint8_t *log;
+    long len;
+
+    if (!f) {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    len = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    log = (uint8_t *) malloc((size_t) len + 4);
+    if (log && fread(log, 1, (size_t) len, f) != (size_t) len) {
+        free(log);
+        log = NULL;
+    }
+    fclose(f);
+    *lenp = (unsigned int) len;
+    return log;
+}
+
+static void
+bench_report(const char *phase, struct ndp10x_sim_s *sim, unsigned long ops)
+{
+    struct ndp10x_sim_stats_s *st = &sim->stats;
+
+    printf("%-8s %8lu %10lu %10lu %12lu %12lu %10.2f\n", phase, ops,
+           st->transfers, st->frames, st->wire_bytes, st->payload_bytes,
+           ops ? (double) st->transfers / (double) ops : 0.0);
+    ndp10x_sim_clear_stats(sim);
+}
+
+/* plan replay from memory */
+struct bench_plan_s {
+    const uint8_t *plan;
+    uint32_t size;
+};
+
+static unsigned int
+bench_plan_read(void *ctx, uint32_t offset, void *buf, unsigned int count)
+{
+    struct bench_plan_s *bp = (struct bench_plan_s *) ctx;
+
+    if (bp->size < offset || bp->size - offset < count) {
+        return 0;
+    }
+    memcpy(buf, bp->plan + offset, count);
+    return count;
+}
+
+/* steps go through the uILib as a one tag log, as the firmware does */
+static int
+bench_plan_step(void *d, uint32_t op)
+{
+    uint32_t tlv[2];
+    int s;
+
+    tlv[0] = op;
+    tlv[1] = 0;
+    s = syntiant_ndp10x_micro_load_log
+        ((struct syntiant_ndp10x_micro_device_s *) d, tlv, sizeof(tlv));
+    return s == SYNTIANT_NDP_ERROR_MORE ? SYNTIANT_NDP_ERROR_NONE : s;
+}
+
+static int
+bench_plan_transfer(void *d, int mcu, uint32_t addr, void *out, void *in,
+                    unsigned int count)
+{
+    struct syntiant_ndp10x_micro_device_s *ndp =
+        (struct syntiant_ndp10x_micro_device_s *) d;
+
+    return ndp->transfer(ndp->d, mcu, addr, out, in, count);
+}
+
+static int
+bench_boot_log(struct syntiant_ndp10x_micro_device_s *ndp, uint8_t *log,
+               unsigned int log_len, unsigned int chunk, unsigned long *ops)
+{
+    unsigned int off, n;
+    int s;
+
+    s = syntiant_ndp10x_micro_load_log(ndp, NULL, 0);
+    for (off = 0, *ops = 0; s == SYNTIANT_NDP_ERROR_MORE && off < log_len;
+         off += n, (*ops)++) {
+        n = log_len - off < chunk ? log_len - off : chunk;
+        s = syntiant_ndp10x_micro_load_log(ndp, log + off, (int) n);
+    }
+    return s;
+}
+
+static int
+bench_boot_plan(struct syntiant_ndp10x_micro_device_s *ndp,
+                struct bench_plan_s *bp, uint8_t *stage,
+                unsigned int stage_size, uint32_t log_len, uint32_t checksum)
+{
+    struct ndp_plan_io_s io;
+
+    io.ctx = bp;
+    io.read = bench_plan_read;
+    io.d = ndp;
+    io.transfer = bench_plan_transfer;
+    io.step = bench_plan_step;
+    io.buf = stage;
+    io.bufSize = stage_size;
+    syntiant_ndp10x_micro_load_log(ndp, NULL, 0);
+    return ndpPlanReplay(&io, log_len, checksum);
+}
+
+/* register file and every MCU page the same */
+static int
+bench_same_state(struct ndp10x_sim_s *a, struct ndp10x_sim_s *b)
+{
+    unsigned int i, j;
+
+    if (memcmp(a->spi, b->spi, sizeof(a->spi)) || a->npages != b->npages) {
+        return 0;
+    }
+    for (i = 0; i < a->npages; i++) {
+        for (j = 0; j < b->npages; j++) {
+            if (a->pages[i]->base == b->pages[j]->base) {
+                break;
+            }
+        }
+        if (j == b->npages
+            || memcmp(a->pages[i]->data, b->pages[j]->data,
+                      NDP10X_SIM_PAGE_SIZE)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * flash: the model stored on the master SPI flash, in the plain layout or
+ * the "flash bug" one with 3 data bytes in the high bytes of each word
+ */
+static uint8_t *
+bench_flash_image(const uint8_t *log, unsigned int log_len, int packed,
+                  unsigned int *lenp)
+{
+    unsigned int step = packed ? 3 : 4;
+    unsigned int words = (log_len + step - 1) / step;
+    uint8_t *image = (uint8_t *) malloc(4 * words);
+    unsigned int i, k;
+
+    if (!image) {
+        return NULL;
+    }
+    memset(image, 0xff, 4 * words);
+    for (i = 0; i < log_len; i++) {
+        k = packed ? i / 3 * 4 + 1 + i % 3 : i;
+        image[k] = log[i];
+    }
+    *lenp = 4 * words;
+    return image;
+}
+
+/* SPICTL shadowed the way NDP_SPI.cpp does it */
+struct bench_mspi_s {
+    struct syntiant_ndp10x_micro_device_s *ndp;
+    uint32_t ctl;
+    int valid;
+    unsigned long transfers;
+};
+
+static uint32_t
+bench_mspi_read(struct bench_mspi_s *m, uint32_t addr)
+{
+    uint32_t v;
+
+    m->transfers++;
+    m->ndp->transfer(m->ndp->d, 1, addr, NULL, &v, sizeof(v));
+    return v;
+}
+
+static void
+bench_mspi_write(struct bench_mspi_s *m, uint32_t addr, uint32_t v)
+{
+    m->transfers++;
+    m->ndp->transfer(m->ndp->d, 1, addr, &v, NULL, sizeof(v));
+}
+
+static void
+bench_mspi_ctl(struct bench_mspi_s *m, uint32_t clear, uint32_t set)
+{
+    if (!m->valid) {
+        m->ctl = bench_mspi_read(m, NDP_FLASH_SPICTL);
+        m->valid = 1;
+    }
+    m->ctl = (m->ctl & ~clear) | set;
+    bench_mspi_write(m, NDP_FLASH_SPICTL, m->ctl);
+}
+
+static void
+bench_mspi_wait(struct bench_mspi_s *m)
+{
+    do {
+        m->ctl = bench_mspi_read(m, NDP_FLASH_SPICTL);
+    } while (!(m->ctl & NDP_FLASH_SPICTL_DONE));
+    m->valid = 1;
+}
+
+/*
+ * the word at a time loop of the original loadUilibFlash: the read
+ * command is issued again for every ilibBuf block and the last block is
+ * padded with 0xff
+ */
+static int
+bench_flash_words(struct syntiant_ndp10x_micro_device_s *ndp,
+                  unsigned int flash_len, int packed, unsigned long *reader)
+{
+    struct bench_mspi_s m;
+    uint8_t block[BENCH_FLASH_BLOCK];
+    unsigned int i, n = 0;
+    uint32_t v;
+    int s = SYNTIANT_NDP_ERROR_MORE;
+
+    memset(&m, 0, sizeof(m));
+    m.ndp = ndp;
+    bench_mspi_ctl(&m, NDP_FLASH_SPICTL_MODE, NDP_FLASH_SPICTL_ENABLE);
+    for (i = 0; i < flash_len; i += 4) {
+        if (!n) {
+            bench_mspi_ctl(&m, NDP_FLASH_SPICTL_MODE, NDP_FLASH_MODE_IDLE);
+            bench_mspi_ctl(&m, NDP_FLASH_SPICTL_MODE, NDP_FLASH_MODE_ENABLE);
+            bench_mspi_write(&m, NDP_FLASH_SPITX, NDP_FLASH_READ + i);
+            bench_mspi_ctl(&m, NDP_FLASH_SPICTL_NUMBYTES,
+                           NDP_FLASH_SPICTL_NUMBYTES);
+            bench_mspi_ctl(&m, NDP_FLASH_SPICTL_MODE, NDP_FLASH_MODE_TRANSFER);
+            bench_mspi_ctl(&m, NDP_FLASH_SPICTL_MODE, NDP_FLASH_MODE_TRANSFER);
+            bench_mspi_wait(&m);
+        }
+        bench_mspi_ctl(&m, NDP_FLASH_SPICTL_MODE, NDP_FLASH_MODE_UPDATE);
+        bench_mspi_ctl(&m, NDP_FLASH_SPICTL_MODE, NDP_FLASH_MODE_TRANSFER);
+        v = bench_mspi_read(&m, NDP_FLASH_SPIRX);
+        if (!packed) {
+            block[n++] = (uint8_t) v;
+        }
+        block[n++] = (uint8_t) (v >> 8);
+        block[n++] = (uint8_t) (v >> 16);
+        block[n++] = (uint8_t) (v >> 24);
+        if (n == sizeof(block)) {
+            n = 0;
+            s = syntiant_ndp10x_micro_load_log(ndp, block, sizeof(block));
+            m.valid = 0;
+            bench_mspi_ctl(&m, NDP_FLASH_SPICTL_MODE,
+                           NDP_FLASH_SPICTL_ENABLE);
+        }
+    }
+    memset(block + n, 0xff, sizeof(block) - n);
+    s = syntiant_ndp10x_micro_load_log(ndp, block, sizeof(block));
+    *reader = m.transfers;
+    return s;
+}
+
+/* the streaming reader loadUilibFlash uses now */
+static int
+bench_flash_stream(struct syntiant_ndp10x_micro_device_s *ndp,
+                   unsigned int flash_len, int packed, unsigned long *reader)
+{
+    struct ndp_flash_s f;
+    uint8_t block[BENCH_FLASH_BLOCK];
+    unsigned int step = packed ? 3 : 4;
+    unsigned int words = flash_len / 4;
+    unsigned int n;
+    int s;
+
+    memset(&f, 0, sizeof(f));
+    f.d = ndp->d;
+    f.transfer = ndp->transfer;
+    f.packed = packed;
+    s = ndpFlashOpen(&f, 0);
+    while (!s && words) {
+        n = words < sizeof(block) / step ? words : sizeof(block) / step;
+        s = ndpFlashRead(&f, block, n * step);
+        if (s) {
+            break;
+        }
+        words -= n;
+        /* the uILib takes whole words, pad as the flash is padded */
+        for (n *= step; n & 0x3; n++) {
+            block[n] = 0xff;
+        }
+        s = syntiant_ndp10x_micro_load_log(ndp, block, (int) n);
+        if (s != SYNTIANT_NDP_ERROR_MORE || !words) {
+            break;
+        }
+        s = ndpFlashResume(&f);
+    }
+    if (!s) {
+        s = ndpFlashClose(&f);
+    }
+    *reader = f.transfers;
+    return s;
+}
+
+static double
+bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/* bus time of the counted traffic, with the driver's pause before reads */
+static double
+bench_bus_us(const struct ndp10x_sim_stats_s *st)
+{
+    return (double) st->wire_bytes * 8.0 / BENCH_SPI_MHZ
+        + (double) st->mcu_reads * BENCH_MCU_READ_US;
+}
+
+/* word loop [0] against stream [1] */
+struct bench_flash_s {
+    unsigned long reader[2]; /* transfers issued by the reader itself */
+    double us[2];            /* bus time of the whole boot */
+    int ok;
+};
+
+/*
+ * boot fresh devices from the log stored on flash with both readers and
+ * check they end as ref; the stream boot's traffic is added to total
+ */
+static void
+bench_flash(struct syntiant_ndp10x_micro_device_s *proto,
+            struct ndp10x_sim_s *ref, struct ndp10x_sim_s *total,
+            const uint8_t *log, unsigned int log_len, int packed,
+            struct bench_flash_s *r)
+{
+    struct syntiant_ndp10x_micro_device_s ndp;
+    struct ndp10x_sim_s sim;
+    struct ndp10x_sim_stats_s *st = &total->stats;
+    uint8_t *image;
+    unsigned int len;
+    uint32_t k;
+    int i, s;
+
+    r->ok = 0;
+    image = bench_flash_image(log, log_len, packed, &len);
+    if (!image) {
+        return;
+    }
+    r->ok = 1;
+    for (i = 0; i < 2; i++) {
+        ndp10x_sim_init(&sim);
+        ndp10x_sim_flash(&sim, image, len);
+        ndp = *proto;
+        ndp.d = &sim;
+        syntiant_ndp10x_micro_load_log(&ndp, NULL, 0);
+        s = i ? bench_flash_stream(&ndp, len, packed, &r->reader[i])
+            : bench_flash_words(&ndp, len, packed, &r->reader[i]);
+        /* the reference never touched the master SPI registers */
+        for (k = NDP_FLASH_SPICTL; k <= NDP_FLASH_SPIRX; k += 4) {
+            ndp10x_sim_write(ref, k, ndp10x_sim_read(&sim, k));
+        }
+        r->ok &= !s && bench_same_state(ref, &sim);
+        r->us[i] = bench_bus_us(&sim.stats);
+        if (i) {
+            st->transfers += sim.stats.transfers;
+            st->frames += sim.stats.frames;
+            st->wire_bytes += sim.stats.wire_bytes;
+            st->payload_bytes += sim.stats.payload_bytes;
+        }
+        ndp10x_sim_free(&sim);
+    }
+    free(image);
+}
+
+/* the CRC-32 the plan code used before the table */
+static uint32_t
+bench_crc_bits(uint32_t crc, const void *data, unsigned int count)
+{
+    const uint8_t *p = (const uint8_t *) data;
+    int i;
+
+    crc = ~crc;
+    while (count--) {
+        crc ^= *p++;
+        for (i = 0; i < 8; i++) {
+            crc = (crc >> 1) ^ (0xedb88320U & (0U - (crc & 1U)));
+        }
+    }
+    return ~crc;
+}
+
+static uint32_t
+bench_crc_bytes(uint32_t crc, const void *data, unsigned int count)
+{
+    const uint8_t *p = (const uint8_t *) data;
+
+    crc = ~crc;
+    while (count--) {
+        crc = ndpCrc32Table[(crc ^ *p++) & 0xffU] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+/* host time [0..2] of each loop, and whether they all agree */
+struct bench_crc_s {
+    double ns_per_kb[3];
+    int ok;
+};
+
+/*
+ * CRC the log the way the loader does, in chunk pieces, with each loop;
+ * the word loop also from an odd address and against the check value
+ */
+static void
+bench_crc(const uint8_t *log, unsigned int log_len, unsigned int chunk,
+          unsigned int rounds, struct bench_crc_s *r)
+{
+    static uint32_t (*const crc_fn[3])(uint32_t, const void *,
+                                       unsigned int) = {
+        bench_crc_bits, bench_crc_bytes, ndpCrc32};
+    uint32_t crc[3];
+    uint8_t *odd;
+    unsigned int i, j, off, n;
+    double t;
+
+    for (i = 0; i < 3; i++) {
+        t = bench_now();
+        for (j = 0; j < rounds; j++) {
+            crc[i] = 0;
+            for (off = 0; off < log_len; off += n) {
+                n = log_len - off < chunk ? log_len - off : chunk;
+                crc[i] = crc_fn[i](crc[i], log + off, n);
+            }
+        }
+        t = bench_now() - t;
+        r->ns_per_kb[i] = rounds ? t * 1e9 / rounds / (log_len / 1024.0)
+            : 0.0;
+    }
+    r->ok = rounds && crc[0] == crc[1] && crc[1] == crc[2]
+        && ndpCrc32(0, "123456789", 9) == 0xcbf43926U;
+
+    odd = (uint8_t *) malloc(log_len + 1);
+    if (!odd) {
+        r->ok = 0;
+        return;
+    }
+    memcpy(odd + 1, log, log_len);
+    r->ok &= ndpCrc32(0, odd + 1, log_len) == crc[0];
+    free(odd);
+}
+
+/* compressed package of a log [0], and of the sparse synthetic log [1] */
+struct bench_lz_s {
+    unsigned int log_len;
+    uint32_t size;
+    unsigned int decodes; /* timed, rounds at least */
+    double mb_per_s;      /* host decode rate */
+    int ok;
+};
+
+struct bench_lz_src_s {
+    const uint8_t *pkg;
+    uint32_t size;
+    uint32_t off;
+};
+
+static unsigned int
+bench_lz_read(void *ctx, void *buf, unsigned int count)
+{
+    struct bench_lz_src_s *src = (struct bench_lz_src_s *) ctx;
+
+    if (src->size - src->off < count) {
+        count = src->size - src->off;
+    }
+    memcpy(buf, src->pkg + src->off, count);
+    src->off += count;
+    return count;
+}
+
+/* decode a package block by block, into the uILib when ndp is set */
+static int
+bench_lz_decode(struct syntiant_ndp10x_micro_device_s *ndp,
+                const uint8_t *pkg, uint32_t size, uint8_t *stage,
+                uint8_t *out)
+{
+    struct ndp_lz_reader_s r;
+    struct bench_lz_src_s src;
+    unsigned int n;
+    int s = SYNTIANT_NDP_ERROR_MORE;
+
+    src.pkg = pkg;
+    src.size = size;
+    src.off = sizeof(r.header);
+    r.ctx = &src;
+    r.read = bench_lz_read;
+    r.stage = stage;
+    r.stageSize = NDP_LZ_BLOCK_MAX;
+    if (size < sizeof(r.header) || !ndpLzOpen(&r, pkg)) {
+        return SYNTIANT_NDP_ERROR_PACKAGE;
+    }
+    if (ndp) {
+        s = syntiant_ndp10x_micro_load_log(ndp, NULL, 0);
+    }
+    while (s == SYNTIANT_NDP_ERROR_MORE
+           && (n = ndpLzRead(&r, out, NDP_LZ_BLOCK_MAX))) {
+        if (ndp) {
+            s = syntiant_ndp10x_micro_load_log(ndp, out, (int) n);
+        }
+    }
+    if (r.error) {
+        return SYNTIANT_NDP_ERROR_PACKAGE;
+    }
+    return ndp ? s : SYNTIANT_NDP_ERROR_NONE;
+}
+
+/*
+ * pack the log, time decoding it, then boot fresh devices from the log and
+ * from the package and check they end the same
+ */
+static void
+bench_lz(struct syntiant_ndp10x_micro_device_s *proto, const uint8_t *log,
+         unsigned int log_len, unsigned int rounds, struct bench_lz_s *r)
+{
+    struct syntiant_ndp10x_micro_device_s ndp_log, ndp_lz;
+    struct ndp10x_sim_s sim_log, sim_lz;
+    uint8_t stage[NDP_LZ_BLOCK_MAX], out[NDP_LZ_BLOCK_MAX];
+    uint8_t *pkg;
+    unsigned long ops;
+    unsigned int i;
+    double t0, t;
+    int s;
+
+    r->log_len = log_len;
+    r->ok = 0;
+    pkg = (uint8_t *) malloc(ndpLzMaxBytes(log_len, NDP_LZ_BLOCK_MAX));
+    r->size = pkg ? ndpLzPack(log, log_len, NDP_LZ_BLOCK_MAX, pkg) : 0;
+    if (!r->size) {
+        free(pkg);
+        return;
+    }
+
+    t0 = bench_now();
+    t = 0.0;
+    for (i = 0, s = 0; !s && (i < rounds || t < BENCH_LZ_MIN_S); i++) {
+        s = bench_lz_decode(NULL, pkg, r->size, stage, out);
+        t = bench_now() - t0;
+    }
+    r->decodes = i;
+    r->mb_per_s = t > 0 ? (double) log_len * i / t / 1e6 : 0.0;
+
+    ndp10x_sim_init(&sim_log);
+    ndp_log = *proto;
+    ndp_log.d = &sim_log;
+    ndp10x_sim_init(&sim_lz);
+    ndp_lz = *proto;
+    ndp_lz.d = &sim_lz;
+    r->ok = !s
+        && !bench_boot_log(&ndp_log, (uint8_t *) log, log_len,
+                           NDP_LZ_BLOCK_MAX, &ops)
+        && !bench_lz_decode(&ndp_lz, pkg, r->size, stage, out)
+        && bench_same_state(&sim_log, &sim_lz);
+    ndp10x_sim_free(&sim_log);
+    ndp10x_sim_free(&sim_lz);
+    free(pkg);
+}
+
+/* one direction of the loopback link */
+/* the blind 32 byte reader [0], the streamer polled every 1 [1] and 4 ms [2] */
+struct bench_tank_s {
+    double transfers[3]; /* a tick */
+    double us[3];        /* bus time a tick */
+    unsigned long bytes, bad, underruns, dropped;
+};
+
+static void
+bench_tank(unsigned int seconds, struct bench_tank_s *r)
+{
+    static const unsigned int every[3] = {1, 1, BENCH_TANK_POLL};
+    struct ndp10x_sim_s sim;
+    struct ndp_tank_s t;
+    struct ndp_tank_reader_s rd;
+    uint8_t ring[BENCH_TANK_RING], frame[BENCH_TANK_FRAME], out[32];
+    uint32_t cur, start, first;
+    unsigned long ms, ticks = seconds * 1000UL;
+    uint8_t pattern, expect;
+    unsigned int i, k;
+
+    memset(r, 0, sizeof(*r));
+    for (i = 0; i < 3; i++) {
+        ndp10x_sim_init(&sim);
+        memset(&t, 0, sizeof(t));
+        t.d = &sim;
+        t.transfer = ndp10x_sim_transfer;
+        t.ring = ring;
+        t.ringSize = sizeof(ring);
+        if (i) {
+            ndpTankOpen(&t);
+            ndpTankReaderStart(&t, &rd);
+        }
+        ndp10x_sim_clear_stats(&sim);
+        cur = 0;
+        pattern = expect = 0;
+        for (ms = 0; ms < ticks; ms++) {
+            if (ms % BENCH_TANK_FRAME_MS == 0) {
+                for (k = 0; k < sizeof(frame); k++) {
+                    frame[k] = pattern++;
+                }
+                ndp10x_sim_audio(&sim, frame, sizeof(frame));
+            }
+            if (!i) {
+                /* the 32 bytes before a pointer the ISR advanced itself */
+                start = (cur + NDP10X_SIM_TANK_SIZE - 32) % NDP10X_SIM_TANK_SIZE;
+                first = NDP10X_SIM_TANK_SIZE - start < 32
+                    ? NDP10X_SIM_TANK_SIZE - start : 32;
+                ndp10x_sim_transfer(&sim, 1, NDP10X_SIM_TANK_ADDR + start,
+                                    NULL, out, first);
+                if (first < 32) {
+                    ndp10x_sim_transfer(&sim, 1, NDP10X_SIM_TANK_ADDR, NULL,
+                                        out + first, 32 - first);
+                }
+                cur = (cur + 32) % NDP10X_SIM_TANK_SIZE;
+                continue;
+            }
+            if (ms % every[i] == 0) {
+                ndpTankPoll(&t, sizeof(ring) / 2);
+            }
+            if (ndpTankReadPaced(&t, &rd, out, sizeof(out),
+                                 BENCH_TANK_PREFILL)) {
+                for (k = 0; k < sizeof(out); k++) {
+                    r->bad += out[k] != expect++;
+                }
+                r->bytes += sizeof(out);
+            }
+        }
+        r->transfers[i] = (double) sim.stats.transfers / ticks;
+        r->us[i] = bench_bus_us(&sim.stats) / ticks;
+        if (i) {
+            r->underruns += rd.underruns;
+            r->dropped += rd.dropped + t.skipped;
+        }
+        ndp10x_sim_free(&sim);
+    }
+}
+
+/* one get_match an NDP interrupt as NDP.poll does [0], drained [1] */
+struct bench_events_s {
+    unsigned long posted;
+    unsigned long seen[2];
+    double transfers[2];  /* an interrupt */
+    unsigned long late;   /* reported after the interrupt raised for it */
+    unsigned long wrong;  /* class, summary, tank pointer, time or order
+                             differ */
+    unsigned long lost;   /* the queue was full */
+    unsigned int deepest; /* queued events the main loop found */
+};
+
+static int
+bench_events(unsigned int interrupts, struct bench_events_s *r)
+{
+    struct syntiant_ndp10x_micro_device_s ndp;
+    struct ndp10x_sim_s sim;
+    struct ndp_events_s q;
+    struct ndp_event_s e;
+    uint8_t audio[BENCH_EVENTS_AUDIO];
+    unsigned long most = (unsigned long) interrupts * BENCH_EVENTS_BURST;
+    uint32_t *tankptr, *when;
+    unsigned long next, k;
+    unsigned int i, n, burst, seed;
+    uint32_t causes;
+    int s = 0, match;
+
+    memset(r, 0, sizeof(*r));
+    memset(audio, 0, sizeof(audio));
+    tankptr = (uint32_t *) malloc(most * sizeof(*tankptr));
+    when = (uint32_t *) malloc(most * sizeof(*when));
+    if (!tankptr || !when) {
+        free(tankptr);
+        free(when);
+        return SYNTIANT_NDP_ERROR_NOMEM;
+    }
+
+    for (i = 0; !s && i < 2; i++) {
+        ndp10x_sim_init(&sim);
+        memset(&ndp, 0, sizeof(ndp));
+        ndp.d = &sim;
+        ndp.transfer = ndp10x_sim_transfer;
+        ndpEventsInit(&q);
+        ndp10x_sim_clear_stats(&sim);
+        seed = 1;
+        r->posted = next = 0;
+        for (n = 0; !s && n < interrupts; n++) {
+            seed = seed * 1103515245U + 12345U;
+            burst = 1 + (seed >> 16) % BENCH_EVENTS_BURST;
+            while (burst--) {
+                /* the audio between matches moves the tank pointer */
+                ndp10x_sim_audio(&sim, audio, sizeof(audio));
+                tankptr[r->posted] = sim.tankptr;
+                when[r->posted] = n;
+                ndp10x_sim_match(&sim, (int) (r->posted % 64));
+                r->posted++;
+            }
+
+            if (!i) {
+                s = syntiant_ndp10x_micro_poll(&ndp, &causes, 1);
+                if (s || !(causes & SYNTIANT_NDP10X_MICRO_NOTIFICATION_MATCH)) {
+                    continue;
+                }
+                s = syntiant_ndp10x_micro_get_match(&ndp, &match);
+                if (s || match < 0) {
+                    continue;
+                }
+                r->seen[0]++;
+                /* the ring keeps only the last few */
+                for (k = r->posted;
+                     k && r->posted - k < NDP10X_SIM_MATCH_RING_SIZE; k--) {
+                    if (tankptr[k - 1] == ndp.tankptr_match) {
+                        r->late += when[k - 1] != n;
+                        break;
+                    }
+                }
+                continue;
+            }
+
+            s = ndpEventsDrain(&q, &ndp, n);
+            if (n % BENCH_EVENTS_MAIN != BENCH_EVENTS_MAIN - 1
+                && n != interrupts - 1) {
+                continue;
+            }
+            if (ndpEventsPending(&q) > r->deepest) {
+                r->deepest = ndpEventsPending(&q);
+            }
+            while (ndpEventsGet(&q, &e)) {
+                r->wrong += next >= r->posted
+                    || e.winner != (int) (next % 64)
+                    || e.summary != (BENCH_EVENTS_SUMMARY_MATCH | next % 64)
+                    || e.tankPtr != tankptr[next] || e.micros != when[next];
+                next++;
+                r->seen[1]++;
+            }
+        }
+        r->transfers[i] = (double) sim.stats.transfers / interrupts;
+        if (i) {
+            r->lost = q.lost;
+        }
+        ndp10x_sim_free(&sim);
+    }
+    free(tankptr);
+    free(when);
+    return s;
+}
+
+/*
+ * Mock DMA backend of the transfer queue: start only records the
+ * transfer, the payload moves when the completion interrupt runs, which
+ * the bench raises from wait or between its own steps. A posted write
+ * whose buffer is reused too early so reaches the device changed.
+ */
+struct bench_dma_s {
+    struct ndp10x_sim_s *sim;
+    struct ndp_async_s q;
+    int mcu;
+    uint32_t address;
+    const uint8_t *out;
+    uint8_t *in;
+    unsigned int count;
+    unsigned long fail;  /* transfer number to fail, 0 for none */
+    unsigned long bytes; /* payload moved by the mock */
+    unsigned long waits; /* calls to wait with a transfer in flight */
+};
+
+static void
+bench_dma_start(void *d, int mcu, uint32_t address, const uint8_t *out,
+                uint8_t *in, unsigned int count)
+{
+    struct bench_dma_s *m = (struct bench_dma_s *) d;
+
+    m->mcu = mcu;
+    m->address = address;
+    m->out = out;
+    m->in = in;
+    m->count = count;
+}
+
+/* the completion interrupt */
+static void
+bench_dma_irq(struct bench_dma_s *m)
+{
+    int s;
+
+    if (!ndpAsyncBusy(&m->q)) {
+        return;
+    }
+    s = ndp10x_sim_transfer(m->sim, m->mcu, m->address, (void *) m->out,
+                            m->in, m->count);
+    m->bytes += m->count;
+    ndpAsyncComplete(&m->q, !s && m->q.started != m->fail);
+}
+
+static void
+bench_dma_wait(void *d)
+{
+    struct bench_dma_s *m = (struct bench_dma_s *) d;
+
+    m->waits++;
+    bench_dma_irq(m);
+}
+
+static void
+bench_dma_init(struct bench_dma_s *m, struct ndp10x_sim_s *sim)
+{
+    struct ndp_async_backend_s backend;
+
+    memset(m, 0, sizeof(*m));
+    m->sim = sim;
+    backend.d = m;
+    backend.start = bench_dma_start;
+    backend.wait = bench_dma_wait;
+    ndpAsyncInit(&m->q, &backend);
+}
+
+/* NDPClass::spiTransfer: short payloads are clocked by the CPU */
+static int
+bench_dma_transfer(void *d, int mcu, uint32_t addr, void *out, void *in,
+                   unsigned int count)
+{
+    struct bench_dma_s *m = (struct bench_dma_s *) d;
+
+    if (BENCH_DMA_MIN_COUNT <= count) {
+        return ndpAsyncTransfer(&m->q, mcu, addr, (const uint8_t *) out,
+                                (uint8_t *) in, count);
+    }
+    ndpAsyncFlush(&m->q);
+    return ndp10x_sim_transfer(m->sim, mcu, addr, out, in, count);
+}
+
+static void
+bench_dma_done(void *arg, int s)
+{
+    int *calls = (int *) arg;
+
+    *calls += s == SYNTIANT_NDP_ERROR_NONE ? 1 : 100;
+}
+
+struct bench_dma_result_s {
+    unsigned long transfers; /* through the queue */
+    unsigned long posted;    /* returned with the payload in flight */
+    unsigned long bytes;
+    unsigned long reuses;    /* block reuses that had to wait */
+    int same;                /* booted the same state as a direct boot */
+    int checks;              /* queue checks passed */
+};
+
+#define BENCH_DMA_CHECKS 6
+
+/*
+ * Boot the log through the queue with posted writes, the way
+ * loadLogPipelined feeds it, and compare with a direct boot; then check
+ * the queue's argument, busy, callback and error reporting.
+ */
+static int
+bench_dma(const uint8_t *log, unsigned int log_len,
+          struct bench_dma_result_s *r)
+{
+    struct syntiant_ndp10x_micro_device_s ndp;
+    struct ndp10x_sim_s sim, ref;
+    struct bench_dma_s m;
+    uint8_t *block[2];
+    uint8_t word[BENCH_DMA_MIN_COUNT];
+    unsigned int off, n, i;
+    unsigned long ops;
+    int s, s0, calls;
+
+    memset(r, 0, sizeof(*r));
+    block[0] = (uint8_t *) malloc(2 * BENCH_DMA_BLOCK);
+    if (!block[0]) {
+        return SYNTIANT_NDP_ERROR_NOMEM;
+    }
+    block[1] = block[0] + BENCH_DMA_BLOCK;
+
+    ndp10x_sim_init(&sim);
+    bench_dma_init(&m, &sim);
+    memset(&ndp, 0, sizeof(ndp));
+    ndp.d = &m;
+    ndp.transfer = bench_dma_transfer;
+
+    ndpAsyncPost(&m.q, 1);
+    s = syntiant_ndp10x_micro_load_log(&ndp, NULL, 0);
+    for (off = 0, i = 0; s == SYNTIANT_NDP_ERROR_MORE && off < log_len;
+         off += n, i = !i) {
+        if (ndpAsyncPending(&m.q, block[i], BENCH_DMA_BLOCK)) {
+            r->reuses++;
+            ndpAsyncWait(&m.q);
+        }
+        n = log_len - off < BENCH_DMA_BLOCK ? log_len - off : BENCH_DMA_BLOCK;
+        memcpy(block[i], log + off, n);
+        s = syntiant_ndp10x_micro_load_log(&ndp, block[i], (int) n);
+        r->posted += ndpAsyncBusy(&m.q);
+    }
+    s0 = ndpAsyncPost(&m.q, 0);
+    s = s0 ? s0 : s;
+    r->transfers = m.q.started;
+    r->bytes = m.bytes;
+
+    ndp10x_sim_init(&ref);
+    memset(&ndp, 0, sizeof(ndp));
+    ndp.d = &ref;
+    ndp.transfer = ndp10x_sim_transfer;
+    s = s ? s : bench_boot_log(&ndp, (uint8_t *) log, log_len,
+                               BENCH_DMA_BLOCK, &ops);
+    r->same = !s && bench_same_state(&ref, &sim);
+    ndp10x_sim_free(&ref);
+
+    /* argument checks, and BUSY while a transfer is in flight */
+    memset(word, 0, sizeof(word));
+    r->checks += ndpAsyncStart(&m.q, 0, 0, word, word, 4, NULL, NULL)
+        == SYNTIANT_NDP_ERROR_ARG;
+    r->checks += ndpAsyncStart(&m.q, 1, BENCH_BRIDGE_ADDR, word, NULL, 6,
+                               NULL, NULL) == SYNTIANT_NDP_ERROR_ARG
+        && ndpAsyncStart(&m.q, 1, BENCH_BRIDGE_ADDR, word, NULL, 0, NULL,
+                         NULL) == SYNTIANT_NDP_ERROR_ARG;
+    calls = 0;
+    s = ndpAsyncStart(&m.q, 1, BENCH_BRIDGE_ADDR, word, NULL, sizeof(word),
+                      bench_dma_done, &calls);
+    r->checks += !s && ndpAsyncBusy(&m.q)
+        && ndpAsyncStart(&m.q, 1, BENCH_BRIDGE_ADDR, NULL, word,
+                         sizeof(word), NULL, NULL) == SYNTIANT_NDP_ERROR_BUSY;
+
+    /* the callback runs once, from the interrupt, not from wait */
+    bench_dma_irq(&m);
+    bench_dma_irq(&m);
+    r->checks += calls == 1 && ndpAsyncWait(&m.q) == SYNTIANT_NDP_ERROR_NONE
+        && calls == 1;
+
+    /*
+     * a failed posted write is not reported to the next transfer, which
+     * may be another context's, but by disabling posting, once
+     */
+    ndpAsyncPost(&m.q, 1);
+    m.fail = m.q.started + 1;
+    s = bench_dma_transfer(&m, 1, BENCH_BRIDGE_ADDR, word, NULL,
+                           sizeof(word));
+    r->checks += !s
+        && bench_dma_transfer(&m, 1, BENCH_BRIDGE_ADDR, NULL, word,
+                              4) == SYNTIANT_NDP_ERROR_NONE
+        && bench_dma_transfer(&m, 1, BENCH_BRIDGE_ADDR, NULL, word,
+                              sizeof(word)) == SYNTIANT_NDP_ERROR_NONE
+        && ndpAsyncPost(&m.q, 0) == SYNTIANT_NDP_ERROR_FAIL
+        && ndpAsyncPost(&m.q, 0) == SYNTIANT_NDP_ERROR_NONE;
+
+    /* and when nothing else followed it */
+    ndpAsyncPost(&m.q, 1);
+    m.fail = m.q.started + 1;
+    s = bench_dma_transfer(&m, 1, BENCH_BRIDGE_ADDR, word, NULL,
+                           sizeof(word));
+    r->checks += !s && ndpAsyncPending(&m.q, word + 4, 4)
+        && !ndpAsyncPending(&m.q, word + sizeof(word), 4)
+        && ndpAsyncPost(&m.q, 0) == SYNTIANT_NDP_ERROR_FAIL
+        && ndpAsyncPost(&m.q, 0) == SYNTIANT_NDP_ERROR_NONE;
+
+    ndp10x_sim_free(&sim);
+    free(block[0]);
+    return SYNTIANT_NDP_ERROR_NONE;
+}
+
+/*
+ * list: transactions of the scatter-gather reads and writes against one
+ * word a transaction, for consecutive words, every other word, every
+ * sixth word (holes too big to read through) and scattered registers
+ */
+struct bench_list_s {
+    unsigned int words[BENCH_LIST_PATTERNS];
+    unsigned int read[BENCH_LIST_PATTERNS];  /* list read transactions */
+    unsigned int write[BENCH_LIST_PATTERNS]; /* list write transactions */
+    unsigned long wire[2]; /* wire bytes of all reads, per word and listed */
+    unsigned long bad;     /* words read or written wrong */
+};
+
+static const char *bench_list_names[BENCH_LIST_PATTERNS] = {
+    "consecutive", "stride 2", "stride 6", "scattered"
+};
+
+static void
+bench_list(struct bench_list_s *r)
+{
+    static const unsigned int stride[BENCH_LIST_PATTERNS] = {1, 2, 6, 0};
+    struct ndp10x_sim_s sim;
+    uint32_t addresses[BENCH_LIST_WORDS];
+    uint32_t words[BENCH_LIST_WORDS], v;
+    unsigned int p, i, n;
+    unsigned long wire;
+
+    memset(r, 0, sizeof(*r));
+    ndp10x_sim_init(&sim);
+    for (p = 0; p < BENCH_LIST_PATTERNS; p++) {
+        n = stride[p] ? BENCH_LIST_WORDS : BENCH_LIST_WORDS / 8;
+        for (i = 0; i < n; i++) {
+            addresses[i] = BENCH_BRIDGE_ADDR + p * 0x40000U
+                + (stride[p] ? i * stride[p] * 4 : i * 0x1000U + i * 4);
+            ndp10x_sim_write(&sim, addresses[i], addresses[i] ^ 0x5a5a5a5aU);
+        }
+        r->words[p] = n;
+
+        ndp10x_sim_clear_stats(&sim);
+        for (i = 0; i < n; i++) {
+            ndp10x_sim_transfer(&sim, 1, addresses[i], NULL, &v, 4);
+        }
+        r->wire[0] += sim.stats.wire_bytes;
+
+        ndp10x_sim_clear_stats(&sim);
+        memset(words, 0, sizeof(words));
+        ndpReadList(ndp10x_sim_transfer, &sim, addresses, words, n,
+                    &r->read[p]);
+        wire = sim.stats.wire_bytes;
+        r->wire[1] += wire;
+        for (i = 0; i < n; i++) {
+            r->bad += words[i] != (addresses[i] ^ 0x5a5a5a5aU);
+            words[i] = ~words[i];
+        }
+
+        ndpWriteList(ndp10x_sim_transfer, &sim, addresses, words, n,
+                     &r->write[p]);
+        for (i = 0; i < n; i++) {
+            r->bad += ndp10x_sim_read(&sim, addresses[i]) != words[i];
+        }
+        /* holes left as they were */
+        if (stride[p] > 1) {
+            r->bad += ndp10x_sim_read(&sim, addresses[0] + 4) != 0;
+        }
+    }
+    ndp10x_sim_free(&sim);
+}
+
+struct bench_pipe_s {
+    uint8_t *buf;
+    unsigned int size;
+    unsigned int head;
+    unsigned int tail;
+};
+
+struct bench_link_s {
+    struct bench_pipe_s to_device;
+    struct bench_pipe_s to_host;
+};
+
+static int
+bench_pipe_init(struct bench_pipe_s *p, unsigned int size)
+{
+    p->buf = (uint8_t *) malloc(size);
+    p->size = size;
+    p->head = p->tail = 0;
+    return p->buf != NULL;
+}
+
+static void
+bench_pipe_put(struct bench_pipe_s *p, const void *data, unsigned int n)
+{
+    if (p->size < p->tail + n) {
+        memmove(p->buf, p->buf + p->head, p->tail - p->head);
+        p->tail -= p->head;
+        p->head = 0;
+    }
+    if (p->size < p->tail + n) {
+        fprintf(stderr, "loopback overflow\n");
+        exit(1);
+    }
+    memcpy(p->buf + p->tail, data, n);
+    p->tail += n;
+}
+
+static unsigned int
+bench_pipe_get(struct bench_pipe_s *p, void *data, unsigned int n)
+{
+    if (p->tail - p->head < n) {
+        n = p->tail - p->head;
+    }
+    memcpy(data, p->buf + p->head, n);
+    p->head += n;
+    return n;
+}
+
+static unsigned int
+bench_link_read(void *ctx, void *buf, unsigned int count)
+{
+    return bench_pipe_get(&((struct bench_link_s *) ctx)->to_device, buf,
+                          count);
+}
+
+static void
+bench_link_write(void *ctx, const void *buf, unsigned int count)
+{
+    bench_pipe_put(&((struct bench_link_s *) ctx)->to_host, buf, count);
+}
+
+static uint8_t *
+bench_le(uint8_t *p, uint32_t v, unsigned int size)
+{
+    while (size--) {
+        *p++ = (uint8_t) v;
+        v >>= 8;
+    }
+    return p;
+}
+
+/*
+ * host side: a request that writes ops/2 words and reads them back,
+ * optionally with a broken checksum
+ */
+static unsigned int
+bench_bridge_request(uint8_t *req, uint8_t seq, unsigned int ops,
+                     uint32_t salt, int corrupt)
+{
+    uint8_t *p = req + 4;
+    uint16_t crc;
+    unsigned int i;
+
+    for (i = 0; i < ops / 2; i++) {
+        *p++ = NDP_BRIDGE_INDIRECT_WRITE;
+        p = bench_le(p, BENCH_BRIDGE_ADDR + 4 * i, 4);
+        p = bench_le(p, 4, 2);
+        p = bench_le(p, salt ^ i, 4);
+    }
+    for (i = 0; i < ops / 2; i++) {
+        *p++ = NDP_BRIDGE_INDIRECT_READ;
+        p = bench_le(p, BENCH_BRIDGE_ADDR + 4 * i, 4);
+        p = bench_le(p, 4, 2);
+    }
+    req[0] = NDP_BRIDGE_SYNC;
+    req[1] = seq;
+    bench_le(req + 2, (uint32_t) (p - req - 4), 2);
+    crc = ndpBridgeCrc16(0xffff, req + 1, (unsigned int) (p - req - 1));
+    p = bench_le(p, corrupt ? crc ^ 1U : crc, 2);
+    return (unsigned int) (p - req);
+}
+
+/*
+ * host side: check the response to bench_bridge_request, returns the
+ * status or -1 if the response itself is malformed
+ */
+static int
+bench_bridge_response(struct bench_pipe_s *p, uint8_t seq, unsigned int ops,
+                      uint32_t salt)
+{
+    uint8_t hdr[6], tail[3], word[4];
+    uint16_t crc;
+    uint32_t len, i, v;
+    unsigned int bad = 0;
+
+    if (bench_pipe_get(p, hdr, 6) != 6 || hdr[0] != NDP_BRIDGE_SYNC
+        || hdr[1] != seq) {
+        return -1;
+    }
+    crc = ndpBridgeCrc16(0xffff, hdr + 1, 5);
+    len = (uint32_t) hdr[2] | (uint32_t) hdr[3] << 8
+        | (uint32_t) hdr[4] << 16 | (uint32_t) hdr[5] << 24;
+    for (i = 0; i < len / 4; i++) {
+        if (bench_pipe_get(p, word, 4) != 4) {
+            return -1;
+        }
+        crc = ndpBridgeCrc16(crc, word, 4);
+        v = (uint32_t) word[0] | (uint32_t) word[1] << 8
+            | (uint32_t) word[2] << 16 | (uint32_t) word[3] << 24;
+        bad += v != (salt ^ i);
+    }
+    if (bench_pipe_get(p, tail, 3) != 3) {
+        return -1;
+    }
+    crc = ndpBridgeCrc16(crc, tail, 1);
+    if (crc != (uint16_t) (tail[1] | tail[2] << 8)
+        || (!tail[0] && (len != 4 * (ops / 2) || bad))) {
+        return -1;
+    }
+    return tail[0];
+}
+
+static void
+usage(const char *name)
+{
+    fprintf(stderr, "usage: %s [-l log.bin] [-c chunk] [-n polls] "
+            "[-m every] [-x extract] [-s seconds] [-b frames] [-k ops] "
+            "[-r boots]\n", name);
+    exit(1);
+}
+
+int
+main(int argc, char **argv)
+{
+    struct syntiant_ndp10x_micro_device_s ndp;
+    struct ndp10x_sim_s sim;
+    const char *log_path = NULL;
+    unsigned int chunk = 1024;
+    unsigned int polls = 1000;
+    unsigned int every = 50;
+    unsigned int extract = 64;
+    unsigned int seconds = 2;
+    unsigned int frames = 10000;
+    unsigned int frame_ops = 16;
+    struct ndp_bridge_io_s io;
+    struct bench_link_s link;
+    uint8_t *req;
+    unsigned int req_len;
+    unsigned long rejects = 0, broken = 0;
+    double t, t_log = 0, t_plan = 0;
+    unsigned int boots = 20;
+    struct ndp10x_sim_s sim_log, sim_plan;
+    struct syntiant_ndp10x_micro_device_s ndp_log, ndp_plan;
+    struct bench_plan_s bp;
+    struct bench_flash_s flash[2];
+    struct bench_crc_s crc;
+    struct bench_lz_s lz[2];
+    struct bench_tank_s tank;
+    struct bench_events_s events;
+    struct bench_dma_result_s dma;
+    struct bench_list_s list;
+    uint8_t *sparse;
+    unsigned int sparse_len;
+    struct ndp_plan_header_s ph;
+    uint8_t *plan;
+    uint32_t checksum;
+    unsigned long plan_transfers = 0, log_transfers = 0;
+    int same = 1, corrupt;
+    uint8_t *log, *buf, *stage;
+    unsigned int log_len, len, i, k;
+    unsigned long posted = 0, seen = 0, bad = 0, ops;
+    uint32_t causes;
+    uint8_t pattern = 0, expect = 0;
+    int c, s, match;
+
+    while ((c = getopt(argc, argv, "l:c:n:m:x:s:b:k:r:")) != -1) {
+        switch (c) {
+        case 'l':
+            log_path = optarg;
+            break;
+        case 'c':
+            chunk = (unsigned int) strtoul(optarg, NULL, 0) & ~0x3U;
+            break;
+        case 'n':
+            polls = (unsigned int) strtoul(optarg, NULL, 0);
+            break;
+        case 'm':
+            every = (unsigned int) strtoul(optarg, NULL, 0);
+            break;
+        case 'x':
+            extract = (unsigned int) strtoul(optarg, NULL, 0) & ~0x3U;
+            break;
+        case 's':
+            seconds = (unsigned int) strtoul(optarg, NULL, 0);
+            break;
+        case 'b':
+            frames = (unsigned int) strtoul(optarg, NULL, 0);
+            break;
+        case 'k':
+            frame_ops = (unsigned int) strtoul(optarg, NULL, 0) & ~0x1U;
+            break;
+        case 'r':
+            boots = (unsigned int) strtoul(optarg, NULL, 0);
+            break;
+        default:
+            usage(argv[0]);
+        }
+    }
+    if (!chunk || !extract || !every || !frame_ops
+        || BENCH_BRIDGE_FRAME < frame_ops / 2 * 18) {
+        usage(argv[0]);
+    }
+
+    log = log_path ? bench_read_log(log_path, &log_len)
+        : bench_synthetic_log(&log_len, 0);
+    buf = (uint8_t *) malloc(extract);
+    stage = (uint8_t *) malloc(BENCH_BRIDGE_CHUNK);
+    if (!log || !buf || !stage) {
+        fprintf(stderr, "unable to set up log %s\n",
+                log_path ? log_path : "(synthetic)");
+        return 1;
+    }
+
+    ndp10x_sim_init(&sim);
+    memset(&ndp, 0, sizeof(ndp));
+    ndp.d = &sim;
+    ndp.transfer = ndp10x_sim_transfer;
+
+    printf("%-8s %8s %10s %10s %12s %12s %10s\n", "phase", "ops",
+           "transfers", "frames", "wire bytes", "payload", "xfer/op");
+
+    /* boot: feed the log in chunks the way loadModel does */
+    s = bench_boot_log(&ndp, log, log_len, chunk, &ops);
+    if (s) {
+        fprintf(stderr, "log load failed: %s\n", bench_error_name(s));
+        return 1;
+    }
+    bench_report("boot", &sim, ops);
+
+    /*
+     * plan: build the transfer plan of the validated log, then boot fresh
+     * devices from the log and from the plan and compare time and state
+     */
+    plan = (uint8_t *) malloc(ndpPlanMaxBytes(log_len));
+    bp.plan = plan;
+    bp.size = plan ? ndpPlanBuild(log, log_len, plan) : 0;
+    if (!bp.size || !ndpPlanLogChecksum(log + log_len - NDP_PLAN_LOG_TAIL,
+                                        &checksum)) {
+        fprintf(stderr, "unable to build a plan of the log\n");
+        return 1;
+    }
+    for (i = 0; i < boots; i++) {
+        ndp10x_sim_init(&sim_log);
+        ndp_log = ndp;
+        ndp_log.d = &sim_log;
+        t = bench_now();
+        s = bench_boot_log(&ndp_log, log, log_len, chunk, &ops);
+        t_log += bench_now() - t;
+
+        ndp10x_sim_init(&sim_plan);
+        ndp_plan = ndp;
+        ndp_plan.d = &sim_plan;
+        t = bench_now();
+        s = s ? s : bench_boot_plan(&ndp_plan, &bp, stage, BENCH_BRIDGE_CHUNK,
+                                    log_len, checksum);
+        t_plan += bench_now() - t;
+
+        log_transfers = sim_log.stats.transfers;
+        plan_transfers = sim_plan.stats.transfers;
+        same &= !s && bench_same_state(&sim_log, &sim_plan);
+        sim.stats = sim_plan.stats;
+        ndp10x_sim_free(&sim_log);
+        ndp10x_sim_free(&sim_plan);
+    }
+    bench_report("plan", &sim, 1);
+
+    /* a plan with a flipped payload byte is sent but reported corrupt */
+    memcpy(&ph, plan, sizeof(ph));
+    k = (unsigned int) sizeof(ph)
+        + ph.records * (unsigned int) sizeof(struct ndp_plan_record_s);
+    plan[k] ^= 0x01;
+    ndp10x_sim_init(&sim_plan);
+    ndp_plan = ndp;
+    ndp_plan.d = &sim_plan;
+    corrupt = bench_boot_plan(&ndp_plan, &bp, stage, BENCH_BRIDGE_CHUNK,
+                              log_len, checksum) == NDP_PLAN_CORRUPT;
+    ndp10x_sim_free(&sim_plan);
+    plan[k] ^= 0x01;
+
+    /*
+     * flash: boot from the log stored on the master SPI flash, in both
+     * layouts, with the old word loop and the streaming reader
+     */
+    ndp10x_sim_init(&sim_log);
+    ndp_log = ndp;
+    ndp_log.d = &sim_log;
+    s = bench_boot_log(&ndp_log, log, log_len, chunk, &ops);
+    for (i = 0; i < 2; i++) {
+        bench_flash(&ndp, &sim_log, &sim, log, log_len, (int) i, &flash[i]);
+        same &= !s && flash[i].ok;
+    }
+    ndp10x_sim_free(&sim_log);
+    bench_report("flash", &sim, 2);
+
+    /* dma: the boot through the transfer queue with posted writes */
+    bench_dma(log, log_len, &dma);
+
+    /* list: scatter-gather MCU reads and writes */
+    bench_list(&list);
+
+    /* crc: the model check over the chunks fed to the uILib */
+    bench_crc(log, log_len, chunk, boots, &crc);
+
+    /* lz: compressed packages of the log and of a sparse image */
+    bench_lz(&ndp, log, log_len, boots, &lz[0]);
+    sparse = bench_synthetic_log(&sparse_len, 1);
+    memset(&lz[1], 0, sizeof(lz[1]));
+    if (sparse) {
+        bench_lz(&ndp, sparse, sparse_len, boots, &lz[1]);
+    }
+    free(sparse);
+
+    /* tank: USB audio read from the holding tank for 'seconds' */
+    memset(&tank, 0, sizeof(tank));
+    if (seconds) {
+        bench_tank(seconds, &tank);
+    }
+
+    /* events: bursts of matches drained into the queue, 'polls' * 10 */
+    s = bench_events(polls * 10, &events);
+    if (s) {
+        fprintf(stderr, "events failed: %s\n", bench_error_name(s));
+        return 1;
+    }
+
+    /* poll: the firmware posts a match every 'every' polls */
+    for (i = 0; i < polls; i++) {
+        if (i % every == 0) {
+            ndp10x_sim_match(&sim, (int) (posted++ % 10));
+        }
+        s = syntiant_ndp10x_micro_poll(&ndp, &causes, 1);
+        while (!s && (causes & SYNTIANT_NDP10X_MICRO_NOTIFICATION_MATCH)) {
+            s = syntiant_ndp10x_micro_get_match(&ndp, &match);
+            if (!s && 0 <= match) {
+                seen++;
+            }
+            s = s ? s : syntiant_ndp10x_micro_poll(&ndp, &causes, 0);
+        }
+        if (s) {
+            fprintf(stderr, "poll failed: %s\n", bench_error_name(s));
+            return 1;
+        }
+    }
+    bench_report("poll", &sim, polls);
+
+    /* extract: 16 kHz 16-bit audio read back in 'extract' byte pieces */
+    len = 0;
+    s = syntiant_ndp10x_micro_extract_data
+        (&ndp, SYNTIANT_NDP10X_MICRO_EXTRACT_FROM_NEWEST, NULL, &len);
+    ndp10x_sim_clear_stats(&sim);
+    for (ops = 0; !s && ops < seconds * 32000UL / extract; ops++) {
+        for (k = 0; k < extract; k++) {
+            buf[k] = pattern++;
+        }
+        ndp10x_sim_audio(&sim, buf, extract);
+        len = extract;
+        s = syntiant_ndp10x_micro_extract_data
+            (&ndp, SYNTIANT_NDP10X_MICRO_EXTRACT_FROM_UNREAD, buf, &len);
+        for (k = 0; k < extract; k++) {
+            bad += buf[k] != expect++;
+        }
+    }
+    if (s) {
+        fprintf(stderr, "extract failed: %s\n", bench_error_name(s));
+        return 1;
+    }
+    bench_report("extract", &sim, ops);
+
+    /*
+     * bridge: frames of frame_ops register operations through a loopback
+     * link; every 16th frame has a bad checksum and must be rejected
+     */
+    memset(&io, 0, sizeof(io));
+    io.ctx = &link;
+    io.read = bench_link_read;
+    io.write = bench_link_write;
+    io.d = &sim;
+    io.transfer = ndp10x_sim_transfer;
+    io.frame = (uint8_t *) malloc(BENCH_BRIDGE_FRAME);
+    io.frameSize = BENCH_BRIDGE_FRAME;
+    io.chunk = (uint8_t *) malloc(BENCH_BRIDGE_CHUNK);
+    io.chunkSize = BENCH_BRIDGE_CHUNK;
+    req = (uint8_t *) malloc(BENCH_BRIDGE_FRAME + 8);
+    if (!io.frame || !io.chunk || !req
+        || !bench_pipe_init(&link.to_device, 4 * BENCH_BRIDGE_FRAME)
+        || !bench_pipe_init(&link.to_host, 4 * BENCH_BRIDGE_CHUNK)) {
+        fprintf(stderr, "unable to set up bridge loopback\n");
+        return 1;
+    }
+    t = bench_now();
+    for (i = 0; i < frames; i++) {
+        c = i % 16 == 15;
+        req_len = bench_bridge_request(req, (uint8_t) i, frame_ops,
+                                       i * 2654435761U, c);
+        bench_pipe_put(&link.to_device, req + 1, req_len - 1);
+        s = ndpBridgeFrame(&io);
+        if (bench_bridge_response(&link.to_host, (uint8_t) i, frame_ops,
+                                  i * 2654435761U)
+            != (c ? NDP_BRIDGE_CRC : NDP_BRIDGE_OK) || s != (c ? NDP_BRIDGE_CRC : NDP_BRIDGE_OK)) {
+            broken++;
+        }
+        rejects += c;
+    }
+    t = bench_now() - t;
+    bench_report("bridge", &sim, (unsigned long) frames * frame_ops);
+
+    printf("matches posted %lu seen %lu, extract mismatches %lu\n", posted,
+           seen, bad);
+    printf("plan %u bytes: boot %lu transfers %.0f us, plan %lu transfers "
+           "%.0f us, %s\n", (unsigned int) bp.size, log_transfers,
+           boots ? t_log * 1e6 / boots : 0.0, plan_transfers,
+           boots ? t_plan * 1e6 / boots : 0.0,
+           same ? "same device state" : "DEVICE STATE DIFFERS");
+    printf("plan payload check: %s\n",
+           corrupt ? "flipped byte caught" : "FLIPPED BYTE MISSED");
+    for (i = 0; i < 2; i++) {
+        printf("flash %s layout: word loop %lu reader transfers %.0f us, "
+               "stream %lu transfers %.0f us (%.0f KB/s), %s\n",
+               i ? "3 byte" : "4 byte", flash[i].reader[0], flash[i].us[0],
+               flash[i].reader[1], flash[i].us[1],
+               flash[i].us[1] > 0 ? log_len / flash[i].us[1] * 1e6 / 1024
+               : 0.0,
+               flash[i].ok ? "same device state" : "DEVICE STATE DIFFERS");
+    }
+    printf("dma %lu queued transfers, %lu payload bytes, %lu of %u blocks "
+           "returned with the write in flight, %lu block reuses waited, %s, "
+           "%d of %d queue checks\n", dma.transfers, dma.bytes, dma.posted,
+           (log_len + BENCH_DMA_BLOCK - 1) / BENCH_DMA_BLOCK, dma.reuses,
+           dma.same ? "same device state" : "DEVICE STATE DIFFERS",
+           dma.checks, BENCH_DMA_CHECKS);
+    for (i = 0; i < BENCH_LIST_PATTERNS; i++) {
+        printf("list %-11s %3u words: read %3u write %3u transactions\n",
+               bench_list_names[i], list.words[i], list.read[i],
+               list.write[i]);
+    }
+    printf("list reads %lu wire bytes one word a transaction, %lu listed, "
+           "%lu bad words\n", list.wire[0], list.wire[1], list.bad);
+    for (i = 0; i < 3; i++) {
+        printf("crc %-10s %7.0f ns/KB host, %5.0f us/KB est. M0+ at %.0f "
+               "MHz\n", bench_crc_names[i], crc.ns_per_kb[i],
+               bench_crc_m0_cycles[i] * 1024 / BENCH_M0_MHZ, BENCH_M0_MHZ);
+    }
+    printf("crc %u byte log: %s\n", log_len,
+           crc.ok ? "all loops agree" : "LOOPS DISAGREE");
+    for (i = 0; i < 2; i++) {
+        printf("lz %-8s %u -> %u bytes (%.1f%%), decode %.0f MB/s host over "
+               "%u decodes, %s\n",
+               i ? "sparse" : log_path ? "log" : "dense", lz[i].log_len,
+               (unsigned int) lz[i].size,
+               lz[i].log_len ? 100.0 * lz[i].size / lz[i].log_len : 0.0,
+               lz[i].mb_per_s, lz[i].decodes,
+               lz[i].ok ? "same device state" : "DEVICE STATE DIFFERS");
+    }
+    printf("tank blind 32 B/ms %.2f transfers %.1f us, stream 1 ms polls "
+           "%.2f transfers %.1f us, %u ms polls %.2f transfers %.1f us a "
+           "tick\n", tank.transfers[0], tank.us[0], tank.transfers[1],
+           tank.us[1], BENCH_TANK_POLL, tank.transfers[2], tank.us[2]);
+    printf("tank stream %lu bytes: %lu mismatches, %lu underruns, "
+           "%lu dropped\n", tank.bytes, tank.bad, tank.underruns,
+           tank.dropped);
+    printf("events %lu matches in bursts of 1-%u: one a poll %lu seen "
+           "(%lu late) %.2f transfers, drained %lu seen %.2f transfers an "
+           "interrupt, %lu wrong, %lu lost, %u queued at most\n",
+           events.posted, BENCH_EVENTS_BURST, events.seen[0], events.late,
+           events.transfers[0], events.seen[1], events.transfers[1],
+           events.wrong, events.lost, events.deepest);
+    printf("bridge %u ops/frame: %.0f round trips/s, %.0f ops/s, "
+           "%lu crc rejects, %lu bad responses\n", frame_ops,
+           t > 0 ? frames / t : 0.0, t > 0 ? frames * frame_ops / t : 0.0,
+           rejects, broken);
+
+    ndp10x_sim_free(&sim);
+    free(link.to_device.buf);
+    free(link.to_host.buf);
+    free(req);
+    free(plan);
+    free(stage);
+    free(io.chunk);
+    free(io.frame);
+    free(buf);
+    free(log);
+
+    return seen != posted || bad || broken || !same || !corrupt || !crc.ok
+        || !lz[0].ok || !lz[1].ok || tank.bad || tank.underruns
+        || tank.dropped || events.seen[1] != events.posted || events.wrong
+        || events.lost || !dma.same || dma.checks != BENCH_DMA_CHECKS
+        || list.bad;
+}
@@ -342,6 +342,36 @@ extern int syntiant_ndp10x_micro_extract_data
 extern int syntiant_ndp10x_micro_get_match
 (struct syntiant_ndp10x_micro_device_s *ndp, int *match);
 
+/**
+ * @brief NDP match record, a firmware match ring entry
+ *
+ * The firmware records the match summary and the holding tank pointer of
+ * each match; the class posteriors are thresholded on the NDP and not kept.
+ */
+struct syntiant_ndp10x_micro_match_s {
+    int match;          /**< matched class, or < 0 if no single class matched
+                           or no entry was pending */
+    int multiple;       /**< more than one class matched */
+    uint32_t summary;   /**< match summary word, 0 if no entry was pending */
+    uint32_t tankptr;   /**< holding tank offset of the match */
+    uint32_t slot;      /**< match ring slot of the entry */
+};
+
+/**
+ * @brief retrieve the whole NDP match record
+ *
+ * As @c syntiant_ndp10x_micro_get_match, from the same single transfer of
+ * the match ring entry.  The holding tank match position is updated for
+ * single class matches only.
+ *
+ * @param ndp NDP state object
+ * @param record match record
+ * @return a @c SYNTIANT_NDP_ERROR_* code
+ */
+extern int syntiant_ndp10x_micro_get_match_record
+(struct syntiant_ndp10x_micro_device_s *ndp,
+ struct syntiant_ndp10x_micro_match_s *record);
+
 #ifdef __cplusplus
 }
 #endif
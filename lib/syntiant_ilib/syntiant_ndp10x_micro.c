@@ -746,13 +746,16 @@ syntiant_ndp10x_micro_extract_data(struct syntiant_ndp10x_micro_device_s *ndp,
 }
 
 int
-syntiant_ndp10x_micro_get_match(struct syntiant_ndp10x_micro_device_s *ndp,
-                                int *match)
+syntiant_ndp10x_micro_get_match_record
+(struct syntiant_ndp10x_micro_device_s *ndp,
+ struct syntiant_ndp10x_micro_match_s *record)
 {
     int s;
     uint32_t addr, cons, v;
     uint32_t ms[NDP10X_FW_STATE_MATCH_RING_ENTRY_SIZE];
-    int m = -1;
+
+    memset(record, 0, sizeof(*record));
+    record->match = -1;
 
     if (ndp->match_producer != ndp->match_consumer) {
         s = syntiant_ndp10x_micro_read_fw_state(ndp);
@@ -770,17 +773,35 @@ syntiant_ndp10x_micro_get_match(struct syntiant_ndp10x_micro_device_s *ndp,
         }
 
         v = ms[NDP10X_FW_STATE_MATCH_RING_SUMMARY_OFFSET];
-        if (v & NDP10X_SPI_MATCH_MATCH_MASK
-            && !(v & NDP10X_SPI_MATCH_MULT_MASK)) {
-            m = NDP10X_SPI_MATCH_WINNER_EXTRACT(v);
-            ndp->tankptr_match = ms[NDP10X_FW_STATE_MATCH_RING_TANKPTR_OFFSET]
-                & ~0x3U;
+        record->summary = v;
+        record->tankptr = ms[NDP10X_FW_STATE_MATCH_RING_TANKPTR_OFFSET]
+            & ~0x3U;
+        record->slot = cons;
+        record->multiple = !!(v & NDP10X_SPI_MATCH_MULT_MASK);
+        if (v & NDP10X_SPI_MATCH_MATCH_MASK && !record->multiple) {
+            record->match = NDP10X_SPI_MATCH_WINNER_EXTRACT(v);
+            ndp->tankptr_match = record->tankptr;
         }
         cons++;
         cons = cons == ndp->match_ring_size ? 0 : cons;
         ndp->match_consumer = cons;
     }
 
-    *match = m;
+    return SYNTIANT_NDP_ERROR_NONE;
+}
+
+int
+syntiant_ndp10x_micro_get_match(struct syntiant_ndp10x_micro_device_s *ndp,
+                                int *match)
+{
+    struct syntiant_ndp10x_micro_match_s record;
+    int s;
+
+    s = syntiant_ndp10x_micro_get_match_record(ndp, &record);
+    if (s) {
+        return s;
+    }
+
+    *match = record.match;
     return SYNTIANT_NDP_ERROR_NONE;
 }
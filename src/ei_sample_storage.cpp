@@ -50,15 +50,77 @@ extern SdFat SD;
 /* Private variables ------------------------------------------------------- */
 static FatFile binFile;
 static uint8_t *sdPage = NULL;
+static uint32_t sdSampleBlocks = 0;
+
+/**
+ * @brief Number of blocks a sample file can take: the free space on the card
+ * plus the old sample file it replaces. Counted again only after
+ * ei_sd_sample_blocks_changed, walking the FAT of a large card takes seconds.
+ *
+ * @return uint32_t Blocks, 0 without a mounted SD card
+ */
+uint32_t ei_sd_sample_blocks(void)
+{
+    FatFile old;
+    uint64_t blocks;
+    int32_t clusters;
+
+    if (!SD.vol()->fatType()) {
+        sdSampleBlocks = 0;
+        return 0;
+    }
+    if (sdSampleBlocks) {
+        return sdSampleBlocks;
+    }
+
+    clusters = SD.vol()->freeClusterCount();
+    if (clusters <= 0) {
+        return 0;
+    }
+    blocks = (uint64_t)clusters * SD.vol()->blocksPerCluster();
+
+    if (old.open(TMP_FILE_NAME, O_RDONLY)) {
+        blocks += old.fileSize() / SD_BLOCK_SIZE;
+        old.close();
+    }
+
+    // a file and its byte offsets are 32 bit
+    if (blocks > 0xFFFFFFFFUL / SD_BLOCK_SIZE) {
+        blocks = 0xFFFFFFFFUL / SD_BLOCK_SIZE;
+    }
+    sdSampleBlocks = (uint32_t)blocks;
+
+    return sdSampleBlocks;
+}
+
+/**
+ * @brief Files other than the sample file grew or shrank on the card, count
+ * its free space again on the next ei_sd_sample_blocks. Replacing the sample
+ * file itself needs no call, it is counted as free.
+ */
+void ei_sd_sample_blocks_changed(void)
+{
+    sdSampleBlocks = 0;
+}
 
 /**
  * @brief Create and empty a binary file
+ *
+ * @param n_bytes Sample bytes the file must hold
+ * @return int 0 ok, else error
  */
-void ei_create_bin(void)
+int ei_create_bin(uint32_t n_bytes)
 {
     // max number of blocks to erase per erase call
     const uint32_t ERASE_SIZE = 262144L;
     uint32_t bgnBlock, endBlock;
+    uint32_t n_blocks = n_bytes / SD_BLOCK_SIZE + 1;
+
+    if (n_blocks > ei_sd_sample_blocks()) {
+        ei_printf("ERR: SD card has room for %lu bytes\r\n",
+                  (unsigned long)ei_sd_sample_blocks() * SD_BLOCK_SIZE);
+        return 1;
+    }
 
     // Delete old tmp file.
     if (SD.exists(TMP_FILE_NAME)) {
@@ -69,15 +131,15 @@ void ei_create_bin(void)
 
     // Create new file.
     binFile.close();
-    if (!binFile.createContiguous(TMP_FILE_NAME, SD_FILE_SIZE)) {
+    if (!binFile.createContiguous(TMP_FILE_NAME, n_blocks * SD_BLOCK_SIZE)) {
         ei_printf("ERR: SD creating file failed\r\n");
-        return;
+        return 1;
     }
 
     // Get the address of the file on the SD.
     if (!binFile.contiguousRange(&bgnBlock, &endBlock)) {
         ei_printf("ERR: SD address range failed\r\n");
-        return;
+        return 1;
     }
 
     // Flash erase all data in the file.
@@ -99,11 +161,13 @@ void ei_create_bin(void)
     // Start a multiple block write.
     if (!SD.card()->writeStart(bgnBlock, 2)) {
         ei_printf("ERR: SD start writing failed\r\n");
+        return 1;
     }
 
     if(sdPage == NULL) {
         sdPage = (uint8_t *)ei_malloc(SD_BLOCK_SIZE);
     }
+    return sdPage == NULL;
 }
 
 /**
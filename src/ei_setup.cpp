@@ -42,15 +42,19 @@
 #include "ei_sample_storage.h"
 #include "model-parameters/model_metadata.h"
 #include "model-parameters/model_variables.h"
+#include "syntiant.h"
 
 /* Extern declared function ------------------------------------------------ */
 extern void on_classification_changed(const char *event, float confidence, float anomaly_score);
 
 /* Static function forward declerations ------------------------------------ */
 static void run_nn_normal(void);
+static void ei_set_match_output(char *mode);
+static void ei_print_match_output(void);
 
 /* Static variables -------------------------------------------------------- */
 static bool run_impulse = false;
+static bool compact_output = false;
 
 /**
  * @brief      Setup config & register commands
@@ -79,32 +83,89 @@ void ei_setup(void)
 
     ei_at_register_generic_cmds();
     ei_at_cmd_register("RUNIMPULSE", "Run the impulse", run_nn_normal);
+    ei_at_cmd_register("SPISTATS?", "Lists NDP SPI transfer statistics", syntiant_print_spi_stats);
+    ei_at_cmd_register("CLEARSPISTATS", "Clears NDP SPI transfer statistics", syntiant_clear_spi_stats);
+    ei_at_cmd_register("AUDIOSTATS?", "Lists USB audio underruns and overruns", syntiant_print_audio_stats);
+    ei_at_cmd_register("CAPTURE=", "Captures audio around each match to WAV files (PRE,POST ms)", syntiant_set_capture);
+    ei_at_cmd_register("CAPTURE?", "Lists the match capture settings", syntiant_print_capture);
+    ei_at_cmd_register("RECORD=", "Records the microphone to a WAV file on SD (SECONDS, 0 stops)", syntiant_record);
+    ei_at_cmd_register("RECORD?", "Lists the recording progress and dropped samples", syntiant_print_recording);
+    ei_at_cmd_register("BOOTPROFILE?", "Lists the time spent in each boot phase", syntiant_print_boot_profile);
+    ei_at_cmd_register("MODELS?", "Lists the model slots", syntiant_list_models);
+    ei_at_cmd_register("MODEL=", "Switches the NDP to a model slot (index or file name)", syntiant_switch_model);
+    ei_at_cmd_register("STREAMLOAD=", "Loads a model sent over USB straight into the NDP (BYTES,SAVE)", syntiant_stream_model);
+    ei_at_cmd_register("MATCHOUTPUT=", "Sets the match output, 0 lists every label, 1 only the winning class id and time (MODE)", ei_set_match_output);
+    ei_at_cmd_register("MATCHOUTPUT?", "Lists the match output mode", ei_print_match_output);
 
     /* Auto start impulse */
     run_nn_normal();
 }
 
+/**
+ * @brief      Label of a matched class, "?" if the model has no such class
+ */
+const char *ei_classification_label(int matched_feature)
+{
+    if (matched_feature < 0 || matched_feature >= EI_CLASSIFIER_LABEL_COUNT) {
+        return "?";
+    }
+    return ei_classifier_inferencing_categories[matched_feature];
+}
+
 /**
  * @brief      Called from the ndp101 read out. Print classification output
  *             and send matched output string to user callback
+ * @details    Compact output prints "#<class id> <time in us>" only, which
+ *             takes a fraction of the serial time of the label list
  *
- * @param[in]  matched_feature
+ * @param[in]  matched_feature  The winning class, from 0
+ * @param[in]  micros           Time of the match
+ * @param[in]  summary          Match summary word of the NDP match record
+ * @param[in]  tank_ptr         Holding tank offset of the match
  */
-void ei_classification_output(int matched_feature)
+void ei_classification_output(int matched_feature, uint32_t micros, uint32_t summary,
+                              uint32_t tank_ptr)
 {
     if (ei_run_impulse_active()) {
 
-        ei_printf("\nPredictions:\r\n");
+        if (compact_output) {
+            ei_printf("#%d %lu\r\n", matched_feature, (unsigned long)micros);
+        }
+        else {
+            ei_printf("\nPredictions:\r\n");
 
-        for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
-            ei_printf("    %s: \t%d\r\n", ei_classifier_inferencing_categories[ix],
-                (matched_feature == ix) ? 1 : 0);
+            for (size_t ix = 0; ix < EI_CLASSIFIER_LABEL_COUNT; ix++) {
+                ei_printf("    %s: \t%d\r\n", ei_classifier_inferencing_categories[ix],
+                    (matched_feature == ix) ? 1 : 0);
+            }
+            if (matched_feature >= EI_CLASSIFIER_LABEL_COUNT) {
+                ei_printf("    class %d not in the model\r\n", matched_feature);
+            }
+            ei_printf("    summary 0x%08lx, tank offset 0x%lx\r\n", (unsigned long)summary,
+                (unsigned long)tank_ptr);
         }
 
-        on_classification_changed(ei_classifier_inferencing_categories[matched_feature], 0, 0);
+        // the NDP thresholds the posteriors itself, the match record has no score
+        on_classification_changed(ei_classification_label(matched_feature), 0, 0);
     }
 }
 
+/**
+ * @brief      AT+MATCHOUTPUT=MODE, 0 verbose, 1 compact
+ */
+static void ei_set_match_output(char *mode)
+{
+    compact_output = strtoul(mode, NULL, 0) != 0;
+}
+
+/**
+ * @brief      AT+MATCHOUTPUT?
+ */
+static void ei_print_match_output(void)
+{
+    ei_printf("%s\r\n", compact_output ? "1 (compact: #<class id> <us>)" : "0 (verbose)");
+}
+
 /**
  * @brief      Start impulse, print settings
  */
@@ -37,9 +37,11 @@
 #include "ei_syntiant_fs_commands.h"
 #include "../../repl/repl.h"
 #include "ei_inertialsensor.h"
+#include "ei_microphone.h"
 
 #include "Arduino.h"
 #include "NDP_Serial.h"
+#include "NDP_bridge.h"
 
 #include <cstdio>
 #include <cstdlib>
@@ -177,11 +179,15 @@ bool EiDeviceSyntiant::get_wifi_present_status(void)
     return false;
 }
 
-static bool microphone_callback()
+/**
+ * @brief      Sample length in s that bytes hold at bytes_per_s, clamped to
+ *             the uint16_t of the sensor list: a large card holds more
+ */
+static uint16_t max_sample_length_s(uint32_t bytes, uint32_t bytes_per_s)
 {
-    ei_printf("ERR: Can't sample audio directly from device. Go to: \"Devices - Connect a new device - Use your computer\"\r\n");
+    uint32_t s = bytes / bytes_per_s;
 
-    return false;
+    return s > UINT16_MAX ? UINT16_MAX : (uint16_t)s;
 }
 
 /**
@@ -195,16 +201,20 @@ static bool microphone_callback()
 bool EiDeviceSyntiant::get_sensor_list(const ei_device_sensor_t **sensor_list, size_t *sensor_list_size)
 {
     /* Calculate number of bytes available on flash for sampling, reserve 1 block for header + overhead */
-    uint32_t available_bytes = 3200000;//(ei_syntiant_fs_get_n_available_sample_blocks()-1) * ei_syntiant_fs_get_block_size();
+    uint32_t n_blocks = ei_syntiant_fs_get_n_available_sample_blocks();
+    uint32_t available_bytes = n_blocks ? (n_blocks - 1) * ei_syntiant_fs_get_block_size() : 0;
 
+    /* The sampler erases twice the raw sample size for the CBOR encoding */
     sensors[MICROPHONE].name = "Built-in microphone";
-    sensors[MICROPHONE].start_sampling_cb = &microphone_callback;
-    sensors[MICROPHONE].max_sample_length_s = available_bytes / (16000 * 2);
-    sensors[MICROPHONE].frequencies[0] = 16000.0f;
+    sensors[MICROPHONE].start_sampling_cb = &ei_microphone_setup_data_sampling;
+    sensors[MICROPHONE].max_sample_length_s =
+        max_sample_length_s(available_bytes, MIC_SAMPLE_RATE * SIZEOF_MIC_SAMPLE * 2);
+    sensors[MICROPHONE].frequencies[0] = (float)MIC_SAMPLE_RATE;
 
     sensors[INTERTIAL].name = "Inertial";
     sensors[INTERTIAL].start_sampling_cb = &ei_inertial_setup_data_sampling;
-    sensors[INTERTIAL].max_sample_length_s = available_bytes / (100 * SIZEOF_N_AXIS_SAMPLED);
+    sensors[INTERTIAL].max_sample_length_s =
+        max_sample_length_s(available_bytes, 100 * SIZEOF_N_AXIS_SAMPLED * 2);
     sensors[INTERTIAL].frequencies[0] = 100.f;
 
     *sensor_list      = sensors;
@@ -293,17 +303,19 @@ c_callback_read_sample_buffer EiDeviceSyntiant::get_read_sample_buffer_function(
 
 /**
  * @brief      Get characters for uart pheripheral and send to repl
+ *
+ * @return     ':' or NDP_BRIDGE_SYNC if a management command starts, else 0
  */
-bool ei_command_line_handle(void)
+int ei_command_line_handle(void)
 {
     char byte;
-    bool syntiant_cmd_start_found = false;
+    int syntiant_cmd_start_found = 0;
     while (Serial.available()) {
         // rx_callback(Serial.read());
         byte = Serial.read();
 
-        if (byte == ':') {
-            syntiant_cmd_start_found = true;
+        if (byte == ':' || (uint8_t)byte == NDP_BRIDGE_SYNC) {
+            syntiant_cmd_start_found = (uint8_t)byte;
             break;
         }
         else if (ei_run_impulse_active() && byte == 'b') {
@@ -90,7 +90,7 @@ public:
 };
 
 /* Function prototypes ----------------------------------------------------- */
-bool ei_command_line_handle(void);
+int ei_command_line_handle(void);
 void ei_start_stop_run_impulse(bool start);
 bool ei_run_impulse_active(void);
 void ei_printf(const char *format, ...);
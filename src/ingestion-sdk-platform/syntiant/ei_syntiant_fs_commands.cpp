@@ -162,8 +162,7 @@ int ei_syntiant_fs_erase_sampledata(uint32_t start_block, uint32_t end_address)
 
     #elif(SAMPLE_MEMORY == MICRO_SD)
 
-    ei_create_bin();
-    return SYNTIANT_FS_CMD_OK;
+    return ei_create_bin(end_address) ? SYNTIANT_FS_CMD_ERASE_ERROR : SYNTIANT_FS_CMD_OK;
 
 	#elif(SAMPLE_MEMORY == SERIAL_FLASH)
 	return flash_erase_sectors(MX25R_BLOCK64_SIZE, end_address / MX25R_SECTOR_SIZE);
@@ -301,7 +300,7 @@ uint32_t ei_syntiant_fs_get_n_available_sample_blocks(void)
 	#if(SAMPLE_MEMORY == RAM)
 	return RAM_N_BLOCKS;
     #elif(SAMPLE_MEMORY == MICRO_SD)
-    return SD_N_BLOCKS;
+    return ei_sd_sample_blocks();
 	#elif(SAMPLE_MEMORY == SERIAL_FLASH)
 	return (MX25R_CHIP_SIZE - MX25R_BLOCK64_SIZE) / MX25R_SECTOR_SIZE;
 	#endif
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2021 Syntiant Corp.  All rights reserved.
+ * Contact at http://www.syntiant.com
+ *
+ * This software is available to you under a choice of one of two licenses.
+ * You may choose to be licensed under the terms of the GNU General Public
+ * License (GPL) Version 2, available from the file LICENSE in the main
+ * directory of this source tree, or the OpenIB.org BSD license below.  Any
+ * code involving Linux software will require selection of the GNU General
+ * Public License (GPL) Version 2.
+ *
+ * OPENIB.ORG BSD LICENSE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright notice,
+ * this list of conditions and the following disclaimer.
+ *
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+/* Include ----------------------------------------------------------------- */
+#include <stdint.h>
+
+#include "ei_microphone.h"
+#include "ei_device_syntiant_samd.h"
+#include "firmware-sdk/sensor_aq.h"
+#include "edge-impulse-sdk/porting/ei_classifier_porting.h"
+
+/* Extern declared --------------------------------------------------------- */
+extern ei_config_t *ei_config_get_config();
+extern EI_CONFIG_ERROR ei_config_set_sample_interval(float interval);
+
+extern bool syntiant_sample_audio(sampler_callback callback, uint32_t lengthMs);
+
+/**
+ * @brief      Stream holding tank audio to the callback until it has all
+ *             samples
+ *
+ * @param[in]  callsampler         Function to handle the sampled data
+ * @param[in]  sample_interval_ms  The sample interval milliseconds
+ *
+ * @return     false if no model is running, the SD card is busy or audio
+ *             was lost
+ */
+bool ei_microphone_sample_start(sampler_callback callsampler, float sample_interval_ms)
+{
+    ei_config_set_sample_interval(sample_interval_ms);
+
+    EiDevice.set_state(eiStateSampling);
+
+    return syntiant_sample_audio(callsampler, ei_config_get_config()->sample_length_ms);
+}
+
+/**
+ * @brief      Setup payload header and take the sample
+ *
+ * @return     false if the sample failed, timed out or lost audio
+ */
+bool ei_microphone_setup_data_sampling(void)
+{
+#ifndef WITH_IMU
+
+    // the tank runs at a fixed rate
+    ei_config_set_sample_interval(1000.f / MIC_SAMPLE_RATE);
+
+    sensor_aq_payload_info payload = {
+        // Unique device ID (optional), set this to e.g. MAC address or device EUI **if** your device has one
+        EiDevice.get_id_pointer(),
+        // Device type (required), use the same device type for similar devices
+        EiDevice.get_type_pointer(),
+        // How often new data is sampled in ms. (100Hz = every 10 ms.)
+        ei_config_get_config()->sample_interval_ms,
+        // The axes which you'll use. The units field needs to comply to SenML units (see https://www.iana.org/assignments/senml/senml.xhtml)
+        { { "audio", "wav" } },
+    };
+
+    EiDevice.set_state(eiStateErasingFlash);
+    bool ok = ei_sampler_start_sampling(&payload, &ei_microphone_sample_start, SIZEOF_MIC_SAMPLE);
+    EiDevice.set_state(eiStateIdle);
+    return ok;
+#else
+    ei_printf("ERR: Microphone disabled in the IMU firmware, compile without --with-imu\r\n");
+    return false;
+#endif
+}
@@ -58,6 +58,7 @@ static bool create_header(sensor_aq_payload_info *payload);
 static uint32_t samples_required;
 static uint32_t current_sample;
 static uint32_t sample_buffer_size;
+static uint32_t sample_bytes;
 static uint32_t headerOffset = 0;
 static uint8_t write_word_buf[4];
 static int write_addr = 0;
@@ -165,6 +166,7 @@ bool ei_sampler_start_sampling(void *v_ptr_payload, starter_callback ei_sample_s
     // samples_required = (uint32_t)((dev->get_sample_length_ms()) / dev->get_sample_interval_ms());
     samples_required = (uint32_t)(((float)ei_config_get_config()->sample_length_ms) / ei_config_get_config()->sample_interval_ms);
     sample_buffer_size = (samples_required * sample_size) * 2;
+    sample_bytes = sample_size;
     current_sample = 0;
 
     // Minimum delay of 2000 ms for daemon
@@ -172,7 +174,10 @@ bool ei_sampler_start_sampling(void *v_ptr_payload, starter_callback ei_sample_s
 
     ei_printf("Starting in %lu ms... (or until all flash was erased)\n", delay_time_ms < 2000 ? 2000 : delay_time_ms);
 
-    ei_syntiant_fs_erase_sampledata(0, sample_buffer_size);
+    if (ei_syntiant_fs_erase_sampledata(0, sample_buffer_size) != SYNTIANT_FS_CMD_OK) {
+        ei_printf("ERR: Failed to erase sample memory\n");
+        return false;
+    }
 
     // if erasing took less than 2 seconds, wait additional time
     if(delay_time_ms < 2000) {
@@ -199,7 +204,7 @@ bool ei_sampler_start_sampling(void *v_ptr_payload, starter_callback ei_sample_s
     uint8_t final_byte[] = {0xff};
     int ctx_err = ei_mic_ctx.signature_ctx->update(ei_mic_ctx.signature_ctx, final_byte, 1);
     if (ctx_err != 0) {
-        return ctx_err;
+        return false;
     }
 
     // finish the signing
@@ -308,6 +313,9 @@ static bool create_header(sensor_aq_payload_info *payload)
 
 /**
  * @brief      Write samples to FLASH in CBOR format
+ * @details    A single int16 axis (sample size 2, the microphone) is passed in
+ *             batches of any number of samples, other sensors one float
+ *             sample per call
  *
  * @param[in]  sample_buf  The sample buffer
  * @param[in]  byteLenght  The byte lenght
@@ -316,6 +324,18 @@ static bool create_header(sensor_aq_payload_info *payload)
  */
 static bool sample_data_callback(const void *sample_buf, uint32_t byteLenght)
 {
+    if (sample_bytes == sizeof(int16_t)) {
+        uint32_t n = byteLenght / sizeof(int16_t);
+
+        if (n > samples_required - current_sample) {
+            n = samples_required - current_sample;
+        }
+        sensor_aq_add_data_batch(&ei_mic_ctx, (int16_t *)sample_buf, n);
+        current_sample += n;
+
+        return current_sample >= samples_required;
+    }
+
     sensor_aq_add_data(&ei_mic_ctx, (float *)sample_buf, byteLenght / sizeof(float));
 
     if (++current_sample > samples_required) {
@@ -48,6 +48,8 @@
 #include <SPI.h>
 
 #include <NDP.h>
+#include <NDP_bridge.h>
+#include <NDP_tank.h>
 #include <NDP_utils.h>
 
 #include <HID-Project.h>
@@ -61,15 +63,30 @@
 
 #include "syntiant.h"
 #include "../syntiant_arduino_version.h"
+#include "ei_sample_storage.h"
 #include "ingestion-sdk-platform/syntiant/ei_device_syntiant_samd.h"
 #include "repl/repl.h"
 
 /* Constant defines -------------------------------------------------------- */
 #define CONVERT_G_TO_MS2    9.80665f
 
+// Build with -DSYNTIANT_FAST_BOOT=1 for the shortest wake to listening
+// time. The NDP reset pulse is cut short and the NDP and flash are polled
+// until they answer instead of waiting out fixed delays, the board found on
+// the last boot is checked first, and the board is probed only once.
+#ifndef SYNTIANT_FAST_BOOT
+#define SYNTIANT_FAST_BOOT 0
+#endif
+
+#define NDP_RESET_PULSE_US 1000  // fast boot PORSTB low time
+#define NDP_READY_TIMEOUT_MS 100 // the fixed reset delay it replaces
+#define FLASH_READY_TIMEOUT_MS 10
+
 /* Extern declared --------------------------------------------------------- */
 extern void ei_setup(void);
-extern void ei_classification_output(int matched_feature);
+extern void ei_classification_output(int matched_feature, uint32_t micros, uint32_t summary,
+                                     uint32_t tank_ptr);
+extern const char *ei_classification_label(int matched_feature);
 
 #if defined(WITH_IMU)
 String model = "ei_model_sensor.bin";
@@ -97,8 +114,13 @@ const byte LOAD_BIN_FILE = 0x12;
 const byte START_OF_FILE = 0x13;
 const byte I2C_READ = 0x14;
 const byte I2C_WRITE = 0x15;
+const byte SWITCH_MODEL = 0x16;
+const byte STREAM_LOAD = 0x17;
+const byte RX_FLASH_BUFFER_ACKED = 0x18;
 
 const byte GET_INT_COUNT = 0xf0;
+const byte GET_SPI_STATS = 0xf1;
+const byte CLEAR_SPI_STATS = 0xf2;
 
 // console commands
 const byte GET_INFO = ':';
@@ -156,6 +178,7 @@ Uart Serial2(&sercom3, 7, 6, SERCOM_RX_PAD_3, UART_TX_PAD_2);
 TwoWire myWire(&sercom5, 0, 1);
 
 byte doInt = 0; // flag indicating an interrupt from NDP
+static volatile uint32_t doIntMicros = 0; // when the NDP raised it
 
 // Flash Type read from Serial Flash JEDEC register. From SerialFlash.h
 byte FlashType[4];
@@ -167,7 +190,8 @@ uint16_t USBConnected = 0; // counter for USB in the disconnected state
 
 byte SD_or_SerialFlash = 0; // used when programming SD or Serial Flash devices
 
-int match = 0; // indicated which class has matched
+int match = 0; // set when not running from flash, for the HID report
+struct ndp_events_s matchEvents; // matches drained by the interrupt
 
 int doingMgmtCmd = 0;
 
@@ -180,10 +204,150 @@ File myFile;
 SerialFlashFile mySerialFlashFile;
 
 #ifdef WITH_AUDIO
-int16_t audioBuf[32]; // Audio Buffer
+int16_t audioBuf[32] __attribute__((aligned(4))); // Audio Buffer
+
+// The holding tank is polled every TANK_POLL_TICKS ms and what the DSP
+// wrote since is fetched in one or two bursts into tankRing. USB audio
+// reads 32 bytes a ms from there, after TANK_AUDIO_PREFILL bytes so the
+// polls do not starve it.
+#define TANK_RING_BYTES 2048
+#define TANK_POLL_TICKS 4
+#define TANK_AUDIO_PREFILL 512
+
+static uint8_t tankRing[TANK_RING_BYTES] __attribute__((aligned(4)));
+struct ndp_tank_s tank = {NULL, NDPClass::spiTransfer, tankRing, TANK_RING_BYTES};
+static struct ndp_tank_reader_s audioReader;
+static int tankTicks = 0;
+
+// Continuous recording. The timer 4 interrupt copies the tank ring into
+// RECORD_BLOCKS SD blocks and the main loop streams full ones into a
+// contiguous file with a multi-block write, as ei_create_bin does. While
+// every block waits for the main loop the samples stay in the tank ring,
+// and only what the ring overwrites is dropped.
+//
+// The blocks and the ring hold 8 KB, 256 ms at 32 KB/s, against SD cards
+// that stay busy up to about 250 ms in a write. The longest write of a
+// recording is reported at its end to check the margin.
+#define RECORD_BLOCKS 12
+#define RECORD_BLOCK_BYTES 512
+
+// AT+SAMPLESTART gives up on the tank this long after the sample length
+#define SAMPLE_AUDIO_SLACK_MS 1000
+
+static uint8_t recBuf[RECORD_BLOCKS][RECORD_BLOCK_BYTES] __attribute__((aligned(4)));
+static struct ndp_tank_reader_s recReader;
+static volatile bool recActive = false;
+static volatile uint32_t recProduced = 0; // blocks filled, interrupt only
+static volatile uint32_t recConsumed = 0; // blocks written, main loop only
+static volatile uint32_t recBlocksLeft = 0;
+static uint32_t recFill = 0;
+
+static void openTank()
+{
+    unsigned long dropped = recReader.dropped;
+
+    tankTicks = 0;
+    ndpTankOpen(&tank);
+    ndpTankReaderStart(&tank, &audioReader);
+    // a recording goes on with the new model, after a gap
+    ndpTankReaderStart(&tank, &recReader);
+    recReader.dropped = dropped;
+}
+
+// Timer 4 interrupt: move the new samples into the recording blocks
+static void fillRecording(void)
+{
+    uint8_t *block;
+
+    while (recActive && recBlocksLeft)
+    {
+        // every block waits for the main loop, the samples wait in the ring
+        if (recProduced - recConsumed == RECORD_BLOCKS)
+            return;
+        block = recBuf[recProduced % RECORD_BLOCKS];
+        recFill += ndpTankRead(&tank, &recReader, block + recFill,
+                               RECORD_BLOCK_BYTES - recFill);
+        if (recFill < RECORD_BLOCK_BYTES)
+            return;
+        recFill = 0;
+        recProduced++;
+        recBlocksLeft--;
+    }
+}
+
+// Match triggered capture. After a match the timer 4 interrupt extracts
+// the pre-roll before it and the post-roll after it from the holding tank,
+// CAPTURE_BLOCK bytes a tick into two buffers, and the main loop writes
+// them out as a WAV file: CAPnnnnn.WAV on the SD card or, without one, the
+// next of CAPTURE_FLASH_SLOTS files on Serial Flash. AT+CAPTURE=PRE,POST
+// sets the windows in ms, it is off (0,0) by default.
+#define CAPTURE_BLOCK 256
+#define CAPTURE_FLASH_SLOTS 4
+#define CAPTURE_FLASH_SLOT_BYTES 65536
+#define CAPTURE_COMMENT_BYTES 40
+#define CAPTURE_WAV_HEADER (64 + CAPTURE_COMMENT_BYTES)
+
+static uint32_t capPreBytes = 0;
+static uint32_t capPostBytes = 0;
+static volatile bool capBusy = false;
+static volatile uint32_t capLeft = 0; // bytes still to extract
+static uint32_t capTotal = 0;
+static int capClass = 0;
+static uint32_t capMillis = 0;
+static uint8_t capBuf[2][CAPTURE_BLOCK] __attribute__((aligned(4)));
+static volatile uint16_t capLen[2];
+static int capIsr = 0;
+static int capMain = 0;
+static unsigned long capCount = 0;
+static unsigned long capFailed = 0;
+
+// Timer 4 interrupt: start capturing around the match just polled
+static void startCapture(int cls)
+{
+    uint32_t pre = capPreBytes;
+
+    // the SD card is busy with a multi-block write while recording
+    if (capBusy || recActive || !(capPreBytes || capPostBytes))
+        return;
+    // the pre-roll must still be in the tank
+    if (pre > tank.tankSize / 4 * 3)
+        pre = tank.tankSize / 4 * 3 & ~3U;
+    if (NDP.setExtractMatch(pre) != SYNTIANT_NDP_ERROR_NONE)
+    {
+        capFailed++;
+        return;
+    }
+    capClass = cls;
+    capMillis = millis();
+    capTotal = pre + capPostBytes;
+    capLen[0] = capLen[1] = 0;
+    capIsr = capMain = 0;
+    capLeft = capTotal;
+    capBusy = true;
+}
+
+// Timer 4 interrupt: extract what is available of the next block
+static void extractCapture(void)
+{
+    unsigned int len;
+
+    if (!capLeft || capLen[capIsr])
+        return;
+    len = min(capLeft, (uint32_t)CAPTURE_BLOCK);
+    if (NDP.extractData(capBuf[capIsr], &len) != SYNTIANT_NDP_ERROR_NONE)
+    {
+        capLeft = 0; // the rest is written as silence
+        return;
+    }
+    len = min(len, min(capLeft, (uint32_t)CAPTURE_BLOCK));
+    if (len)
+    {
+        capLen[capIsr] = len;
+        capIsr ^= 1;
+        capLeft -= len;
+    }
+}
 #endif
-uint32_t tankAddress = 0;
-uint32_t tankSize = 0;
 
 uint32_t currentPointer = 0;
 static uint32_t prevPointer = 0;
@@ -197,6 +361,42 @@ static bool imu_active = false;
 
 static uint32_t startingFWAddress;
 
+// syntiant_setup phases, in order. bootMarks holds micros() at the end of
+// each, the first is the Arduino core start up before syntiant_setup.
+enum boot_phase_e {
+    BOOT_CORE,
+    BOOT_FLASH_ID,  // Serial Flash probe, NDP clock
+    BOOT_NDP_RESET,
+    BOOT_NDP_PROBE, // which chip select the NDP answers on
+    BOOT_BOARD,     // Serial2, PMIC and pins of the TinyML board
+    BOOT_SPI_SPEED,
+    BOOT_MODEL,     // loadModel
+    BOOT_SLOTS,     // model slot scan
+    BOOT_DEVICES,   // the rest of syntiant_setup
+    BOOT_EI,        // ei_setup
+    BOOT_PHASES
+};
+
+static const char *const bootPhaseNames[BOOT_PHASES] = {
+    "core", "flash id", "ndp reset", "ndp probe", "board", "spi speed",
+    "model", "slots", "devices", "ei setup"};
+
+static uint32_t bootMarks[BOOT_PHASES];
+
+// The board found on the last boot. It lives in RAM the startup code does
+// not clear, so it survives a reset but not a power cycle; fast boot
+// confirms it with one NDP ID read before trusting it.
+#define BOOT_CACHE_MAGIC 0x544f4f42 // "BOOT"
+
+struct boot_cache_s {
+    uint32_t magic;
+    byte flashType;
+    byte cs;
+};
+
+static struct boot_cache_s bootCache __attribute__((section(".noinit")));
+static bool bootCached = false;
+
 byte LastUserSwitch = 1;
 uint32_t SAVE_REG_SYSCTRL_DFLLCTRL = 0xA46;
 uint32_t SAVE_REG_SYSCTRL_DFLLMUL = 0x7DFF05B9;
@@ -256,12 +456,69 @@ void writeBytes(uint8_t *data, int count)
         Serial.flush();
     }
 }
+// Bridge transfers of any size are streamed through the two halves of
+// spiData, the SPI transfer of one chunk overlapping the USB transfer of
+// the other. MCU addresses advance with each chunk, direct register
+// addresses (e.g. the sample FIFO) stay put.
+const uint32_t BRIDGE_CHUNK = sizeof(spiData) / 2;
+
+static void bridgeRead(int mcu, uint32_t addr, uint32_t count)
+{
+    uint8_t *buf[2] = {spiData, spiData + BRIDGE_CHUNK};
+    uint32_t chunk = min(count, BRIDGE_CHUNK);
+    uint32_t next;
+    int i = 0;
+
+    if (chunk)
+        NDP.spiTransfer(NULL, mcu, addr, NULL, buf[i], chunk);
+    while (chunk)
+    {
+        count -= chunk;
+        if (mcu)
+            addr += chunk;
+        next = min(count, BRIDGE_CHUNK);
+        if (next)
+            NDP.spiTransferAsync(mcu, addr, NULL, buf[!i], next, NULL, NULL);
+        writeBytes(buf[i], chunk);
+        NDP.spiTransferWait();
+        i = !i;
+        chunk = next;
+    }
+}
+
+// returns false if the host sent fewer than count bytes
+static bool bridgeWrite(int mcu, uint32_t addr, uint32_t count)
+{
+    uint8_t *buf[2] = {spiData, spiData + BRIDGE_CHUNK};
+    uint32_t chunk;
+    int i = 0;
+    int s;
+
+    while (count)
+    {
+        chunk = min(count, BRIDGE_CHUNK);
+        s = Serial.readBytes((char *)buf[i], chunk);
+        // the previous chunk is still going out of the other half
+        NDP.spiTransferWait();
+        if (s < (int)chunk)
+            return false;
+        NDP.spiTransferAsync(mcu, addr, buf[i], NULL, chunk, NULL, NULL);
+        count -= chunk;
+        if (mcu)
+            addr += chunk;
+        i = !i;
+    }
+    NDP.spiTransferWait();
+    return true;
+}
+
 int ints = 0;
 int old_int = 0;
 // INT pin interrupt from NDP. Simply flag form main() routine to process
 void ndpInt()
 {
     SCB->SCR &= !SCB_SCR_SLEEPDEEP_Msk; // Don't Allow Deep Sleep
+    doIntMicros = micros();
     doInt = 1;
     ledTimerCount = 1 * (1000000 / timer_in_uS); // flash LED for 1 second
 
@@ -296,7 +553,7 @@ void syntiant_get_imu(float *dest_imu)
     imu_active = false;
 }
 
-// Timer 4 interrupt. Handles ALL touches of NDP. Also services USB Audio
+// Timer 4 interrupt. Handles ALL touches of NDP. Also feeds USB Audio
 void isrTimer4(struct tc_module *const module_inst)
 {
     digitalWrite(0, LOW);
@@ -315,25 +572,24 @@ void isrTimer4(struct tc_module *const module_inst)
 
 
 #ifdef WITH_AUDIO
-    if (runningFromFlash) {
-
-        uint32_t tankRead;
-        int i;
-
-        for (i = 0; i < 32; i += 4)
-        {
-            tankRead =
-                indirectRead(tankAddress + ((currentPointer - 32 + i) % tankSize));
-            audioBuf[i / 2] = tankRead & 0xffff;
-            audioBuf[(i / 2) + 1] = (tankRead >> 16) & 0xffff;
-        }
-        currentPointer += 32;
-        currentPointer %= tankSize;
+    if (runningFromFlash && ++tankTicks >= TANK_POLL_TICKS) {
+        NDP_SPI_SITE(NDP_SPI_SITE_TANK);
+        tankTicks = 0;
+        ndpTankPoll(&tank, TANK_RING_BYTES / 2);
+    }
+    // on an underrun the previous samples are sent again
+    ndpTankReadPaced(&tank, &audioReader, audioBuf, 32, TANK_AUDIO_PREFILL);
+    if (runningFromFlash)
+    {
+        extractCapture();
+        fillRecording();
     }
-    AudioUSB.write(audioBuf, 32); // write samples to AudioUSB
+    AudioUSB.write(audioBuf, 32); // queued, sent at the next USB frames
 #else
 
     if(runningFromFlash) {
+        NDP_SPI_SITE(NDP_SPI_SITE_TANK);
+
         currentPointer = indirectRead(startingFWAddress);
 
         int32_t diffPointer = ((int32_t)currentPointer - prevPointer);
@@ -370,18 +626,14 @@ void isrTimer4(struct tc_module *const module_inst)
         // Poll NDP for cause of interrupt (if running from flash)
         if (runningFromFlash)
         {
-            match = NDP.poll();
-
-            if (match)
-            {
-                // Light Arduino LED
-                digitalWrite(LED_BUILTIN, HIGH);
-
-                ei_classification_output(match -1);
+            uint32_t queued = matchEvents.head;
 
-                printBattery(); // Print current battery level
-
-            }
+            // the main loop reports them, see serviceMatchEvents
+            NDP.pollEvents(&matchEvents, doIntMicros);
+#ifdef WITH_AUDIO
+            if (matchEvents.head != queued)
+                startCapture(matchEvents.newest.winner);
+#endif
         }
         else
         {
@@ -391,6 +643,99 @@ void isrTimer4(struct tc_module *const module_inst)
     digitalWrite(0, HIGH);
 }
 
+// Read the NDP ID register through chip select cs
+static bool ndpAnswers(byte cs)
+{
+    byte saved = SPI_CS;
+
+    SPI_CS = cs;
+    NDP.spiTransfer(NULL, 0, 0x0, NULL, spiData, 1);
+    SPI_CS = saved;
+    return spiData[0] == 0x20;
+}
+
+// Poll the NDP until it answers on cs, or on other, after a reset
+static bool waitNdpReady(byte cs, byte other)
+{
+    uint32_t start = millis();
+
+    do
+    {
+        if (ndpAnswers(cs) || (other != cs && ndpAnswers(other)))
+            return true;
+    } while (millis() - start < NDP_READY_TIMEOUT_MS);
+    return false;
+}
+
+// Pulse the NDP PORSTB reset. Fast boot polls the NDP on SPI_CS instead of
+// the fixed delay, or with probe on both chip selects, while the board is
+// not known yet. Returns false when it did not answer in time.
+static bool resetNdp(bool probe)
+{
+    bool ready = true;
+
+    pinMode(PORSTB, OUTPUT);
+    digitalWrite(PORSTB, LOW);
+#if SYNTIANT_FAST_BOOT
+    delayMicroseconds(NDP_RESET_PULSE_US);
+    digitalWrite(PORSTB, HIGH);
+    ready = probe ? waitNdpReady(NDP9101_CS, TINYML_CS)
+                  : waitNdpReady(SPI_CS, SPI_CS);
+#else
+    delay(100);
+    digitalWrite(PORSTB, HIGH);
+#endif
+    invalidateMasterSpiShadow();
+    return ready;
+}
+
+// Read the flash ID, in fast boot once the flash answers
+static void readFlashType(void)
+{
+#if SYNTIANT_FAST_BOOT
+    uint32_t start = millis();
+
+    while (!SerialFlash.begin(FLASH_CS)
+           && millis() - start < FLASH_READY_TIMEOUT_MS)
+        ;
+#else
+    SerialFlash.begin(FLASH_CS);
+#endif
+    SerialFlash.readID(FlashType);
+}
+
+// Pick the NDP SPI clock. A speed saved on the SD card is checked again
+// with a few pattern rounds; a full calibration runs when there is none or
+// it no longer holds. Runs on the freshly reset NDP before the model loads.
+static void setupSpiSpeed(void)
+{
+    uint32_t general, sampleWrite;
+    bool onSd = sdCardInserted() && SD.begin(SDCARD_SS_PIN);
+
+    if (onSd && loadSpiSpeedConfig(&general, &sampleWrite)
+        && verifySpiSpeed(general, 2))
+    {
+        spiSpeedGeneral = general;
+        spiSpeedSampleWrite = sampleWrite;
+        SPI.beginTransaction(SPISettings(spiSpeedGeneral, MSBFIRST, SPI_MODE0));
+        return;
+    }
+
+    if (!calibrateSpiSpeed())
+    {
+        ei_printf("NDP SPI calibration failed, keeping %lu Hz\r\n",
+                  (unsigned long)spiSpeedGeneral);
+        return;
+    }
+    ei_printf("NDP SPI clock calibrated to %lu Hz\r\n",
+              (unsigned long)spiSpeedGeneral);
+
+    if (onSd && !saveSpiSpeedConfig(spiSpeedGeneral, spiSpeedSampleWrite))
+    {
+        ei_printf("Saving " SPI_SPEED_CONFIG_FILE " failed\r\n");
+    }
+}
+
 // Arduino System Setup routine
 // Initialises devices. Reads flash device to see if valid uilib has
 // been programmed.
@@ -398,6 +743,7 @@ void isrTimer4(struct tc_module *const module_inst)
 void syntiant_setup(void)
 {
     timer4.enable(false); //disable timer4
+    bootMarks[BOOT_CORE] = micros();
 
     // uilib variables
     int s;
@@ -418,8 +764,7 @@ void syntiant_setup(void)
     //digitalWrite(LED_BLUE, HIGH); // Light BLUE LED
     //digitalWrite(LED_GREEN, HIGH); // Light GREEN LED
 
-    SerialFlash.begin(FLASH_CS);
-    SerialFlash.readID(FlashType);
+    readFlashType();
     if(FlashType[0] == SST25VF016B) { // Set up clock for Bluebank board
         analogWrite(3, 0x10); //TinyML Final Board
         REG_TCC1_PER = 1464;
@@ -448,42 +793,51 @@ void syntiant_setup(void)
             ;
     }
 
-    // reset NDP
-    pinMode(PORSTB, OUTPUT);
-    digitalWrite(PORSTB, LOW);
-    delay(100);
-    digitalWrite(PORSTB, HIGH);
+    bootMarks[BOOT_FLASH_ID] = micros();
 
     // Set up SPI (NDP) & SPI1 (SD card)
     SPI.begin();
     SPI.beginTransaction(SPISettings(spiSpeedGeneral, MSBFIRST, SPI_MODE0));
 
-    // See which board we are by trying to read NDP101 Registion Register
     pinMode(NDP9101_CS, OUTPUT);
     digitalWrite(NDP9101_CS, HIGH);
     pinMode(TINYML_CS, OUTPUT);
     digitalWrite(TINYML_CS, HIGH);
 
-    SPI_CS = NDP9101_CS;
-    NDP.spiTransfer(NULL, 0, 0x0, NULL, spiData, 1);
+#if SYNTIANT_FAST_BOOT
+    if (bootCache.magic == BOOT_CACHE_MAGIC && bootCache.flashType == FlashType[0])
+    {
+        SPI_CS = bootCache.cs;
+        bootCached = true;
+    }
+#endif
 
-    if (spiData[0] == 0x20)
+    // reset NDP. Fast boot polls it on the cached chip select, or on both
+    // without one. A cached board that doesn't answer is probed again, as
+    // the non-fast boot does.
+    bootCached = resetNdp(!bootCached) && bootCached;
+    bootMarks[BOOT_NDP_RESET] = micros();
+
+    // See which board we are by trying to read NDP101 Registion Register,
+    // unless the cached board answered
+    if (bootCached ? SPI_CS == NDP9101_CS : ndpAnswers(NDP9101_CS))
     {
         SPI_CS = NDP9101_CS;
         idle = NDP9101_USB_IDLE;
+        bootMarks[BOOT_NDP_PROBE] = micros();
     }
 
     else
     {
-        SPI_CS = TINYML_CS;
-        NDP.spiTransfer(NULL, 0, 0x0, NULL, spiData, 1);
-
-        if (spiData[0] == 0x20)
+        if (bootCached || ndpAnswers(TINYML_CS))
         {
             SPI_CS = TINYML_CS;
+            bootMarks[BOOT_NDP_PROBE] = micros();
             pinMode(NDP9101_CS, INPUT); // make NDP9101_CS input to save power
 
+#if !SYNTIANT_FAST_BOOT
             Serial2.begin(115200);
+#endif
 
             // Serial2 will be available on TinyML connector pin 6 (RX) & pin 7 (TX)
             // PA20 Arduino pin 6 is RX.
@@ -491,16 +845,20 @@ void syntiant_setup(void)
             // Assign pins PA20 & PA21 to SERCOM functionality.
             pinPeripheral(6, PIO_SERCOM_ALT);
             pinPeripheral(7, PIO_SERCOM_ALT);
+#if !SYNTIANT_FAST_BOOT
             delay(100);
+#endif
             Serial2.println("Hello Serial2 World!");
 
             pinMode(LED_BLUE, OUTPUT);
             pinMode(LED_GREEN, OUTPUT);
             pinMode(USER_SWITCH, INPUT_PULLUP);
 
+#if !SYNTIANT_FAST_BOOT
             // find which Serial Flash device is connected
             SerialFlash.begin(FLASH_CS);
             SerialFlash.readID(FlashType);
+#endif
             // Set up pin to drive 5v out to Arduino companion
             if (FlashType[0] == SST25VF016B)
             {
@@ -535,9 +893,16 @@ void syntiant_setup(void)
         }
     }
 
+    bootMarks[BOOT_BOARD] = micros();
+    bootCache.magic = BOOT_CACHE_MAGIC;
+    bootCache.flashType = FlashType[0];
+    bootCache.cs = SPI_CS;
+
     // Initialize SD & Serial Flash. Try & load NDP BIN file which contains NDP firmware & Neural Network
     // If not able to load bin file, use Bridging Mode to access NDP
     NDP.setInterrupt(NDP_INT, ndpInt);
+    setupSpiSpeed();
+    bootMarks[BOOT_SPI_SPEED] = micros();
     switch (loadModel(model))
     {
     case BIN_LOAD_OK:
@@ -567,6 +932,10 @@ void syntiant_setup(void)
         ei_printf("Error loading bin from SD!");
         ei_printf("Running in Bridge Mode");
         break;
+    case ERROR_BIN_CRC:
+        ei_printf("BIN file failed its CRC check and no other model checks out!");
+        ei_printf("Running in Bridge Mode");
+        break;
     case LOADED_FROM_SERIAL_FLASH:
         ei_printf("BIN File Loaded correctly from Serial Flash");
         runningFromFlash = 1;
@@ -578,6 +947,30 @@ void syntiant_setup(void)
         ei_printf("Running in Bridge Mode");
         break;
     }
+    bootMarks[BOOT_MODEL] = micros();
+    if (runningFromFlash) {
+        ei_printf("\r\nModel load %lu bytes in %lu us (read %lu us, NDP %lu us, CRC %lu us)",
+                  (unsigned long)loadModelTiming.bytes,
+                  (unsigned long)loadModelTiming.total,
+                  (unsigned long)loadModelTiming.read,
+                  (unsigned long)loadModelTiming.load,
+                  (unsigned long)loadModelTiming.check);
+
+        // The other models next to this one can be switched to at runtime.
+        // They are scanned already when the model failed its CRC check and
+        // another one was booted.
+        if (modelSlotActive < 0)
+        {
+            scanModelSlots(loadedFromSD);
+            modelSlotActive = findModelSlot(model.c_str());
+        }
+        else
+        {
+            ei_printf("\r\n%s failed its CRC check, booted %s instead",
+                      model.c_str(), modelSlots[modelSlotActive].name);
+        }
+    }
+    bootMarks[BOOT_SLOTS] = micros();
 
     // Allow some peripherals to be active in Standby mode.
     // Standby is used when battery powered for lowest power
@@ -591,10 +984,7 @@ void syntiant_setup(void)
 
     if (!runningFromFlash) {
         // Reset the NDP if the log load failed
-        pinMode(PORSTB, OUTPUT);
-        digitalWrite(PORSTB, LOW);
-        delay(100);
-        digitalWrite(PORSTB, HIGH);
+        resetNdp(false);
 
         // Light RED LED as uilib NOT loaded successfully
         digitalWrite(LED_RED, HIGH);
@@ -611,10 +1001,11 @@ void syntiant_setup(void)
     // possible priority.
     NVIC_SetPriority(TC4_IRQn, 3); // Make timer 4 the lowest priority
 
-    tankSize = indirectRead(DSP_CONFIG_TANK) >> 4;
-    tankAddress = indirectRead(DSP_CONFIG_TANKADDR);
-
 #if defined(WITH_AUDIO)
+    if (runningFromFlash) {
+        openTank();
+    }
+
     // Load Audio Buffer with test pattern
     for (i = 0; i < sizeof(audioBuf) / 2; i++) {
         audioBuf[i] = 4000 * (i - (sizeof(audioBuf) / 4));
@@ -642,8 +1033,781 @@ void syntiant_setup(void)
     timer4.enable(true); // enable 1mS timer interrupt
 
     startingFWAddress = indirectRead(0x1fffc0c0);
+    bootMarks[BOOT_DEVICES] = micros();
 
     ei_setup();
+    bootMarks[BOOT_EI] = micros();
+}
+
+// AT+BOOTPROFILE?
+void syntiant_print_boot_profile(void)
+{
+    uint32_t prev = 0;
+
+    ei_printf("phase           end us    took us\r\n");
+    for (int i = 0; i < BOOT_PHASES; i++)
+    {
+        ei_printf("%-12s %9lu  %9lu\r\n", bootPhaseNames[i],
+                  (unsigned long)bootMarks[i],
+                  (unsigned long)(bootMarks[i] - prev));
+        prev = bootMarks[i];
+    }
+    ei_printf("fast boot %s, board %s\r\n", SYNTIANT_FAST_BOOT ? "on" : "off",
+              bootCached ? "cached" : "probed");
+}
+
+static uint8_t *packBE(uint8_t *p, uint32_t v, int size)
+{
+    while (size--)
+        *p++ = (v >> (8 * size)) & 0xff;
+    return p;
+}
+
+// GET_SPI_STATS reply, big endian:
+//   sites (1), kinds (1), then per site and kind calls, bytes, micros (4 each)
+//   transfers traced (4), entries (1), then per entry oldest first
+//   start micros (4), bytes (2), micros (2), site (1), kind (1)
+// Both counts are 0 if the statistics are not compiled in.
+// returns the reply length
+static int packSpiStats(uint8_t *buf)
+{
+#if NDP_SPI_STATS
+    static struct ndp_spi_stats_s stats;
+    uint8_t *p = buf;
+    uint32_t n, i;
+
+    ndpSpiStatsGet(&stats);
+    *p++ = NDP_SPI_SITES;
+    *p++ = NDP_SPI_KINDS;
+    for (int site = 0; site < NDP_SPI_SITES; site++)
+    {
+        for (int kind = 0; kind < NDP_SPI_KINDS; kind++)
+        {
+            p = packBE(p, stats.counter[site][kind].calls, 4);
+            p = packBE(p, stats.counter[site][kind].bytes, 4);
+            p = packBE(p, stats.counter[site][kind].micros, 4);
+        }
+    }
+    p = packBE(p, stats.traced, 4);
+#if NDP_SPI_TRACE
+    n = min(stats.traced, (uint32_t)NDP_SPI_TRACE);
+    *p++ = n;
+    for (i = stats.traced - n; i < stats.traced; i++)
+    {
+        struct ndp_spi_trace_s *t = &stats.trace[i % NDP_SPI_TRACE];
+
+        p = packBE(p, t->start, 4);
+        p = packBE(p, t->count, 2);
+        p = packBE(p, t->micros, 2);
+        *p++ = t->site;
+        *p++ = t->kind;
+    }
+#else
+    *p++ = 0;
+#endif
+    return p - buf;
+#else
+    buf[0] = 0;
+    buf[1] = 0;
+    return 2;
+#endif
+}
+
+// AT+SPISTATS?
+void syntiant_print_spi_stats(void)
+{
+#if NDP_SPI_STATS
+    static const char *siteNames[NDP_SPI_SITES] = {
+        "other", "poll", "tank", "load", "flash", "bridge"};
+    static const char *kindNames[NDP_SPI_KINDS] = {
+        "direct rd", "direct wr", "mcu rd", "mcu wr"};
+    static struct ndp_spi_stats_s stats;
+
+    ndpSpiStatsGet(&stats);
+    ei_printf("site    kind          calls        bytes       micros\r\n");
+    for (int site = 0; site < NDP_SPI_SITES; site++)
+    {
+        for (int kind = 0; kind < NDP_SPI_KINDS; kind++)
+        {
+            struct ndp_spi_counter_s *c = &stats.counter[site][kind];
+
+            if (!c->calls)
+                continue;
+            ei_printf("%-7s %-9s %10lu %12lu %12lu\r\n", siteNames[site],
+                      kindNames[kind], (unsigned long)c->calls,
+                      (unsigned long)c->bytes, (unsigned long)c->micros);
+        }
+    }
+    ei_printf("Transfers traced: %lu\r\n", (unsigned long)stats.traced);
+#else
+    ei_printf("SPI statistics not compiled in, build with NDP_SPI_STATS=1\r\n");
+#endif
+}
+
+// AT+CLEARSPISTATS
+void syntiant_clear_spi_stats(void)
+{
+#if NDP_SPI_STATS
+    ndpSpiStatsClear();
+#endif
+}
+
+// AT+AUDIOSTATS?
+// The tank counters are from reading the NDP, the USB ones from handing
+// packets to the isochronous endpoint at each USB frame.
+void syntiant_print_audio_stats(void)
+{
+#ifdef WITH_AUDIO
+    ei_printf("tank underruns %lu, dropped %lu, skipped %lu\r\n",
+              audioReader.underruns, audioReader.dropped, tank.skipped);
+    ei_printf("usb underruns %lu, overruns %lu\r\n",
+              (unsigned long)AudioUSB.underruns(),
+              (unsigned long)AudioUSB.overruns());
+#else
+    ei_printf("USB audio not compiled in, build with WITH_AUDIO\r\n");
+#endif
+}
+
+#ifdef WITH_AUDIO
+static File capFile;
+static SerialFlashFile capFlashFile;
+static bool capOnSd = false;
+static bool capOpen = false;
+static uint32_t capWritten = 0;
+static int capSlot = 0;
+static bool capSlotErased = false;
+static char capName[16];
+
+static uint8_t *packLE(uint8_t *p, uint32_t v, int size)
+{
+    while (size--)
+    {
+        *p++ = v & 0xff;
+        v >>= 8;
+    }
+    return p;
+}
+
+// RIFF header and format chunk of a 16 kHz 16-bit mono WAV file
+static uint8_t *wavStart(uint8_t *p, uint32_t fileBytes)
+{
+    memcpy(p, "RIFF", 4);
+    p = packLE(p + 4, fileBytes - 8, 4);
+    memcpy(p, "WAVEfmt ", 8);
+    p = packLE(p + 8, 16, 4);
+    p = packLE(p, 1, 2);     // PCM
+    p = packLE(p, 1, 2);     // mono
+    p = packLE(p, 16000, 4); // samples a second
+    p = packLE(p, 32000, 4); // bytes a second
+    p = packLE(p, 2, 2);     // bytes a sample
+    return packLE(p, 16, 2); // bits a sample
+}
+
+// WAV header with the class and time of the match in an INFO comment
+static void captureHeader(uint8_t *h, uint32_t dataBytes)
+{
+    char comment[CAPTURE_COMMENT_BYTES];
+    uint8_t *p;
+
+    memset(comment, 0, sizeof(comment));
+    snprintf(comment, sizeof(comment), "class %d %s at %lu ms", capClass,
+             ei_classification_label(capClass), (unsigned long)capMillis);
+
+    p = wavStart(h, CAPTURE_WAV_HEADER + dataBytes);
+    memcpy(p, "LIST", 4);
+    p = packLE(p + 4, 12 + CAPTURE_COMMENT_BYTES, 4);
+    memcpy(p, "INFOICMT", 8);
+    p = packLE(p + 8, CAPTURE_COMMENT_BYTES, 4);
+    memcpy(p, comment, CAPTURE_COMMENT_BYTES);
+    p += CAPTURE_COMMENT_BYTES;
+    memcpy(p, "data", 4);
+    packLE(p + 4, dataBytes, 4);
+}
+
+static bool writeCapture(const void *data, uint32_t len)
+{
+    if (capOnSd)
+        return capFile.write(data, len) == len;
+    return capFlashFile.write(data, len) == len;
+}
+
+// Create the capture file and write its header. The Serial Flash slot is
+// erased here unless it was erased after the last capture.
+static bool openCapture(void)
+{
+    static uint32_t index = 0;
+    uint8_t h[CAPTURE_WAV_HEADER];
+
+    capOnSd = SD.begin(SDCARD_SS_PIN);
+    if (capOnSd)
+    {
+        do
+        {
+            snprintf(capName, sizeof(capName), "CAP%05lu.WAV",
+                     (unsigned long)++index);
+        } while (SD.exists(capName) && index < 99999);
+        capFile = SD.open(capName, FILE_WRITE);
+        if (!capFile)
+            return false;
+    }
+    else
+    {
+        snprintf(capName, sizeof(capName), "cap%d.wav", capSlot);
+        if (!SerialFlash.exists(capName)
+            && !SerialFlash.createErasable(capName, CAPTURE_FLASH_SLOT_BYTES))
+            return false;
+        capFlashFile = SerialFlash.open(capName);
+        if (!capFlashFile)
+            return false;
+        if (!capSlotErased)
+            capFlashFile.erase();
+        capSlotErased = false;
+        capSlot = (capSlot + 1) % CAPTURE_FLASH_SLOTS;
+    }
+    captureHeader(h, capTotal);
+    return writeCapture(h, sizeof(h));
+}
+
+// Main loop: write out the blocks the interrupt extracted, and finish the
+// file once the whole capture is written
+static void serviceCapture(void)
+{
+    if (!capBusy)
+        return;
+    if (!capOpen)
+    {
+        capWritten = 0;
+        capOpen = openCapture();
+        if (!capOpen)
+        {
+            capLeft = 0;
+            capLen[0] = capLen[1] = 0;
+            capFailed++;
+            capBusy = false;
+            ei_printf("Capture failed: no storage for %s\r\n", capName);
+            return;
+        }
+    }
+    while (capLen[capMain])
+    {
+        writeCapture(capBuf[capMain], capLen[capMain]);
+        capWritten += capLen[capMain];
+        capLen[capMain] = 0;
+        capMain ^= 1;
+    }
+    if (capLeft)
+        return;
+
+    // an extraction error ends the capture early, keep the header's length
+    memset(capBuf[0], 0, CAPTURE_BLOCK);
+    while (capWritten < capTotal)
+    {
+        uint32_t n = min(capTotal - capWritten, (uint32_t)CAPTURE_BLOCK);
+
+        writeCapture(capBuf[0], n);
+        capWritten += n;
+    }
+    if (capOnSd)
+    {
+        capFile.close();
+        ei_sd_sample_blocks_changed();
+    }
+    else
+        capFlashFile.close();
+    capOpen = false;
+    capCount++;
+    ei_printf("Captured %s: class %d %s at %lu ms\r\n", capName, capClass,
+              ei_classification_label(capClass), (unsigned long)capMillis);
+
+    // get the next Serial Flash slot ready while nothing is captured
+    if (!capOnSd)
+    {
+        char next[16];
+
+        snprintf(next, sizeof(next), "cap%d.wav", capSlot);
+        if (SerialFlash.exists(next))
+        {
+            capFlashFile = SerialFlash.open(next);
+            capFlashFile.erase();
+            capFlashFile.close();
+            capSlotErased = true;
+        }
+    }
+    capBusy = false;
+}
+
+static FatFile recFile;
+static char recName[16];
+static uint32_t recBlocks = 0; // data blocks the file has room for
+static uint32_t recStart = 0;
+static uint32_t recWriteMicros = 0;
+static uint32_t recWriteMaxMicros = 0; // longest block write
+
+// WAV header a block long, padded with a JUNK chunk so the samples start
+// on a block boundary
+static void recordHeader(uint8_t *h, uint32_t dataBytes)
+{
+    uint8_t *p;
+
+    memset(h, 0, RECORD_BLOCK_BYTES);
+    p = wavStart(h, RECORD_BLOCK_BYTES + dataBytes);
+    memcpy(p, "JUNK", 4);
+    packLE(p + 4, (uint32_t)(h + RECORD_BLOCK_BYTES - 8 - (p + 8)), 4);
+    p = h + RECORD_BLOCK_BYTES - 8;
+    memcpy(p, "data", 4);
+    packLE(p + 4, dataBytes, 4);
+}
+
+// Create and erase a contiguous file for the recording and start the
+// multi-block write with its header
+static bool startRecording(uint32_t seconds)
+{
+    // max number of blocks to erase per erase call
+    const uint32_t ERASE_SIZE = 262144L;
+    static uint32_t index = 0;
+    uint32_t bgnBlock, endBlock, bgnErase, endErase;
+
+    if (!SD.begin(SDCARD_SS_PIN))
+    {
+        ei_printf("ERR: no SD card\r\n");
+        return false;
+    }
+    do
+    {
+        snprintf(recName, sizeof(recName), "REC%05lu.WAV",
+                 (unsigned long)++index);
+    } while (SD.exists(recName) && index < 99999);
+
+    recBlocks = (seconds * 32000 + RECORD_BLOCK_BYTES - 1) / RECORD_BLOCK_BYTES;
+    recFile.close();
+    if (!recFile.createContiguous(recName, (recBlocks + 1) * RECORD_BLOCK_BYTES)
+        || !recFile.contiguousRange(&bgnBlock, &endBlock))
+    {
+        ei_printf("ERR: SD creating %s failed\r\n", recName);
+        recFile.close();
+        return false;
+    }
+
+    for (bgnErase = bgnBlock; bgnErase < endBlock; bgnErase = endErase + 1)
+    {
+        endErase = min(bgnErase + ERASE_SIZE, endBlock);
+        if (!SD.card()->erase(bgnErase, endErase))
+            ei_printf("ERR: SD erase file failed\r\n");
+    }
+
+    recordHeader(recBuf[0], recBlocks * RECORD_BLOCK_BYTES);
+    if (!SD.card()->writeStart(bgnBlock, recBlocks + 1)
+        || !SD.card()->writeData(recBuf[0]))
+    {
+        ei_printf("ERR: SD start writing failed\r\n");
+        recFile.close();
+        return false;
+    }
+
+    recWriteMicros = 0;
+    recWriteMaxMicros = 0;
+    recStart = millis();
+    noInterrupts();
+    recFill = 0;
+    recProduced = recConsumed = 0;
+    ndpTankReaderStart(&tank, &recReader);
+    recBlocksLeft = recBlocks;
+    recActive = true;
+    interrupts();
+    return true;
+}
+
+// End the multi-block write. A recording stopped early gets the header of
+// what was written and its file is cut to that.
+static void finishRecording(void)
+{
+    uint32_t bytes = recConsumed * RECORD_BLOCK_BYTES;
+    uint32_t ms = millis() - recStart;
+
+    recActive = false;
+    SD.card()->writeStop();
+    if (recConsumed < recBlocks)
+    {
+        recordHeader(recBuf[0], bytes);
+        recFile.seekSet(0);
+        recFile.write(recBuf[0], RECORD_BLOCK_BYTES);
+        recFile.truncate(RECORD_BLOCK_BYTES + bytes);
+    }
+    recFile.close();
+    ei_sd_sample_blocks_changed();
+    ei_printf("Recorded %s: %lu bytes in %lu ms, dropped %lu bytes, "
+              "SD writes %lu KB/s, longest %lu us\r\n", recName,
+              (unsigned long)bytes, (unsigned long)ms, recReader.dropped,
+              recWriteMicros ? (unsigned long)((uint64_t)bytes * 1000000 / 1024
+                                               / recWriteMicros) : 0UL,
+              (unsigned long)recWriteMaxMicros);
+}
+
+// Main loop: write the blocks the interrupt filled
+static void serviceRecording(void)
+{
+    uint32_t t;
+    bool ok = true;
+
+    if (!recActive)
+        return;
+    while (recConsumed != recProduced)
+    {
+        t = micros();
+        ok = SD.card()->writeData(recBuf[recConsumed % RECORD_BLOCKS]);
+        t = micros() - t;
+        recWriteMicros += t;
+        if (recWriteMaxMicros < t)
+            recWriteMaxMicros = t;
+        if (!ok)
+        {
+            ei_printf("ERR: writing %s failed\r\n", recName);
+            recBlocksLeft = 0;
+            break;
+        }
+        recConsumed++;
+    }
+    if (!recBlocksLeft && (recConsumed == recProduced || !ok))
+        finishRecording();
+}
+#endif
+
+// AT+RECORD=SECONDS
+// Records the microphone to the SD card, 0 stops a recording
+void syntiant_record(char *seconds)
+{
+#ifdef WITH_AUDIO
+    uint32_t n = strtoul(seconds, NULL, 0);
+
+    if (recActive)
+    {
+        if (!n)
+            recBlocksLeft = 0; // the main loop finishes the file
+        else
+            ei_printf("Recording %s already\r\n", recName);
+        return;
+    }
+    if (!n)
+        return;
+    if (!runningFromFlash || capBusy)
+    {
+        ei_printf("ERR: %s\r\n", capBusy ? "capturing a match" : "no model running");
+        return;
+    }
+    if (startRecording(n))
+        ei_printf("Recording %lu s to %s\r\n", (unsigned long)n, recName);
+#else
+    ei_printf("USB audio not compiled in, build with WITH_AUDIO\r\n");
+#endif
+}
+
+// AT+RECORD?
+void syntiant_print_recording(void)
+{
+#ifdef WITH_AUDIO
+    if (!recActive)
+    {
+        ei_printf("Not recording\r\n");
+        return;
+    }
+    ei_printf("Recording %s: %lu of %lu blocks, %lu queued, dropped %lu "
+              "bytes\r\n", recName, (unsigned long)recConsumed,
+              (unsigned long)recBlocks,
+              (unsigned long)(recProduced - recConsumed), recReader.dropped);
+#else
+    ei_printf("USB audio not compiled in, build with WITH_AUDIO\r\n");
+#endif
+}
+
+// AT+SAMPLESTART=Built-in microphone
+// The recording blocks are filled as for AT+RECORD and handed to the
+// sampler, which stores them as CBOR, until it has all its samples. The
+// sample fails when audio is dropped or the samples don't arrive within
+// lengthMs and SAMPLE_AUDIO_SLACK_MS.
+bool syntiant_sample_audio(bool (*callback)(const void *sample_buf, uint32_t byteLenght),
+                           uint32_t lengthMs)
+{
+#ifdef WITH_AUDIO
+    unsigned long dropped;
+    uint32_t start;
+    bool done = false;
+
+    if (!runningFromFlash || recActive || capBusy)
+    {
+        ei_printf("ERR: %s\r\n", !runningFromFlash ? "no model running"
+                  : recActive ? "recording" : "capturing a match");
+        return false;
+    }
+
+    noInterrupts();
+    recFill = 0;
+    recProduced = recConsumed = 0;
+    ndpTankReaderStart(&tank, &recReader);
+    recBlocksLeft = UINT32_MAX;
+    recActive = true;
+    interrupts();
+
+    start = millis();
+    while (!done && millis() - start < lengthMs + SAMPLE_AUDIO_SLACK_MS)
+    {
+        if (recConsumed == recProduced)
+            continue;
+        done = callback(recBuf[recConsumed % RECORD_BLOCKS], RECORD_BLOCK_BYTES);
+        recConsumed++;
+    }
+
+    noInterrupts();
+    recActive = false;
+    recBlocksLeft = 0;
+    interrupts();
+
+    if (!done)
+    {
+        ei_printf("ERR: sampling timed out after %lu ms\r\n",
+                  (unsigned long)(millis() - start));
+        return false;
+    }
+    dropped = recReader.dropped;
+    if (dropped)
+    {
+        ei_printf("ERR: dropped %lu bytes of audio\r\n", dropped);
+        return false;
+    }
+    return true;
+#else
+    ei_printf("USB audio not compiled in, build with WITH_AUDIO\r\n");
+    return false;
+#endif
+}
+
+// AT+CAPTURE=PRE,POST
+// Both windows in ms, their sum limited by a Serial Flash slot
+void syntiant_set_capture(char *pre, char *post)
+{
+#ifdef WITH_AUDIO
+    uint32_t preMs = strtoul(pre, NULL, 0);
+    uint32_t postMs = strtoul(post, NULL, 0);
+    uint32_t most = (CAPTURE_FLASH_SLOT_BYTES - CAPTURE_WAV_HEADER) / 32;
+
+    if (preMs + postMs > most)
+    {
+        ei_printf("Capture windows exceed %lu ms\r\n", (unsigned long)most);
+        return;
+    }
+    capPreBytes = preMs * 32;
+    capPostBytes = postMs * 32;
+    syntiant_print_capture();
+#else
+    ei_printf("USB audio not compiled in, build with WITH_AUDIO\r\n");
+#endif
+}
+
+// AT+CAPTURE?
+void syntiant_print_capture(void)
+{
+#ifdef WITH_AUDIO
+    if (!(capPreBytes || capPostBytes))
+        ei_printf("Capture off\r\n");
+    else
+        ei_printf("Capture %lu ms before and %lu ms after a match\r\n",
+                  (unsigned long)capPreBytes / 32,
+                  (unsigned long)capPostBytes / 32);
+    ei_printf("captured %lu, failed %lu%s\r\n", capCount, capFailed,
+              capBusy ? ", capturing" : "");
+#else
+    ei_printf("USB audio not compiled in, build with WITH_AUDIO\r\n");
+#endif
+}
+
+// Reset the NDP and load another model into it without resetting the
+// SAMD; polling picks up the new tank once it is loaded. Returns a
+// loadModel status.
+static int reloadNdp(int (*load)(void *ctx), void *ctx)
+{
+    int wasMgmtCmd = doingMgmtCmd;
+    int s;
+
+    doingMgmtCmd = 1;
+    timer4.enableInterrupt(false);
+    runningFromFlash = 0;
+    patchApplied = 0;
+#ifdef WITH_AUDIO
+    capLeft = 0; // a capture in progress ends in silence
+#endif
+
+    resetNdp(false);
+    NDP.init();
+    s = load(ctx);
+    if (s == BIN_LOAD_OK || s == LOADED_FROM_SERIAL_FLASH || s == ERROR_SAVING_BIN)
+    {
+        runningFromFlash = 1;
+#ifdef WITH_AUDIO
+        openTank();
+#endif
+        currentPointer = 0;
+        prevPointer = 0;
+        startingFWAddress = indirectRead(0x1fffc0c0);
+    }
+    else
+    {
+        // leave the NDP clean for bridge mode, as a failed boot does
+        resetNdp(false);
+    }
+
+    doingMgmtCmd = wasMgmtCmd;
+    if (!doingMgmtCmd)
+    {
+        timer4.enableInterrupt(true);
+    }
+    return s;
+}
+
+static int loadSlot(void *ctx)
+{
+    return loadModelSlot(*(int *)ctx);
+}
+
+// Switch the NDP to another model slot
+static int switchModel(int slot)
+{
+    return reloadNdp(loadSlot, &slot);
+}
+
+struct stream_load_s {
+    uint32_t bytes;
+    bool persist;
+    uint32_t crc;
+};
+
+static unsigned int streamSerialRead(void *file, void *buf, unsigned int count)
+{
+    return Serial.readBytes((char *)buf, count);
+}
+
+static int loadStream(void *ctx)
+{
+    struct stream_load_s *st = (struct stream_load_s *)ctx;
+
+    return loadModelStream(model, st->bytes, st->persist, streamSerialRead,
+                           NULL, &st->crc);
+}
+
+// Load a model of bytes arriving on the USB serial port straight into the
+// NDP, for iterating on a model without writing it to storage first. With
+// persist it is saved as the boot model as well. Returns a loadModel status.
+static int streamModel(uint32_t bytes, bool persist, uint32_t *crc)
+{
+    struct stream_load_s st = {bytes, persist, 0};
+    int s;
+
+    digitalWrite(LED_BUILTIN, HIGH);
+    s = reloadNdp(loadStream, &st);
+    digitalWrite(LED_BUILTIN, LOW);
+    if (persist)
+        ei_sd_sample_blocks_changed();
+    *crc = st.crc;
+    return s;
+}
+
+// AT+MODELS?
+void syntiant_list_models(void)
+{
+    ei_printf("slot name                     bytes    version\r\n");
+    for (int i = 0; i < modelSlotCount; i++)
+    {
+        ei_printf("%c%-3d %-24s %8lu   %08lx\r\n",
+                  i == modelSlotActive ? '*' : ' ', i, modelSlots[i].name,
+                  (unsigned long)modelSlots[i].size,
+                  (unsigned long)modelSlots[i].version);
+    }
+    if (!modelSlotCount)
+    {
+        ei_printf("No model slots, the NDP did not boot from SD or Serial Flash\r\n");
+    }
+}
+
+// AT+MODEL=<slot or file name>
+void syntiant_switch_model(char *arg)
+{
+    char *end;
+    int slot = strtol(arg, &end, 10);
+    int s;
+
+    if (end == arg || *end)
+    {
+        slot = findModelSlot(arg);
+    }
+    if (slot < 0 || modelSlotCount <= slot)
+    {
+        ei_printf("No model slot %s\r\n", arg);
+        return;
+    }
+
+    s = switchModel(slot);
+    if (s != BIN_LOAD_OK && s != LOADED_FROM_SERIAL_FLASH)
+    {
+        ei_printf("Loading %s failed (%d), running in Bridge Mode\r\n",
+                  modelSlots[slot].name, s);
+        return;
+    }
+    ei_printf("Switched to %s in %lu us\r\n", modelSlots[slot].name,
+              (unsigned long)loadModelTiming.total);
+}
+
+// AT+STREAMLOAD=<bytes>,<save>. The model follows once the prompt is sent.
+void syntiant_stream_model(char *bytes, char *save)
+{
+    uint32_t n = strtoul(bytes, NULL, 10);
+    uint32_t crc;
+    int s;
+
+    if (!n)
+    {
+        ei_printf("No model size given\r\n");
+        return;
+    }
+
+    ei_printf("Send %lu bytes\r\n", (unsigned long)n);
+    s = streamModel(n, atoi(save) != 0, &crc);
+    if (s != BIN_LOAD_OK && s != ERROR_SAVING_BIN)
+    {
+        ei_printf("Loading the model failed (%d), running in Bridge Mode\r\n", s);
+        return;
+    }
+    ei_printf("Loaded %lu bytes in %lu us (read %lu us, NDP %lu us), CRC %08lx\r\n",
+              (unsigned long)loadModelTiming.bytes,
+              (unsigned long)loadModelTiming.total,
+              (unsigned long)loadModelTiming.read,
+              (unsigned long)loadModelTiming.load, (unsigned long)crc);
+    if (s == ERROR_SAVING_BIN)
+    {
+        ei_printf("Saving %s failed, it is lost on reset\r\n", model.c_str());
+    }
+}
+
+// The RX_FLASH_BUFFER chunks of the NDP9101B0-USB go to the NDP master SPI
+// flash. Each page program is left running while the next chunk comes in,
+// and once a sector is full the next one is erased ahead of its first
+// chunk, so the erase overlaps the transfer too.
+static uint32_t flashFileBytes = 0; // from START_OF_FILE
+static uint32_t flashErasedAhead = 0xffffffff;
+
+static void programFlash(uint32_t addr, uint32_t count)
+{
+    uint32_t end = addr + count;
+
+    // a 4K boundary starts a sector
+    if ((addr & 0xfff) == 0 && addr != flashErasedAhead)
+    {
+        flashEraseStart(addr);
+    }
+    flashProgramStart(addr, ilibBuf, count);
+
+    if ((end & 0xfff) == 0 && end < flashFileBytes)
+    {
+        flashEraseStart(end);
+        flashErasedAhead = end;
+    }
 }
 
 // Management Interface Code
@@ -657,6 +1821,8 @@ void runManagementCommand(void)
     uint32_t count;
     uint32_t temp;
 
+    NDP_SPI_SITE(NDP_SPI_SITE_BRIDGE);
+
     doingMgmtCmd = 1;
 
     // Stop timer4 as we will access NDP from main()
@@ -679,8 +1845,7 @@ void runManagementCommand(void)
         if (s < 0)
             break;
 
-        NDP.spiTransfer(NULL, 1, addr, NULL, spiData, count);
-        writeBytes(spiData, count);
+        bridgeRead(1, addr, count);
         break;
 
     case INDIRECT_WRITE:
@@ -694,11 +1859,8 @@ void runManagementCommand(void)
         if (s < 0)
             break;
 
-        s = Serial.readBytes((char *)spiData, count);
-        if (s < (int)count)
-            break;
-
-        NDP.spiTransfer(NULL, 1, addr, spiData, NULL, count);
+        bridgeWrite(1, addr, count);
+        invalidateMasterSpiShadow();
         break;
 
     case DIRECT_READ:
@@ -710,8 +1872,7 @@ void runManagementCommand(void)
         if (s < 0)
             break;
 
-        NDP.spiTransfer(NULL, 0, addr, NULL, spiData, count);
-        writeBytes(spiData, count);
+        bridgeRead(0, addr, count);
 
         break;
 
@@ -719,26 +1880,27 @@ void runManagementCommand(void)
         s = readMultipleBytes(1, &addr);
         if (s < 0)
             break;
-        if (addr == 0x20)
-        {
-            SPI.beginTransaction(SPISettings(spiSpeedSampleWrite,
-                                             MSBFIRST, SPI_MODE0));
-        }
 
         s = readMultipleBytes(2, &count);
         if (s < 0)
             break;
 
-        s = Serial.readBytes((char *)spiData, count);
-        if (s < (int)count)
-            break;
-        NDP.spiTransfer(NULL, 0, addr, spiData, NULL, count);
-
+        if (addr == 0x20)
+        {
+            SPI.beginTransaction(SPISettings(spiSpeedSampleWrite,
+                                             MSBFIRST, SPI_MODE0));
+        }
+        s = bridgeWrite(0, addr, count);
+        invalidateMasterSpiShadow();
+        // restore the clock even when the write failed
         if (addr == 0x20)
         {
             SPI.beginTransaction(SPISettings(spiSpeedGeneral, MSBFIRST,
                                              SPI_MODE0));
         }
+        if (!s)
+            break;
+
         if (addr == 0x4 && (spiData[0] & 0x01) == 0)
         {
             // chip reset -> no longer running from flash
@@ -816,7 +1978,44 @@ void runManagementCommand(void)
         writeBytes(spiData, 4);
         break;
 
+    case GET_SPI_STATS:
+        writeBytes(spiData, packSpiStats(spiData));
+        break;
+
+    case CLEAR_SPI_STATS:
+#if NDP_SPI_STATS
+        ndpSpiStatsClear();
+#endif
+        break;
+
+    case SWITCH_MODEL:
+        // slot index in, loadModel status out
+        s = readByte();
+        if (s < 0)
+            break;
+        spiData[0] = switchModel(s);
+        writeBytes(spiData, 1);
+        break;
+
+    case STREAM_LOAD:
+        // length[4] and flags[1] (bit 0 saves the model) in, then the
+        // model itself. loadModel status[1] and log CRC-32[4] out.
+        s = readMultipleBytes(4, &count);
+        if (s < 0)
+            break;
+
+        s = readByte();
+        if (s < 0)
+            break;
+
+        s = streamModel(count, s & 0x01, &temp);
+        spiData[0] = s;
+        packBE(spiData + 1, temp, 4);
+        writeBytes(spiData, 5);
+        break;
+
     case RX_FLASH_BUFFER:
+    case RX_FLASH_BUFFER_ACKED:
 
         digitalWrite(LED_BUILTIN, HIGH);
         s = readMultipleBytes(4, &addr);
@@ -828,11 +2027,18 @@ void runManagementCommand(void)
             break;
 
         s = Serial.readBytes((char *)ilibBuf, count);
+        if (command == RX_FLASH_BUFFER_ACKED)
+        {
+            // acked as soon as it is in, so the host sends the next chunk
+            // while this one is programmed
+            spiData[0] = s < (int)count ? SAMD_NACK : SAMD_ACK;
+            writeBytes(spiData, 1);
+        }
         if (s < (int)count)
             break;
         if (SPI_CS == NDP9101_CS) // see if NDP9101B0-USB
         {
-            flashWrite(addr, count);
+            programFlash(addr, count);
             digitalWrite(LED_BUILTIN, LOW);
             break;
         }
@@ -851,12 +2057,14 @@ void runManagementCommand(void)
                     myFile.rewind(); // go to start of file
                     Serial2.println("SD file opened");
                     SD_or_SerialFlash = 1;
+                    removeModelSideFiles(model, true);
                 }
                 else
                 {
                     // Program Flash instead
                     Serial2.println("Program Serial Flash");
                     SerialFlash.remove(model.c_str());
+                    removeModelSideFiles(model, false);
 
                     // create the file on the Flash chip and copy data
                     SerialFlash.create(model.c_str(), fileLength);
@@ -878,6 +2086,7 @@ void runManagementCommand(void)
                 if (SD_or_SerialFlash == 1)
                 {
                     myFile.close();
+                    ei_sd_sample_blocks_changed();
                     Serial2.println("New Bin File Programmed to SD card");
                 }
                 else
@@ -906,6 +2115,7 @@ void runManagementCommand(void)
 
         if (SPI_CS == NDP9101_CS) // see if NDP9101B0-USB
         {
+            flashWaitReady();
             changeMasterSpiMode(MSPI_IDLE);
             changeMasterSpiMode(MSPI_ENABLE);
             indirectWrite(CHIP_CONFIG_SPITX, FLASH_READ + addr);
@@ -1006,6 +2216,8 @@ void runManagementCommand(void)
 
     case START_OF_FILE:
         s = readMultipleBytes(4, &fileLength); // read file length
+        flashFileBytes = fileLength;
+        flashErasedAhead = 0xffffffff;
         Serial2.print("New BIN being sent. Length = 0x");
         Serial2.println(fileLength, HEX);
         break;
@@ -1053,6 +2265,7 @@ void runManagementCommand(void)
         digitalWrite(PORSTB, LOW);
         delay(100);
         digitalWrite(PORSTB, HIGH);
+        invalidateMasterSpiShadow();
         runningFromFlash = 0;
         patchApplied = 0;
         break;
@@ -1132,6 +2345,48 @@ void runManagementCommand(void)
     timer4.enableInterrupt(true);
 }
 
+static unsigned int bridgeSerialRead(void *ctx, void *buf, unsigned int count)
+{
+    return Serial.readBytes((char *)buf, count);
+}
+
+static void bridgeSerialWrite(void *ctx, const void *buf, unsigned int count)
+{
+    writeBytes((uint8_t *)buf, count);
+}
+
+static void bridgeWritten(void *ctx, int mcu, uint32_t address,
+                          const uint8_t *data, unsigned int count)
+{
+    invalidateMasterSpiShadow();
+    if (!mcu && address == 0x4 && (data[0] & 0x01) == 0)
+    {
+        // chip reset -> no longer running from flash
+        runningFromFlash = 0;
+    }
+}
+
+// Management Interface Code, v2 framed protocol (see NDP_bridge.h)
+// We have received NDP_BRIDGE_SYNC from USB Serial host
+void runBridgeFrame(void)
+{
+    static const struct ndp_bridge_io_s io = {
+        NULL, bridgeSerialRead, bridgeSerialWrite,
+        NULL, NDPClass::spiTransfer, bridgeWritten,
+        ilibBuf, sizeof(ilibBuf),
+        spiData, sizeof(spiData)};
+
+    NDP_SPI_SITE(NDP_SPI_SITE_BRIDGE);
+
+    doingMgmtCmd = 1;
+    timer4.enableInterrupt(false);
+
+    ndpBridgeFrame(&io);
+
+    doingMgmtCmd = 0;
+    timer4.enableInterrupt(true);
+}
+
 void processMatch(void)
 {
     intCount++;
@@ -1148,8 +2403,35 @@ void processMatch(void)
     }
 }
 
+// Report the matches the interrupt queued, oldest first
+static void serviceMatchEvents(void)
+{
+    struct ndp_event_s e;
+    bool reported = false;
+
+    while (ndpEventsGet(&matchEvents, &e))
+    {
+        // GET_INT_COUNT counts matches, as processMatch does without a model
+        intCount++;
+
+        // Light Arduino LED
+        digitalWrite(LED_BUILTIN, HIGH);
+
+        ei_classification_output(e.winner, e.micros, e.summary, e.tankPtr);
+        reported = true;
+    }
+
+    // once per drain, a burst of matches shares the same battery level
+    if (reported)
+    {
+        printBattery(); // Print current battery level
+    }
+}
+
 void syntiant_loop(void)
 {
+    int command;
+
     // Loop to stay in Standby Mode unless we get a ": " from USB
     // OR interrupt from NDP
     while (1)
@@ -1158,6 +2440,11 @@ void syntiant_loop(void)
         {
             processMatch();
         }
+        serviceMatchEvents();
+#ifdef WITH_AUDIO
+        serviceCapture();
+        serviceRecording();
+#endif
         if (timer4TimedOut)
         {
             timer4TimedOut = 0;
@@ -1171,7 +2458,8 @@ void syntiant_loop(void)
         // {
         //     break;
         // }
-        if(ei_command_line_handle() == true) {
+        command = ei_command_line_handle();
+        if (command) {
             break;
         }
 
@@ -1249,8 +2537,11 @@ void syntiant_loop(void)
     // Stop timer4 as we will access NDP from main()
     timer4.enableInterrupt(false); // disable 1mS timer interrupt
 
-    // ':' received -- perform a management command
-    runManagementCommand();
+    // ':' or a v2 frame received -- perform a management command
+    if (command == NDP_BRIDGE_SYNC)
+        runBridgeFrame();
+    else
+        runManagementCommand();
 
     timer4.enableInterrupt(true); // enable 1mS timer interrupt
 }
@@ -28,8 +28,23 @@
 
 /* Prototypes -------------------------------------------------------------- */
 void syntiant_setup(void);
+void syntiant_print_boot_profile(void);
 void syntiant_loop(void);
 
 void syntiant_get_imu(float *dest_imu);
 
+void syntiant_print_spi_stats(void);
+void syntiant_clear_spi_stats(void);
+void syntiant_print_audio_stats(void);
+void syntiant_set_capture(char *pre, char *post);
+void syntiant_print_capture(void);
+void syntiant_record(char *seconds);
+void syntiant_print_recording(void);
+bool syntiant_sample_audio(bool (*callback)(const void *sample_buf, uint32_t byteLenght),
+                           uint32_t lengthMs);
+
+void syntiant_list_models(void);
+void syntiant_switch_model(char *arg);
+void syntiant_stream_model(char *bytes, char *save);
+
 #endif
\ No newline at end of file
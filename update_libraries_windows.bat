@@ -139,7 +139,7 @@ IF %ERRORLEVEL% NEQ 0 (
     echo Installing SerialFlash library OK
 )
 
-(arduino-cli lib list NDP 2> nul) | findstr /r "1.0.0"
+(arduino-cli lib list NDP 2> nul) | findstr /r "1.1.0"
 IF %ERRORLEVEL% NEQ 0 (
     arduino-cli lib uninstall NDP
     echo Installing NDP library...
@@ -148,7 +148,7 @@ IF %ERRORLEVEL% NEQ 0 (
     echo Installing NDP library OK
 )
 
-(arduino-cli lib list NDP_utils 2> nul) | findstr /r "1.0.1"
+(arduino-cli lib list NDP_utils 2> nul) | findstr /r "1.1.0"
 IF %ERRORLEVEL% NEQ 0 (
     arduino-cli lib uninstall NDP_utils
     echo Installing NDP_utils library...